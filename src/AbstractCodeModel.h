@@ -3,6 +3,8 @@
 #include "Dwarf.h"
 #include "FilesModel.h"
 #include "TypesModel.h"
+#include "MemoryUsage.h"
+#include "CodeSink.h"
 
 #include <qobject.h>
 #include <qmenu.h>
@@ -17,10 +19,14 @@ public:
     Dwarf* dwarf() const;
     void setDwarf(Dwarf* dwarf);
 
-    virtual void writeDwarfEntry(QString& code, Elf32_Off offset) = 0;
-    virtual void writeFile(QString& code, const QString& path) = 0;
+    virtual void writeDwarfEntry(CodeSink& code, Elf32_Off offset) = 0;
+    virtual void writeFile(CodeSink& code, const QString& path) = 0;
+    virtual QStringList filePaths() const = 0;
     virtual QString dwarfEntryName(Elf32_Off offset) const = 0;
     virtual void setupSettingsMenu(QMenu* menu) = 0;
+    virtual MemoryUsage memoryUsage() const = 0;
+
+    void requestRewrite();
 
 signals:
     void rewriteRequested();
@@ -28,8 +34,6 @@ signals:
 protected:
     virtual void parseDwarf(Dwarf* dwarf) = 0;
 
-    void requestRewrite();
-
 private:
     Dwarf* m_dwarf;
 };
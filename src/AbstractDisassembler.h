@@ -12,4 +12,5 @@ public:
     AbstractDisassembler(QObject* parent = nullptr);
 
     virtual bool disassemble(Disassembly& disasm, const Elf* elf, Elf32_Addr startAddress, Elf32_Addr endAddress) = 0;
+    virtual void format(const DisassemblyInstruction& instruction, QString& outMnemonic, QString& outOperands) const = 0;
 };
@@ -0,0 +1,46 @@
+#include "AllocationCounter.h"
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#define ALLOCATION_COUNTER_CRT_HOOK
+#endif
+
+std::atomic<bool> AllocationCounter::s_enabled(false);
+std::atomic<qint64> AllocationCounter::s_count(0);
+
+#ifdef ALLOCATION_COUNTER_CRT_HOOK
+static std::atomic<qint64> s_heapCount(0);
+
+static int crtAllocHook(int allocType, void*, size_t, int, long, const unsigned char*, int)
+{
+    if (allocType != _HOOK_FREE)
+    {
+        s_heapCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return TRUE;
+}
+#endif
+
+void AllocationCounter::setEnabled(bool enabled)
+{
+#ifdef ALLOCATION_COUNTER_CRT_HOOK
+    _CrtSetAllocHook(enabled ? crtAllocHook : nullptr);
+#endif
+
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+qint64 AllocationCounter::count()
+{
+    return s_count.load(std::memory_order_relaxed);
+}
+
+qint64 AllocationCounter::heapCount()
+{
+#ifdef ALLOCATION_COUNTER_CRT_HOOK
+    return s_heapCount.load(std::memory_order_relaxed);
+#else
+    return -1;
+#endif
+}
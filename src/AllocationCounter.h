@@ -0,0 +1,34 @@
+#pragma once
+
+#include <qglobal.h>
+
+#include <atomic>
+
+// Counts the heap allocations of the storage that is supposed to avoid them
+// (SmallVector spills, arena blocks and the DWARF tables), see Benchmark.
+// The hooks are a single relaxed load while counting is off. Debug builds
+// with the MSVC runtime additionally count every heap allocation through a
+// CRT allocation hook, which includes QList and QString storage.
+class AllocationCounter
+{
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    static void add()
+    {
+        if (isEnabled())
+        {
+            s_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    static qint64 count();
+
+    // -1 if the runtime can't count every heap allocation
+    static qint64 heapCount();
+
+private:
+    static std::atomic<bool> s_enabled;
+    static std::atomic<qint64> s_count;
+};
@@ -0,0 +1,100 @@
+#include "Arena.h"
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+Arena::Arena()
+    : m_blocks()
+    , m_current(nullptr)
+    , m_end(nullptr)
+    , m_reservedBytes(0)
+    , m_usedBytes(0)
+{
+}
+
+Arena::~Arena()
+{
+    for (char* block : m_blocks)
+    {
+        free(block);
+    }
+}
+
+void* Arena::allocate(qsizetype size, qsizetype alignment)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+
+    char* p = (char*)(((quintptr)m_current + (alignment - 1)) & ~(quintptr)(alignment - 1));
+
+    if (!m_current || p + size > m_end)
+    {
+        // big allocations get a block of their own so they don't waste the
+        // rest of the current one
+        qsizetype blockSize = qMax(size + alignment, (qsizetype)ARENA_BLOCK_SIZE);
+        char* block = (char*)malloc(blockSize);
+        AllocationCounter::add();
+
+        m_blocks.append(block);
+        m_reservedBytes += blockSize;
+
+        p = (char*)(((quintptr)block + (alignment - 1)) & ~(quintptr)(alignment - 1));
+
+        if (blockSize > ARENA_BLOCK_SIZE)
+        {
+            m_usedBytes += size;
+            return p;
+        }
+
+        m_end = block + blockSize;
+    }
+
+    m_current = p + size;
+    m_usedBytes += size;
+
+    return p;
+}
+
+QLatin1String Arena::copyLatin1(const QString& string)
+{
+    if (string.isEmpty())
+    {
+        return QLatin1String();
+    }
+
+    QByteArray latin1 = string.toLatin1();
+    char* data = allocate<char>(latin1.size());
+
+    memcpy(data, latin1.constData(), latin1.size());
+
+    return QLatin1String(data, latin1.size());
+}
+
+void Arena::reset()
+{
+    for (char* block : m_blocks)
+    {
+        free(block);
+    }
+
+    m_blocks.clear();
+    m_current = nullptr;
+    m_end = nullptr;
+    m_reservedBytes = 0;
+    m_usedBytes = 0;
+}
+
+qint64 Arena::reservedBytes() const
+{
+    return m_reservedBytes;
+}
+
+qint64 Arena::usedBytes() const
+{
+    return m_usedBytes;
+}
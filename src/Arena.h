@@ -0,0 +1,116 @@
+#pragma once
+
+#include <qlist.h>
+#include <qstring.h>
+
+#include <cstring>
+#include <type_traits>
+
+// Bump allocator for data that lives exactly as long as the arena. Nothing
+// allocated from it is destroyed on its own, reset() drops everything at
+// once, so only trivially destructible types may be placed in it.
+class Arena
+{
+public:
+    Arena();
+    ~Arena();
+
+    void* allocate(qsizetype size, qsizetype alignment);
+
+    template <class T> T* allocate(int count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena requires a trivially destructible type");
+
+        return (T*)allocate(count * (qsizetype)sizeof(T), alignof(T));
+    }
+
+    // Copies a string into the arena and returns a view of the copy
+    QLatin1String copyLatin1(const QString& string);
+
+    void reset();
+    qint64 reservedBytes() const;
+    qint64 usedBytes() const;
+
+private:
+    QList<char*> m_blocks;
+    char* m_current;
+    char* m_end;
+    qint64 m_reservedBytes;
+    qint64 m_usedBytes;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+};
+
+// List whose storage lives in an Arena. Growing copies the elements into a
+// bigger span and abandons the old one, which is fine since the arena frees
+// everything at once anyway.
+template <class T> class ArenaList
+{
+    static_assert(std::is_trivially_copyable<T>::value, "ArenaList requires a trivially copyable type");
+
+public:
+    ArenaList()
+        : m_data(nullptr)
+        , m_size(0)
+        , m_capacity(0)
+    {
+    }
+
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    bool empty() const { return m_size == 0; }
+
+    T* begin() { return m_data; }
+    T* end() { return m_data + m_size; }
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+
+    T& operator[](int i) { return m_data[i]; }
+    const T& operator[](int i) const { return m_data[i]; }
+
+    void reserve(Arena& arena, int capacity)
+    {
+        if (capacity <= m_capacity)
+        {
+            return;
+        }
+
+        T* data = arena.allocate<T>(capacity);
+
+        if (m_size > 0)
+        {
+            memcpy(data, m_data, m_size * sizeof(T));
+        }
+
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+    void append(Arena& arena, const T& value)
+    {
+        if (m_size == m_capacity)
+        {
+            reserve(arena, m_capacity ? m_capacity * 2 : 4);
+        }
+
+        m_data[m_size++] = value;
+    }
+
+    void prepend(Arena& arena, const T& value)
+    {
+        if (m_size == m_capacity)
+        {
+            reserve(arena, m_capacity ? m_capacity * 2 : 4);
+        }
+
+        memmove(m_data + 1, m_data, m_size * sizeof(T));
+        m_data[0] = value;
+        m_size++;
+    }
+
+private:
+    T* m_data;
+    int m_size;
+    int m_capacity;
+};
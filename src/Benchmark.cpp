@@ -0,0 +1,309 @@
+#include "Benchmark.h"
+
+#include "Elf.h"
+#include "Dwarf.h"
+#include "DwarfAttributes.h"
+#include "CppCodeModel.h"
+#include "Output.h"
+#include "Diagnostics.h"
+#include "DisassemblyCache.h"
+#include "AllocationCounter.h"
+#include "Disassemblers.h"
+#include "Util.h"
+
+#include "capstone/capstone.h"
+
+#include <qelapsedtimer.h>
+#include <qthreadpool.h>
+
+#include <atomic>
+#include <qcoreapplication.h>
+
+struct AllocationCounts
+{
+    qint64 count;
+    qint64 heapCount;
+};
+
+template <class Function> static AllocationCounts countAllocations(Function function)
+{
+    qint64 count = AllocationCounter::count();
+    qint64 heapCount = AllocationCounter::heapCount();
+
+    AllocationCounter::setEnabled(true);
+    function();
+    AllocationCounter::setEnabled(false);
+
+    return { AllocationCounter::count() - count, heapCount < 0 ? -1 : AllocationCounter::heapCount() - heapCount };
+}
+
+static QString allocationsToString(const AllocationCounts& counts)
+{
+    if (counts.heapCount < 0)
+    {
+        return QCoreApplication::translate("Benchmark", "%1 allocations").arg(counts.count);
+    }
+
+    return QCoreApplication::translate("Benchmark", "%1 allocations, %2 heap allocations in total").arg(counts.count).arg(counts.heapCount);
+}
+
+static bool isTypeAttribute(Elf32_Half name)
+{
+    return name == DW_AT_fund_type
+        || name == DW_AT_user_def_type
+        || name == DW_AT_mod_fund_type
+        || name == DW_AT_mod_u_d_type;
+}
+
+static qint64 childBytes(const MemoryUsage& usage, const QString& name)
+{
+    for (const MemoryUsage& child : usage.children)
+    {
+        if (child.name == name)
+        {
+            return child.totalBytes();
+        }
+    }
+
+    return 0;
+}
+
+static QString megabytes(qint64 bytes)
+{
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 2);
+}
+
+// Parses the whole model a few times and returns the fastest run
+static qint64 timeParse(CppCodeModel& model, Dwarf* dwarf, int runCount)
+{
+    qint64 fastestMilliseconds = -1;
+
+    for (int i = 0; i < runCount; i++)
+    {
+        // every parse reports the same diagnostics again
+        model.setDwarf(nullptr);
+        Diagnostics::clear();
+
+        QElapsedTimer timer;
+        timer.start();
+        model.setDwarf(dwarf);
+        qint64 milliseconds = timer.elapsed();
+
+        if (fastestMilliseconds < 0 || milliseconds < fastestMilliseconds)
+        {
+            fastestMilliseconds = milliseconds;
+        }
+    }
+
+    return fastestMilliseconds;
+}
+
+// How PPC functions were disassembled before the per-thread handles: a
+// handle opened and configured per function and an instruction array
+// allocated by cs_disasm. Only the capstone part is kept, the text of the
+// lines isn't built.
+static size_t disassembleWithNewHandle(const Elf* elf, Elf32_Addr startAddress, Elf32_Addr endAddress)
+{
+    const uint8_t* code = (const uint8_t*)elf->getAddressData(startAddress);
+    csh handle;
+    cs_insn* insn;
+
+    if (!code || cs_open(CS_ARCH_PPC, (cs_mode)(CS_MODE_32 + CS_MODE_BIG_ENDIAN), &handle) != CS_ERR_OK)
+    {
+        return 0;
+    }
+
+    cs_option(handle, CS_OPT_SKIPDATA, CS_OPT_ON);
+
+    size_t count = cs_disasm(handle, code, endAddress - startAddress, startAddress, 0, &insn);
+
+    if (count > 0)
+    {
+        cs_free(insn, count);
+    }
+
+    cs_close(&handle);
+
+    return count;
+}
+
+static QString instructionsPerSecond(qint64 instructionCount, qint64 milliseconds)
+{
+    return QString::number(instructionCount * 1000.0 / qMax(milliseconds, (qint64)1), 'f', 0);
+}
+
+// dwarfexplorer --benchmark <elf>
+int Benchmark::run(const QString& path)
+{
+    // plain structs, destroy() must not see garbage pointers
+    Elf elf{};
+    Dwarf dwarf{};
+
+    if (elf.read(qPrintable(path)) != Elf::ReadSuccess)
+    {
+        Output::write(QCoreApplication::translate("Benchmark", "Could not read ELF file %1").arg(path));
+        return 1;
+    }
+
+    Dwarf::ReadResult readResult = Dwarf::ReadSuccess;
+
+    AllocationCounts readAllocations = countAllocations([&]
+        {
+            readResult = dwarf.read(&elf);
+        });
+
+    if (readResult != Dwarf::ReadSuccess)
+    {
+        Output::write(QCoreApplication::translate("Benchmark", "Could not read DWARF from file %1").arg(path));
+        elf.destroy();
+        return 1;
+    }
+
+    Output::write(QCoreApplication::translate("Benchmark", "Reading DWARF: %1").arg(allocationsToString(readAllocations)));
+
+    // the same decoding the code model and the DWARF tree do for every
+    // member, parameter and variable
+    int typeCount = 0;
+    int locationCount = 0;
+
+    AllocationCounts decodeAllocations = countAllocations([&]
+        {
+            for (int i = 0; i < dwarf.attributeCount; i++)
+            {
+                DwarfAttribute* attribute = &dwarf.attributes[i];
+
+                if (isTypeAttribute(attribute->name))
+                {
+                    DwarfType type;
+                    type.read(&dwarf, attribute);
+                    typeCount++;
+                }
+                else if (attribute->name == DW_AT_location)
+                {
+                    DwarfLocation location;
+                    location.read(&dwarf, attribute);
+                    locationCount++;
+                }
+            }
+        });
+
+    Output::write(QCoreApplication::translate("Benchmark", "Decoding %1 types and %2 locations: %3")
+        .arg(typeCount)
+        .arg(locationCount)
+        .arg(allocationsToString(decodeAllocations)));
+
+    // every compile unit is parsed right away, like with lazy parsing off
+    CppCodeModel model;
+    model.settings().lazyParsing = false;
+
+    AllocationCounts parseAllocations = countAllocations([&]
+        {
+            model.setDwarf(&dwarf);
+        });
+
+    Output::write(QCoreApplication::translate("Benchmark", "Parsing the C++ code model: %1").arg(allocationsToString(parseAllocations)));
+
+    // counting slows the parse down, so it's timed separately. Compile
+    // units are parsed in parallel, a single pool thread makes the parse
+    // serial since parallelFor then finds no idle thread to help.
+    const int parseRunCount = 5;
+    QThreadPool* pool = QThreadPool::globalInstance();
+    int threadCount = pool->maxThreadCount();
+
+    pool->setMaxThreadCount(1);
+    qint64 serialParseMilliseconds = timeParse(model, &dwarf, parseRunCount);
+    pool->setMaxThreadCount(threadCount);
+    qint64 parseMilliseconds = timeParse(model, &dwarf, parseRunCount);
+
+    MemoryUsage usage = model.memoryUsage();
+
+    Output::write(QCoreApplication::translate("Benchmark", "Parsing the C++ code model: %1 ms on 1 thread, %2 ms on %3 threads (%4x speedup, fastest of %5)")
+        .arg(serialParseMilliseconds)
+        .arg(parseMilliseconds)
+        .arg(threadCount)
+        .arg(serialParseMilliseconds / (double)qMax(parseMilliseconds, (qint64)1), 0, 'f', 2)
+        .arg(parseRunCount));
+    Output::write(QCoreApplication::translate("Benchmark", "C++ code model memory: %1 MiB, %2 MiB of it in arenas")
+        .arg(megabytes(usage.totalBytes()))
+        .arg(megabytes(childBytes(usage, "Arenas"))));
+
+    // decodes every function in the binary on the thread pool
+    QElapsedTimer disassemblyTimer;
+    disassemblyTimer.start();
+    DisassemblyCache::start(&dwarf);
+    DisassemblyCache::waitForFinished();
+    qint64 disassemblyMilliseconds = disassemblyTimer.elapsed();
+
+    qint64 instructionCount = 0;
+
+    for (int i = 0; i < DisassemblyCache::functionCount(); i++)
+    {
+        const DisassemblyCacheEntry& entry = DisassemblyCache::function(i);
+
+        if (entry.state.loadAcquire() == DisassemblyCache::Done)
+        {
+            instructionCount += entry.disassembly.lineCount();
+        }
+    }
+
+    Output::write(QCoreApplication::translate("Benchmark", "Disassembling %1 functions: %2 instructions in %3 ms (%4 instructions/sec)")
+        .arg(DisassemblyCache::functionCount())
+        .arg(instructionCount)
+        .arg(disassemblyMilliseconds)
+        .arg(instructionsPerSecond(instructionCount, disassemblyMilliseconds)));
+
+    // the same functions again, once the current way and once the way it was
+    // done before the per-thread handles, both spread over the pool the same
+    // way. The current way also stores the instruction records, the
+    // reference only decodes.
+    if (elf.header->e_machine == EM_PPC)
+    {
+        int functionCount = DisassemblyCache::functionCount();
+        std::atomic<qint64> currentCount(0);
+        std::atomic<qint64> referenceCount(0);
+
+        QElapsedTimer currentTimer;
+        currentTimer.start();
+
+        Util::parallelFor(functionCount, [&](int i)
+            {
+                const DisassemblyCacheEntry& entry = DisassemblyCache::function(i);
+                Disassembly disassembly;
+
+                if (Disassemblers::disassemble(disassembly, &elf, entry.startAddress, entry.endAddress))
+                {
+                    currentCount += disassembly.lineCount();
+                }
+            });
+
+        qint64 currentMilliseconds = currentTimer.elapsed();
+
+        QElapsedTimer referenceTimer;
+        referenceTimer.start();
+
+        Util::parallelFor(functionCount, [&](int i)
+            {
+                const DisassemblyCacheEntry& entry = DisassemblyCache::function(i);
+
+                referenceCount += (qint64)disassembleWithNewHandle(&elf, entry.startAddress, entry.endAddress);
+            });
+
+        qint64 referenceMilliseconds = referenceTimer.elapsed();
+
+        Output::write(QCoreApplication::translate("Benchmark", "Disassembling with per-thread handles: %1 instructions in %2 ms (%3 instructions/sec)")
+            .arg(currentCount.load())
+            .arg(currentMilliseconds)
+            .arg(instructionsPerSecond(currentCount, currentMilliseconds)));
+        Output::write(QCoreApplication::translate("Benchmark", "Disassembling with a handle per function: %1 instructions in %2 ms (%3 instructions/sec)")
+            .arg(referenceCount.load())
+            .arg(referenceMilliseconds)
+            .arg(instructionsPerSecond(referenceCount, referenceMilliseconds)));
+    }
+
+    DisassemblyCache::clear();
+    model.setDwarf(nullptr);
+    dwarf.destroy();
+    elf.destroy();
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <qstring.h>
+
+// Headless measurements of loading a file, for comparing builds against each
+// other. Results are written to the output.
+class Benchmark
+{
+public:
+    static int run(const QString& path);
+};
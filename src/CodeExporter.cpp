@@ -0,0 +1,151 @@
+#include "CodeExporter.h"
+
+#include "CodeSink.h"
+#include "DisassemblyCache.h"
+#include "Util.h"
+#include "Trace.h"
+
+#include <qdir.h>
+#include <qfile.h>
+#include <qfileinfo.h>
+#include <qmutex.h>
+#include <qset.h>
+#include <qelapsedtimer.h>
+#include <qcoreapplication.h>
+
+#include <atomic>
+
+CodeExportResult CodeExporter::exportAll(AbstractCodeModel* model, const QString& directory, ProgressCallback progressCallback)
+{
+    TRACE_SCOPE("CodeExporter::exportAll");
+
+    QStringList paths = model->filePaths();
+    QStringList outputFilePaths = outputPaths(directory, paths);
+    QMutex errorMutex;
+    std::atomic<int> failedCount(0);
+    std::atomic<int> exportedCount(0);
+    CodeExportResult result;
+    QElapsedTimer timer;
+
+    result.fileCount = paths.size();
+    result.failedCount = 0;
+    timer.start();
+
+    // exported files shouldn't say the disassembly is still being loaded
+    DisassemblyCache::waitForFinished();
+
+    Util::parallelFor(paths.size(), [&](int i)
+        {
+            TRACE_SCOPE_DETAIL("CodeExporter::exportFile", paths[i]);
+
+            const QString& outputFilePath = outputFilePaths[i];
+            QString error;
+            QFile file(outputFilePath);
+
+            if (!QDir().mkpath(QFileInfo(outputFilePath).path()) || !file.open(QFile::WriteOnly))
+            {
+                error = QCoreApplication::translate("CodeExporter", "Could not open file %1").arg(outputFilePath);
+            }
+            else
+            {
+                // writes are reentrant, so every file streams straight from
+                // the model to disk
+                DeviceCodeSink sink(&file);
+                model->writeFile(sink, paths[i]);
+
+                if (!sink.flush())
+                {
+                    error = QCoreApplication::translate("CodeExporter", "Could not write file %1").arg(outputFilePath);
+                }
+            }
+
+            if (!error.isEmpty())
+            {
+                failedCount++;
+
+                QMutexLocker locker(&errorMutex);
+
+                if (result.error.isEmpty())
+                {
+                    result.error = error;
+                }
+            }
+
+            int count = ++exportedCount;
+
+            if (progressCallback)
+            {
+                progressCallback(count, paths.size());
+            }
+        });
+
+    result.failedCount = failedCount;
+    result.milliseconds = timer.elapsed();
+
+    return result;
+}
+
+QString CodeExporter::summary(const CodeExportResult& result, const QString& directory)
+{
+    return QCoreApplication::translate("CodeExporter", "Exported %1 files to %2 in %3 s (%4 files/sec)")
+        .arg(result.fileCount - result.failedCount)
+        .arg(directory)
+        .arg(result.milliseconds / 1000.0, 0, 'f', 2)
+        .arg(result.fileCount * 1000.0 / qMax(result.milliseconds, (qint64)1), 0, 'f', 1);
+}
+
+QString CodeExporter::outputPath(const QString& directory, const QString& path)
+{
+    QStringList parts;
+
+    // compile unit paths are usually absolute paths from the machine the
+    // game was built on, so they're made relative to the output directory
+    for (QString part : QString(path).replace(QChar('\\'), QChar('/')).split('/', Qt::SkipEmptyParts))
+    {
+        if (part == "." || part == "..")
+        {
+            continue;
+        }
+
+        parts.append(part.remove(QChar(':')));
+    }
+
+    return QDir(directory).filePath(parts.join('/'));
+}
+
+QStringList CodeExporter::outputPaths(const QString& directory, const QStringList& paths)
+{
+    QStringList outputFilePaths;
+    QSet<QString> usedOutputFilePaths;
+
+    // paths that differ only in case are the same file on Windows
+    auto key = [](const QString& outputFilePath)
+        {
+#ifdef Q_OS_WIN
+            return outputFilePath.toLower();
+#else
+            return outputFilePath;
+#endif
+        };
+
+    for (const QString& path : paths)
+    {
+        QString outputFilePath = outputPath(directory, path);
+
+        if (usedOutputFilePaths.contains(key(outputFilePath)))
+        {
+            QFileInfo info(outputFilePath);
+            QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+
+            for (int number = 2; usedOutputFilePaths.contains(key(outputFilePath)); number++)
+            {
+                outputFilePath = QDir(info.path()).filePath(QString("%1_%2%3").arg(info.completeBaseName()).arg(number).arg(suffix));
+            }
+        }
+
+        usedOutputFilePaths.insert(key(outputFilePath));
+        outputFilePaths.append(outputFilePath);
+    }
+
+    return outputFilePaths;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "AbstractCodeModel.h"
+
+#include <qstring.h>
+#include <qstringlist.h>
+
+struct CodeExportResult
+{
+    int fileCount;
+    int failedCount;
+    qint64 milliseconds;
+    QString error;
+};
+
+class CodeExporter
+{
+public:
+    typedef void(*ProgressCallback)(int exportedCount, int fileCount);
+
+    // Writes every file of the model into directory, mirroring the directory
+    // tree of the original paths. Files are written in parallel, and the
+    // progress callback is called from the writing thread after every file.
+    static CodeExportResult exportAll(AbstractCodeModel* model, const QString& directory, ProgressCallback progressCallback = nullptr);
+
+    static QString summary(const CodeExportResult& result, const QString& directory);
+
+    // Where the file with the given original path ends up inside directory
+    static QString outputPath(const QString& directory, const QString& path);
+
+    // Output paths of all files. Different paths can end up at the same
+    // output path, those get a number appended so every file has its own.
+    static QStringList outputPaths(const QString& directory, const QStringList& paths);
+};
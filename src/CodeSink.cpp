@@ -0,0 +1,140 @@
+#include "CodeSink.h"
+
+#define DEVICE_CODE_SINK_BUFFER_SIZE (64 * 1024)
+
+CodeSink::~CodeSink()
+{
+}
+
+void CodeSink::writeToken(CodeTokenKind kind, const QString& text, Elf32_Off target)
+{
+    write(text);
+}
+
+void CodeSink::writeToken(CodeTokenKind kind, QLatin1String text, Elf32_Off target)
+{
+    write(text);
+}
+
+void CodeSink::writeTokens(const QString& text, const QList<CodeToken>& tokens)
+{
+    write(text);
+}
+
+StringCodeSink::StringCodeSink(QString& string)
+    : m_string(string)
+{
+}
+
+void StringCodeSink::write(const QString& text)
+{
+    m_string += text;
+}
+
+void StringCodeSink::write(QLatin1String text)
+{
+    m_string += text;
+}
+
+TokenCodeSink::TokenCodeSink(QString& string, QList<CodeToken>& tokens)
+    : m_string(string)
+    , m_tokens(tokens)
+{
+}
+
+void TokenCodeSink::write(const QString& text)
+{
+    m_string += text;
+}
+
+void TokenCodeSink::write(QLatin1String text)
+{
+    m_string += text;
+}
+
+void TokenCodeSink::writeToken(CodeTokenKind kind, const QString& text, Elf32_Off target)
+{
+    if (!text.isEmpty())
+    {
+        m_tokens.append({ (int)m_string.size(), (int)text.size(), kind, target });
+        m_string += text;
+    }
+}
+
+void TokenCodeSink::writeToken(CodeTokenKind kind, QLatin1String text, Elf32_Off target)
+{
+    if (!text.isEmpty())
+    {
+        m_tokens.append({ (int)m_string.size(), (int)text.size(), kind, target });
+        m_string += text;
+    }
+}
+
+void TokenCodeSink::writeTokens(const QString& text, const QList<CodeToken>& tokens)
+{
+    int position = m_string.size();
+
+    m_tokens.reserve(m_tokens.size() + tokens.size());
+
+    for (const CodeToken& token : tokens)
+    {
+        m_tokens.append({ position + token.position, token.length, token.kind, token.target });
+    }
+
+    m_string += text;
+}
+
+DeviceCodeSink::DeviceCodeSink(QIODevice* device)
+    : m_device(device)
+    , m_buffer()
+    , m_error(false)
+{
+    m_buffer.reserve(DEVICE_CODE_SINK_BUFFER_SIZE);
+}
+
+DeviceCodeSink::~DeviceCodeSink()
+{
+    flush();
+}
+
+void DeviceCodeSink::write(const QString& text)
+{
+    m_buffer += text.toLatin1();
+
+    if (m_buffer.size() >= DEVICE_CODE_SINK_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void DeviceCodeSink::write(QLatin1String text)
+{
+    m_buffer.append(text.data(), text.size());
+
+    if (m_buffer.size() >= DEVICE_CODE_SINK_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+bool DeviceCodeSink::flush()
+{
+    if (m_buffer.isEmpty())
+    {
+        return !m_error;
+    }
+
+    if (m_device->write(m_buffer) != m_buffer.size())
+    {
+        m_error = true;
+    }
+
+    m_buffer.resize(0);
+
+    return !m_error;
+}
+
+bool DeviceCodeSink::hasError() const
+{
+    return m_error;
+}
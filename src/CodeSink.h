@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Elf.h"
+
+#include <qstring.h>
+#include <qbytearray.h>
+#include <qiodevice.h>
+#include <qlist.h>
+
+enum class CodeTokenKind : quint8
+{
+    Keyword,
+    Identifier,
+    TypeReference,
+    FunctionReference,
+    Number,
+    Comment
+};
+
+// Span of written code that means something, anything between two tokens is
+// whitespace or punctuation. References carry the DWARF offset of the entry
+// they refer to.
+struct CodeToken
+{
+    int position;
+    int length;
+    CodeTokenKind kind;
+    Elf32_Off target;
+};
+
+// Destination for the code written by code models. Writers only ever append,
+// so the code can go straight to a file or pipe instead of being built up in
+// memory first.
+class CodeSink
+{
+public:
+    virtual ~CodeSink();
+
+    virtual void write(const QString& text) = 0;
+    virtual void write(QLatin1String text) = 0;
+
+    // Sinks that don't care about tokens just get the text
+    virtual void writeToken(CodeTokenKind kind, const QString& text, Elf32_Off target = 0);
+    virtual void writeToken(CodeTokenKind kind, QLatin1String text, Elf32_Off target = 0);
+    virtual void writeTokens(const QString& text, const QList<CodeToken>& tokens);
+
+    CodeSink& operator+=(const QString& text) { write(text); return *this; }
+    CodeSink& operator+=(QLatin1String text) { write(text); return *this; }
+    CodeSink& operator+=(const char* text) { write(QLatin1String(text)); return *this; }
+};
+
+// Appends to a string, used for everything that ends up in the editor
+class StringCodeSink : public CodeSink
+{
+public:
+    StringCodeSink(QString& string);
+
+    void write(const QString& text) override;
+    void write(QLatin1String text) override;
+
+private:
+    QString& m_string;
+};
+
+// Appends to a string and keeps track of the tokens written to it, token
+// positions are indices into the string
+class TokenCodeSink : public CodeSink
+{
+public:
+    TokenCodeSink(QString& string, QList<CodeToken>& tokens);
+
+    void write(const QString& text) override;
+    void write(QLatin1String text) override;
+    void writeToken(CodeTokenKind kind, const QString& text, Elf32_Off target = 0) override;
+    void writeToken(CodeTokenKind kind, QLatin1String text, Elf32_Off target = 0) override;
+    void writeTokens(const QString& text, const QList<CodeToken>& tokens) override;
+
+private:
+    QString& m_string;
+    QList<CodeToken>& m_tokens;
+};
+
+// Writes Latin-1 to a device (file, pipe, ...) through a fixed size buffer
+class DeviceCodeSink : public CodeSink
+{
+public:
+    DeviceCodeSink(QIODevice* device);
+    ~DeviceCodeSink();
+
+    void write(const QString& text) override;
+    void write(QLatin1String text) override;
+
+    bool flush();
+    bool hasError() const;
+
+private:
+    QIODevice* m_device;
+    QByteArray m_buffer;
+    bool m_error;
+
+    DeviceCodeSink(const DeviceCodeSink&) = delete;
+    DeviceCodeSink& operator=(const DeviceCodeSink&) = delete;
+};
@@ -8,7 +8,36 @@
 #include <qmessagebox.h>
 #include <qscrollbar.h>
 
-#include <Qsci/qscilexercpp.h>
+// styles of the code tokens, the code is styled straight from the tokens
+// the code model writes instead of being lexed again
+enum CodeStyle
+{
+    DefaultStyle,
+    KeywordStyle,
+    IdentifierStyle,
+    TypeReferenceStyle,
+    FunctionReferenceStyle,
+    NumberStyle,
+    CommentStyle
+};
+
+// indicator over references, its value is the index of the token + 1
+#define LINK_INDICATOR 8
+
+static int tokenStyle(CodeTokenKind kind)
+{
+    switch (kind)
+    {
+    case CodeTokenKind::Keyword: return KeywordStyle;
+    case CodeTokenKind::Identifier: return IdentifierStyle;
+    case CodeTokenKind::TypeReference: return TypeReferenceStyle;
+    case CodeTokenKind::FunctionReference: return FunctionReferenceStyle;
+    case CodeTokenKind::Number: return NumberStyle;
+    case CodeTokenKind::Comment: return CommentStyle;
+    }
+
+    return DefaultStyle;
+}
 
 CodeView::CodeView(QWidget* parent)
     : QWidget(parent)
@@ -16,24 +45,32 @@ CodeView::CodeView(QWidget* parent)
     , m_model(nullptr)
     , m_editor(new QsciScintilla(this))
     , m_code()
+    , m_tokens()
     , m_pathLineEdit(new QLineEdit(this))
     , m_saveButton(new QPushButton(Icons::saveIcon(), QString(), this))
     , m_settingsButton(new QPushButton(Icons::settingsIcon(), QString(), this))
     , m_settingsMenu(new QMenu(this))
 {
-    QsciLexer* lexer = new QsciLexerCPP(m_editor);
-
-    QFont monospaceFont = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPointSize(11);
+
+    m_editor->setLexer(nullptr);
+    m_editor->setUtf8(false);
+    m_editor->setFont(font);
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STYLECLEARALL);
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STYLESETFORE, KeywordStyle, QColor(0x00, 0x00, 0x7f));
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STYLESETBOLD, KeywordStyle, 1);
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STYLESETFORE, IdentifierStyle, QColor(0x00, 0x00, 0x00));
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STYLESETFORE, TypeReferenceStyle, QColor(0x2b, 0x91, 0xaf));
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STYLESETFORE, FunctionReferenceStyle, QColor(0x74, 0x53, 0x1f));
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STYLESETFORE, NumberStyle, QColor(0x00, 0x7f, 0x7f));
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STYLESETFORE, CommentStyle, QColor(0x00, 0x7f, 0x00));
+
+    // references are underlined while hovered and can be ctrl+clicked
+    m_editor->SendScintilla(QsciScintillaBase::SCI_INDICSETSTYLE, LINK_INDICATOR, QsciScintillaBase::INDIC_HIDDEN);
+    m_editor->SendScintilla(QsciScintillaBase::SCI_INDICSETHOVERSTYLE, LINK_INDICATOR, QsciScintillaBase::INDIC_PLAIN);
+    m_editor->SendScintilla(QsciScintillaBase::SCI_INDICSETHOVERFORE, LINK_INDICATOR, QColor(0x00, 0x00, 0xff));
 
-    for (int style = 0; style <= QsciScintillaBase::STYLE_MAX; style++)
-    {
-        QFont font = lexer->font(style);
-        font.setFamily(monospaceFont.family());
-        font.setPointSize(11);
-        lexer->setFont(font, style);
-    }
-
-    m_editor->setLexer(lexer);
     m_editor->setWrapMode(QsciScintilla::WrapWhitespace);
     m_editor->setWrapIndentMode(QsciScintilla::WrapIndentIndented);
     m_editor->setIndentationsUseTabs(false);
@@ -62,6 +99,7 @@ CodeView::CodeView(QWidget* parent)
     clear();
 
     connect(m_saveButton, &QPushButton::clicked, this, &CodeView::onSaveButtonClicked);
+    connect(m_editor, &QsciScintilla::indicatorReleased, this, &CodeView::onEditorIndicatorReleased);
 }
 
 void CodeView::clear()
@@ -113,9 +151,33 @@ void CodeView::viewFile(const QString& path)
     refresh(false);
 }
 
+void CodeView::write(CodeSink& sink)
+{
+    if (!m_model)
+    {
+        return;
+    }
+
+    switch (m_viewInfo.mode)
+    {
+    case ViewInfo::None:
+        break;
+    case ViewInfo::DwarfEntry:
+        m_model->writeDwarfEntry(sink, m_viewInfo.dwarfEntryOffset);
+        break;
+    case ViewInfo::File:
+        m_model->writeFile(sink, m_viewInfo.filePath);
+        break;
+    }
+}
+
 void CodeView::refresh(bool retainScroll)
 {
     m_code.clear();
+    m_tokens.clear();
+
+    TokenCodeSink sink(m_code, m_tokens);
+    write(sink);
 
     if (m_model)
     {
@@ -124,11 +186,9 @@ void CodeView::refresh(bool retainScroll)
         case ViewInfo::None:
             break;
         case ViewInfo::DwarfEntry:
-            m_model->writeDwarfEntry(m_code, m_viewInfo.dwarfEntryOffset);
             m_pathLineEdit->setText(m_model->dwarfEntryName(m_viewInfo.dwarfEntryOffset));
             break;
         case ViewInfo::File:
-            m_model->writeFile(m_code, m_viewInfo.filePath);
             m_pathLineEdit->setText(m_viewInfo.filePath);
             break;
         }
@@ -143,11 +203,46 @@ void CodeView::refresh(bool retainScroll)
         // todo: this doesn't work right
         int firstVisibleLine = m_editor->firstVisibleLine();
         m_editor->setText(m_code);
+        applyTokens();
         m_editor->setFirstVisibleLine(firstVisibleLine);
     }
     else
     {
         m_editor->setText(m_code);
+        applyTokens();
+    }
+}
+
+void CodeView::applyTokens()
+{
+    int position = 0;
+
+    m_editor->SendScintilla(QsciScintillaBase::SCI_STARTSTYLING, 0);
+    m_editor->SendScintilla(QsciScintillaBase::SCI_SETINDICATORCURRENT, LINK_INDICATOR);
+
+    for (int i = 0; i < m_tokens.size(); i++)
+    {
+        const CodeToken& token = m_tokens[i];
+
+        if (token.position > position)
+        {
+            m_editor->SendScintilla(QsciScintillaBase::SCI_SETSTYLING, token.position - position, DefaultStyle);
+        }
+
+        m_editor->SendScintilla(QsciScintillaBase::SCI_SETSTYLING, token.length, tokenStyle(token.kind));
+
+        if (token.kind == CodeTokenKind::TypeReference || token.kind == CodeTokenKind::FunctionReference)
+        {
+            m_editor->SendScintilla(QsciScintillaBase::SCI_SETINDICATORVALUE, i + 1);
+            m_editor->SendScintilla(QsciScintillaBase::SCI_INDICATORFILLRANGE, token.position, token.length);
+        }
+
+        position = token.position + token.length;
+    }
+
+    if (position < m_code.size())
+    {
+        m_editor->SendScintilla(QsciScintillaBase::SCI_SETSTYLING, m_code.size() - position, DefaultStyle);
     }
 }
 
@@ -165,7 +260,31 @@ void CodeView::onSaveButtonClicked()
             return;
         }
 
-        file.write(m_editor->text().toLatin1());
+        // written straight from the model rather than copied out of the
+        // editor, so the whole text never has to be held in memory twice
+        DeviceCodeSink sink(&file);
+        write(sink);
+
+        if (!sink.flush())
+        {
+            QMessageBox::warning(this, tr("Save error"), tr("Could not write file."));
+        }
+    }
+}
+
+void CodeView::onEditorIndicatorReleased(int line, int index, Qt::KeyboardModifiers state)
+{
+    if (!(state & Qt::ControlModifier))
+    {
+        return;
+    }
+
+    int position = m_editor->positionFromLineIndex(line, index);
+    int value = (int)m_editor->SendScintilla(QsciScintillaBase::SCI_INDICATORVALUEAT, LINK_INDICATOR, position);
+
+    if (value > 0 && value <= m_tokens.size())
+    {
+        viewDwarfEntry(m_tokens[value - 1].target);
     }
 }
 
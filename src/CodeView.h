@@ -42,14 +42,18 @@ private:
     AbstractCodeModel* m_model;
     QsciScintilla* m_editor;
     QString m_code;
+    QList<CodeToken> m_tokens;
     QLineEdit* m_pathLineEdit;
     QPushButton* m_saveButton;
     QPushButton* m_settingsButton;
     QMenu* m_settingsMenu;
 
+    void write(CodeSink& sink);
     void refresh(bool retainScroll);
+    void applyTokens();
 
 private slots:
     void onSaveButtonClicked();
+    void onEditorIndicatorReleased(int line, int index, Qt::KeyboardModifiers state);
     void onModelRewriteRequested();
 };
@@ -3,64 +3,86 @@
 #include "Output.h"
 #include "Util.h"
 #include "CppFundamentalTypeNamesDialog.h"
-#include "Disassemblers.h"
+#include "DisassemblyCache.h"
+#include "Trace.h"
+#include "Demangler.h"
+#include "SortKeys.h"
 
 #include <qdir.h>
 #include <qsettings.h>
+#include <qmutex.h>
 
-//#define MAX_WARNINGS_ACTIVE
-#define MAX_WARNINGS 100
-
-#ifdef MAX_WARNINGS_ACTIVE
-static int s_warningCount = 0;
-#endif
-
-static const QMap<QString, QString> operatorDemangleMap =
-{
-    { "__as", "operator=" },
-    { "__nw", "operator new" },
-    { "__dl", "operator delete" },
-    { "__nwa", "operator new[]" },
-    { "__dla", "operator delete[]" },
-    { "__pl", "operator+" },
-    { "__mi", "operator-" },
-    { "__ml", "operator*" },
-    { "__dv", "operator/" },
-    { "__md", "operator%" },
-    { "__er", "operator^" },
-    { "__ad", "operator&" },
-    { "__or", "operator|" },
-    { "__co", "operator~" },
-    { "__nt", "operator!" },
-    { "__lt", "operator<" },
-    { "__gt", "operator>" },
-    { "__apl", "operator+=" },
-    { "__ami", "operator-=" },
-    { "__amu", "operator*=" },
-    { "__adv", "operator/=" },
-    { "__amd", "operator%=" },
-    { "__aer", "operator^=" },
-    { "__aad", "operator&=" },
-    { "__aor", "operator|=" },
-    { "__ls", "operator<<" },
-    { "__rs", "operator>>" },
-    { "__als", "operator<<=" },
-    { "__ars", "operator>>=" },
-    { "__eq", "operator==" },
-    { "__ne", "operator!=" },
-    { "__le", "operator<=" },
-    { "__ge", "operator>=" },
-    { "__aa", "operator&&" },
-    { "__oo", "operator||" },
-    { "__pp", "operator++" },
-    { "__mm", "operator--" },
-    { "__cm", "operator," },
-    { "__rm", "operator->*" },
-    { "__rf", "operator*" },
-    { "__cl", "operator()" },
-    { "__vc", "operator[]" },
+// diagnostics raised while parsing a compile unit on a worker thread,
+// flushed in compile unit order once all of them have been parsed
+static thread_local QList<Diagnostic>* s_diagnosticBuffer = nullptr;
+
+// max number of characters kept in the fragment cache
+#define MAX_FRAGMENT_CACHE_COST (16 * 1024 * 1024)
+
+// bits of the settings that change how fragments are written, see
+// CppCodeModel::fragmentSettings
+enum FragmentSetting : quint64
+{
+    WriteDwarfEntryOffsetsSetting = 1ull << 0,
+    WriteClassSizesSetting = 1ull << 1,
+    WriteClassMemberOffsetsSetting = 1ull << 2,
+    WriteClassMemberBitOffsetsSetting = 1ull << 3,
+    WriteClassMemberBitSizesSetting = 1ull << 4,
+    WriteVariableAddressesSetting = 1ull << 5,
+    WriteVariableMangledNamesSetting = 1ull << 6,
+    WriteFunctionMangledNamesSetting = 1ull << 7,
+    WriteFunctionAddressesSetting = 1ull << 8,
+    WriteFunctionSizesSetting = 1ull << 9,
+    WriteFunctionVariableLocationsSetting = 1ull << 10,
+    WriteFunctionDisassemblySetting = 1ull << 11,
+    WriteLineNumbersSetting = 1ull << 12,
+    WriteLineNumberAddressesSetting = 1ull << 13,
+    SortFunctionsByLineNumberSetting = 1ull << 14,
+    TreatClassesAsStructsSetting = 1ull << 15,
+    HideThisParameterSetting = 1ull << 16,
+    StaticMemberFunctionsSetting = 1ull << 17,
+    AnonymousStructsUnionsSetting = 1ull << 18,
+    InlineMetrowerksAnonymousTypesSetting = 1ull << 19,
+    HexadecimalEnumValuesSetting = 1ull << 20,
+    ForceExplicitEnumValuesSetting = 1ull << 21,
+
+    // not a setting, but function definitions written before the disassembly
+    // cache was ready have to be written again once it is
+    DisassemblyReadySetting = 1ull << 22,
+
+    // anything that spells out a type
+    TypeSettings = InlineMetrowerksAnonymousTypesSetting | HideThisParameterSetting,
+
+    EnumTypeSettings = TypeSettings | WriteDwarfEntryOffsetsSetting | HexadecimalEnumValuesSetting | ForceExplicitEnumValuesSetting,
+
+    ClassTypeSettings = EnumTypeSettings | WriteClassSizesSetting | WriteClassMemberOffsetsSetting | WriteClassMemberBitOffsetsSetting
+        | WriteClassMemberBitSizesSetting | SortFunctionsByLineNumberSetting | TreatClassesAsStructsSetting | StaticMemberFunctionsSetting
+        | AnonymousStructsUnionsSetting,
+
+    // fragments that wrote an anonymous class or enum inline also depend on
+    // everything the class would
+    InlineTypeSettings = ClassTypeSettings
+};
+
+// arena of the compile unit being parsed on this thread, everything parsed
+// from it is allocated there
+static thread_local Arena* s_arena = nullptr;
+
+// type spellings rendered on this thread, dropped whenever the generation
+// or type settings they were rendered with no longer match
+struct TypeSpellingCache
+{
+    quint64 generation;
+    quint64 settings;
+    QHash<quint64, Cpp::TypeSpelling> spellings;
 };
 
+static QAtomicInteger<quint64> s_typeSpellingGenerations;
+static thread_local TypeSpellingCache s_typeSpellingCache = { 0, 0, {} };
+
+#define MAX_TYPE_SPELLING_MODIFIERS 7
+#define MAX_TYPE_DEPENDENCY_DEPTH 32
+
 CppCodeModelSettings CppCodeModel::s_defaultSettings
 {
     true, // warnUnknownEntries
@@ -90,6 +112,7 @@ CppCodeModelSettings CppCodeModel::s_defaultSettings
     true, // writeLineNumbers
     true, // writeLineNumberAddresses
     false, // sortTypesAlphabetically
+    true, // orderTypesByDependency
     true, // sortFunctionsByLineNumber
     false, // treatClassesAsStructs
     true, // hideThisParameter
@@ -98,6 +121,8 @@ CppCodeModelSettings CppCodeModel::s_defaultSettings
     true, // inlineMetrowerksAnonymousTypes
     false, // hexadecimalEnumValues
     false, // forceExplicitEnumValues
+    false, // lazyParsing
+    false, // mergeIdenticalTypes
 
     // fundamentalTypeNames
     {
@@ -140,34 +165,50 @@ QHash<Cpp::Keyword, QString> CppCodeModel::s_keywordToStringMap =
 
 static void sortFunctionsByLineNumber(QList<Cpp::Function*>& functions)
 {
-    std::sort(functions.begin(), functions.end(),
-        [](Cpp::Function* a, Cpp::Function* b) {
-            if (a->lineNumbers.isEmpty() || b->lineNumbers.isEmpty())
-            {
-                return false;
-            }
+    // functions without line numbers go last, ties keep the file order
+    QList<quint32> keys(functions.size());
 
-            return a->lineNumbers[0].line < b->lineNumbers[0].line;
-        });
+    for (int i = 0; i < functions.size(); i++)
+    {
+        keys[i] = functions[i]->lineNumbers.isEmpty() ? 0xFFFFFFFF : (quint32)functions[i]->lineNumbers[0].line;
+    }
+
+    QList<Cpp::Function*> sortedFunctions;
+
+    sortedFunctions.reserve(functions.size());
+
+    for (int i : SortKeys::sortedRows(keys))
+    {
+        sortedFunctions.append(functions[i]);
+    }
+
+    functions = sortedFunctions;
 }
 
 CppCodeModel::CppCodeModel(QObject* parent)
     : AbstractCodeModel(parent)
     , m_settings()
     , m_pathToOffsetMultiMap()
-    , m_offsetToEntryMap()
-    , m_offsetToSourceStatementTableMap()
-    , m_offsetToFileMap()
-    , m_offsetToClassTypeMap()
-    , m_offsetToEnumTypeMap()
-    , m_offsetToArrayTypeMap()
-    , m_offsetToFunctionTypeMap()
-    , m_offsetToPointerToMemberTypeMap()
-    , m_offsetToFunctionMap()
-    , m_offsetToVariableMap()
-    , m_indentLevel(0)
-    , m_minIndentLevel(0)
-    , m_firstSourceStatementTableParsed(false)
+    , m_entityKinds()
+    , m_entitySlots()
+    , m_files()
+    , m_classTypes()
+    , m_enumTypes()
+    , m_arrayTypes()
+    , m_functionTypes()
+    , m_pointerToMemberTypes()
+    , m_functions()
+    , m_variables()
+    , m_arenas()
+    , m_compileUnits()
+    , m_compileUnitsParsed()
+    , m_lazyParseMutex()
+    , m_mergedTypeCopies()
+    , m_mergedTypeFunctionOffsets()
+    , m_fragmentCache(MAX_FRAGMENT_CACHE_COST)
+    , m_fragmentCacheMutex()
+    , m_typeSpellingGeneration(++s_typeSpellingGenerations)
+    , m_firstSourceStatementTableOwner(nullptr)
 {
     loadSettings();
     saveSettings();
@@ -218,6 +259,7 @@ void CppCodeModel::loadSettings()
     m_settings.writeLineNumbers = settings.value("cppcodemodel/writeLineNumbers", s_defaultSettings.writeLineNumbers).toBool();
     m_settings.writeLineNumberAddresses = settings.value("cppcodemodel/writeLineNumberAddresses", s_defaultSettings.writeLineNumberAddresses).toBool();
     m_settings.sortTypesAlphabetically = settings.value("cppcodemodel/sortTypesAlphabetically", s_defaultSettings.sortTypesAlphabetically).toBool();
+    m_settings.orderTypesByDependency = settings.value("cppcodemodel/orderTypesByDependency", s_defaultSettings.orderTypesByDependency).toBool();
     m_settings.sortFunctionsByLineNumber = settings.value("cppcodemodel/sortFunctionsByLineNumber", s_defaultSettings.sortFunctionsByLineNumber).toBool();
     m_settings.treatClassesAsStructs = settings.value("cppcodemodel/treatClassesAsStructs", s_defaultSettings.treatClassesAsStructs).toBool();
     m_settings.hideThisParameter = settings.value("cppcodemodel/hideThisParameter", s_defaultSettings.hideThisParameter).toBool();
@@ -226,6 +268,8 @@ void CppCodeModel::loadSettings()
     m_settings.inlineMetrowerksAnonymousTypes = settings.value("cppcodemodel/inlineMetrowerksAnonymousTypes", s_defaultSettings.inlineMetrowerksAnonymousTypes).toBool();
     m_settings.hexadecimalEnumValues = settings.value("cppcodemodel/hexadecimalEnumValues", s_defaultSettings.hexadecimalEnumValues).toBool();
     m_settings.forceExplicitEnumValues = settings.value("cppcodemodel/forceExplicitEnumValues", s_defaultSettings.forceExplicitEnumValues).toBool();
+    m_settings.lazyParsing = settings.value("cppcodemodel/lazyParsing", s_defaultSettings.lazyParsing).toBool();
+    m_settings.mergeIdenticalTypes = settings.value("cppcodemodel/mergeIdenticalTypes", s_defaultSettings.mergeIdenticalTypes).toBool();
     m_settings.fundamentalTypeNames[Cpp::FundamentalType::Char] = settings.value("cppcodemodel/fundamentalTypeNames/Char", s_defaultSettings.fundamentalTypeNames[Cpp::FundamentalType::Char]).toString();
     m_settings.fundamentalTypeNames[Cpp::FundamentalType::SignedChar] = settings.value("cppcodemodel/fundamentalTypeNames/SignedChar", s_defaultSettings.fundamentalTypeNames[Cpp::FundamentalType::SignedChar]).toString();
     m_settings.fundamentalTypeNames[Cpp::FundamentalType::UnsignedChar] = settings.value("cppcodemodel/fundamentalTypeNames/UnsignedChar", s_defaultSettings.fundamentalTypeNames[Cpp::FundamentalType::UnsignedChar]).toString();
@@ -275,6 +319,7 @@ void CppCodeModel::saveSettings()
     settings.setValue("cppcodemodel/writeFunctionDisassembly", m_settings.writeFunctionDisassembly);
     settings.setValue("cppcodemodel/writeLineNumberAddresses", m_settings.writeLineNumberAddresses);
     settings.setValue("cppcodemodel/sortTypesAlphabetically", m_settings.sortTypesAlphabetically);
+    settings.setValue("cppcodemodel/orderTypesByDependency", m_settings.orderTypesByDependency);
     settings.setValue("cppcodemodel/sortFunctionsByLineNumber", m_settings.sortFunctionsByLineNumber);
     settings.setValue("cppcodemodel/treatClassesAsStructs", m_settings.treatClassesAsStructs);
     settings.setValue("cppcodemodel/hideThisParameter", m_settings.hideThisParameter);
@@ -283,6 +328,8 @@ void CppCodeModel::saveSettings()
     settings.setValue("cppcodemodel/inlineMetrowerksAnonymousTypes", m_settings.inlineMetrowerksAnonymousTypes);
     settings.setValue("cppcodemodel/hexadecimalEnumValues", m_settings.hexadecimalEnumValues);
     settings.setValue("cppcodemodel/forceExplicitEnumValues", m_settings.forceExplicitEnumValues);
+    settings.setValue("cppcodemodel/lazyParsing", m_settings.lazyParsing);
+    settings.setValue("cppcodemodel/mergeIdenticalTypes", m_settings.mergeIdenticalTypes);
     settings.setValue("cppcodemodel/fundamentalTypeNames/Char", m_settings.fundamentalTypeNames[Cpp::FundamentalType::Char]);
     settings.setValue("cppcodemodel/fundamentalTypeNames/SignedChar", m_settings.fundamentalTypeNames[Cpp::FundamentalType::SignedChar]);
     settings.setValue("cppcodemodel/fundamentalTypeNames/UnsignedChar", m_settings.fundamentalTypeNames[Cpp::FundamentalType::UnsignedChar]);
@@ -306,75 +353,457 @@ void CppCodeModel::saveSettings()
 void CppCodeModel::clear()
 {
     m_pathToOffsetMultiMap.clear();
-    m_offsetToEntryMap.clear();
-    m_offsetToSourceStatementTableMap.clear();
-    m_offsetToFileMap.clear();
-    m_offsetToClassTypeMap.clear();
-    m_offsetToEnumTypeMap.clear();
-    m_offsetToArrayTypeMap.clear();
-    m_offsetToFunctionTypeMap.clear();
-    m_offsetToPointerToMemberTypeMap.clear();
-    m_offsetToFunctionMap.clear();
-    m_offsetToVariableMap.clear();
+    m_entityKinds.clear();
+    m_entitySlots.clear();
+    m_files.clear();
+    m_classTypes.clear();
+    m_enumTypes.clear();
+    m_arrayTypes.clear();
+    m_functionTypes.clear();
+    m_pointerToMemberTypes.clear();
+    m_functions.clear();
+    m_variables.clear();
+
+    // diagnostics point into the arenas
+    Diagnostics::clear();
+    clearFragmentCache();
+
+    qDeleteAll(m_arenas);
+    m_arenas.clear();
+    m_compileUnits.clear();
+    m_compileUnitsParsed.clear();
+    m_mergedTypeCopies.clear();
+    m_mergedTypeFunctionOffsets.clear();
 
     requestRewrite();
 }
 
-void CppCodeModel::parseDwarf(Dwarf* dwarf)
+static Cpp::EntityKind entityKind(const DwarfEntry* entry)
+{
+    switch (entry->tag)
+    {
+    case DW_TAG_class_type:
+    case DW_TAG_structure_type:
+    case DW_TAG_union_type:
+        return Cpp::EntityKind::ClassType;
+    case DW_TAG_enumeration_type:
+        return Cpp::EntityKind::EnumType;
+    case DW_TAG_array_type:
+        return Cpp::EntityKind::ArrayType;
+    case DW_TAG_subroutine_type:
+        return Cpp::EntityKind::FunctionType;
+    case DW_TAG_ptr_to_member_type:
+        return Cpp::EntityKind::PointerToMemberType;
+    case DW_TAG_subroutine:
+    case DW_TAG_global_subroutine:
+    case DW_TAG_inlined_subroutine:
+        return Cpp::EntityKind::Function;
+    case DW_TAG_global_variable:
+    case DW_TAG_local_variable:
+        return Cpp::EntityKind::Variable;
+    default:
+        return Cpp::EntityKind::None;
+    }
+}
+
+void CppCodeModel::assignEntitySlots()
 {
-#ifdef MAX_WARNINGS_ACTIVE
-    s_warningCount = 0;
-#endif
+    // Mirrors the entries parseCompileUnit handles: compile units and their
+    // direct children. Everything else (e.g. locals inside subroutines) gets
+    // no slot, so looking it up misses instead of creating an empty entity.
+    Dwarf* dwarf = this->dwarf();
+    int counts[(int)Cpp::EntityKind::Count] = {};
 
-    clear();
+    m_entityKinds.fill(Cpp::EntityKind::None, dwarf->entryCount);
+    m_entitySlots.fill(-1, dwarf->entryCount);
 
-    if (!dwarf)
+    auto assign = [&](const DwarfEntry* entry, Cpp::EntityKind kind)
     {
-        return;
-    }
+        int index = (int)(entry - dwarf->entries);
 
-    if (dwarf->sourceStatementTableCount > 0)
+        m_entityKinds[index] = kind;
+        m_entitySlots[index] = counts[(int)kind]++;
+    };
+
+    for (DwarfEntry* entry = &dwarf->entries[0]; entry != nullptr; entry = entry->sibling)
     {
-        for (int i = 0; i < dwarf->sourceStatementTableCount; i++)
+        if (entry->tag != DW_TAG_compile_unit)
+        {
+            continue;
+        }
+
+        assign(entry, Cpp::EntityKind::File);
+        m_compileUnits.append(entry);
+
+        // Hack to prevent unknown line number function warnings.
+        // Some compile units have an AT_stmt_list offset of 0 if they don't have any line numbers,
+        // despite 0 being a valid offset (it's the offset of the first table in the .line section).
+        // This causes a bunch of warnings because the Cpp::File will contain all of the line numbers
+        // from the first table when it really shouldn't contain any.
+        // To get around this, only the first compile unit with offset 0 parses that table, under the
+        // assumption that it corresponds to the correct compile unit (though this might not always be true...)
+        // It's decided here so it doesn't depend on the order compile units get parsed in.
+        if (!m_firstSourceStatementTableOwner)
+        {
+            DwarfAttribute* statementListAttribute = entry->findAttribute(DW_AT_stmt_list);
+
+            if (statementListAttribute && statementListAttribute->data4 == 0)
+            {
+                m_firstSourceStatementTableOwner = entry;
+            }
+        }
+
+        for (DwarfEntry* child = entry->firstChild; child != nullptr; child = child->sibling)
         {
-            DwarfSourceStatementTable* table = &dwarf->sourceStatementTables[i];
+            Cpp::EntityKind kind = entityKind(child);
+
+            if (kind == Cpp::EntityKind::None)
+            {
+                continue;
+            }
 
-            m_offsetToSourceStatementTableMap[table->offset] = table;
+            if (isMergedType(child))
+            {
+                // share the slot of the canonical copy, which always comes first
+                int index = (int)(child - dwarf->entries);
+                int canonicalIndex = (int)(dwarf->canonicalType(child) - dwarf->entries);
+
+                m_entityKinds[index] = kind;
+                m_entitySlots[index] = m_entitySlots[canonicalIndex];
+
+                // see localTypeOffset
+                m_mergedTypeCopies.insert(((quint64)entry->offset << 32) | dwarf->entries[canonicalIndex].offset, child->offset);
+            }
+            else
+            {
+                assign(child, kind);
+            }
         }
     }
 
-    m_firstSourceStatementTableParsed = false;
+    m_files.resize(counts[(int)Cpp::EntityKind::File]);
+    m_classTypes.resize(counts[(int)Cpp::EntityKind::ClassType]);
+    m_enumTypes.resize(counts[(int)Cpp::EntityKind::EnumType]);
+    m_arrayTypes.resize(counts[(int)Cpp::EntityKind::ArrayType]);
+    m_functionTypes.resize(counts[(int)Cpp::EntityKind::FunctionType]);
+    m_pointerToMemberTypes.resize(counts[(int)Cpp::EntityKind::PointerToMemberType]);
+    m_functions.resize(counts[(int)Cpp::EntityKind::Function]);
+    m_variables.resize(counts[(int)Cpp::EntityKind::Variable]);
+    m_compileUnitsParsed = QList<QAtomicInt>(m_compileUnits.size());
+}
+
+int CppCodeModel::entitySlot(const DwarfEntry* entry, Cpp::EntityKind kind) const
+{
+    if (!entry)
+    {
+        return -1;
+    }
+
+    int index = (int)(entry - dwarf()->entries);
+
+    if (m_entityKinds[index] != kind)
+    {
+        return -1;
+    }
+
+    return m_entitySlots[index];
+}
+
+int CppCodeModel::entitySlot(Elf32_Off offset, Cpp::EntityKind kind) const
+{
+    return entitySlot(findEntry(offset), kind);
+}
+
+int CppCodeModel::resolveSlot(Elf32_Off offset, Cpp::EntityKind kind)
+{
+    DwarfEntry* entry = findEntry(offset);
+    int slot = entitySlot(entry, kind);
+
+    if (slot >= 0)
+    {
+        ensureParsed(isMergedType(entry) ? dwarf()->canonicalType(entry) : entry);
+    }
+
+    return slot;
+}
+
+bool CppCodeModel::isMergedType(DwarfEntry* entry) const
+{
+    return m_settings.mergeIdenticalTypes && dwarf()->canonicalType(entry) != entry;
+}
+
+// The entities of merged types are parsed from the canonical copy, so
+// everything they refer to is in the canonical copy's compile unit. When a
+// copy is written, references are moved over to the copies in its own
+// compile unit where there are any.
+Elf32_Off CppCodeModel::localTypeOffset(const DwarfEntry* compileUnit, Elf32_Off offset) const
+{
+    if (!compileUnit || m_mergedTypeCopies.isEmpty())
+    {
+        return offset;
+    }
+
+    return m_mergedTypeCopies.value(((quint64)compileUnit->offset << 32) | offset, offset);
+}
+
+int CppCodeModel::compileUnitIndex(const DwarfEntry* entry) const
+{
+    // compile units are in entry order
+    auto it = std::upper_bound(m_compileUnits.begin(), m_compileUnits.end(), entry,
+        [](const DwarfEntry* e, const DwarfEntry* compileUnit)
+        {
+            return e < compileUnit;
+        });
+
+    return (int)(it - m_compileUnits.begin()) - 1;
+}
+
+void CppCodeModel::ensureParsed(const DwarfEntry* entry)
+{
+    int index = compileUnitIndex(entry);
+
+    if (index < 0)
+    {
+        return;
+    }
+
+    if (m_compileUnitsParsed[index].loadAcquire())
+    {
+        return;
+    }
+
+    QMutexLocker locker(&m_lazyParseMutex);
+
+    if (m_compileUnitsParsed[index].loadRelaxed())
+    {
+        return;
+    }
+
+    QList<Diagnostic> diagnostics;
+
+    s_diagnosticBuffer = &diagnostics;
+    s_arena = m_arenas[index];
+    parseCompileUnit(m_compileUnits[index]);
+    s_arena = nullptr;
+    s_diagnosticBuffer = nullptr;
+
+    Diagnostics::add(diagnostics);
+
+    m_compileUnitsParsed[index].storeRelease(1);
+}
+
+DwarfEntry* CppCodeModel::findEntry(Elf32_Off offset) const
+{
+    return dwarf()->findEntry(offset);
+}
+
+template <class T> static T* entityAt(QList<T>& entities, int slot)
+{
+    return (slot >= 0) ? &entities[slot] : nullptr;
+}
+
+Cpp::File* CppCodeModel::findFile(Elf32_Off offset)
+{
+    return entityAt(m_files, resolveSlot(offset, Cpp::EntityKind::File));
+}
+
+Cpp::ClassType* CppCodeModel::findClassType(Elf32_Off offset)
+{
+    return entityAt(m_classTypes, resolveSlot(offset, Cpp::EntityKind::ClassType));
+}
+
+Cpp::EnumType* CppCodeModel::findEnumType(Elf32_Off offset)
+{
+    return entityAt(m_enumTypes, resolveSlot(offset, Cpp::EntityKind::EnumType));
+}
+
+Cpp::ArrayType* CppCodeModel::findArrayType(Elf32_Off offset)
+{
+    return entityAt(m_arrayTypes, resolveSlot(offset, Cpp::EntityKind::ArrayType));
+}
+
+Cpp::FunctionType* CppCodeModel::findFunctionType(Elf32_Off offset)
+{
+    return entityAt(m_functionTypes, resolveSlot(offset, Cpp::EntityKind::FunctionType));
+}
+
+Cpp::PointerToMemberType* CppCodeModel::findPointerToMemberType(Elf32_Off offset)
+{
+    return entityAt(m_pointerToMemberTypes, resolveSlot(offset, Cpp::EntityKind::PointerToMemberType));
+}
+
+Cpp::Function* CppCodeModel::findFunction(Elf32_Off offset)
+{
+    return entityAt(m_functions, resolveSlot(offset, Cpp::EntityKind::Function));
+}
+
+Cpp::Variable* CppCodeModel::findVariable(Elf32_Off offset)
+{
+    return entityAt(m_variables, resolveSlot(offset, Cpp::EntityKind::Variable));
+}
+
+MemoryUsage CppCodeModel::memoryUsage() const
+{
+    Memory::StringCounter strings;
+    MemoryUsage usage("C++ code model");
+    qint64 bytes;
+
+    bytes = Memory::mapBytes(m_pathToOffsetMultiMap);
+
+    for (auto it = m_pathToOffsetMultiMap.cbegin(); it != m_pathToOffsetMultiMap.cend(); ++it)
+    {
+        strings.add(it.key());
+    }
+
+    usage.add("Path map", bytes + strings.bytes());
+    usage.add("Entity index", Memory::listBytes(m_entityKinds) + Memory::listBytes(m_entitySlots));
+
+    bytes = Memory::hashBytes(m_mergedTypeCopies) + Memory::hashBytes(m_mergedTypeFunctionOffsets);
+
+    for (const QList<Elf32_Off>& functionOffsets : m_mergedTypeFunctionOffsets)
+    {
+        bytes += Memory::listBytes(functionOffsets);
+    }
+
+    usage.add("Merged types", bytes);
+
+    // names point into the ELF image, everything else the entities own
+    // lives in the arenas
+    usage.add("Files", Memory::listBytes(m_files));
+    usage.add("Class types", Memory::listBytes(m_classTypes));
+    usage.add("Enum types", Memory::listBytes(m_enumTypes));
+    usage.add("Array types", Memory::listBytes(m_arrayTypes));
+    usage.add("Function types", Memory::listBytes(m_functionTypes));
+    usage.add("Pointer-to-member types", Memory::listBytes(m_pointerToMemberTypes));
+    usage.add("Functions", Memory::listBytes(m_functions));
+    usage.add("Variables", Memory::listBytes(m_variables));
+
+    qint64 reservedBytes = 0;
+    qint64 usedBytes = 0;
+
+    for (const Arena* arena : m_arenas)
+    {
+        reservedBytes += arena->reservedBytes();
+        usedBytes += arena->usedBytes();
+    }
+
+    QMutexLocker locker(&m_fragmentCacheMutex);
+
+    usage.add("Fragment cache", m_fragmentCache.totalCost() * (qint64)sizeof(QChar)
+        + m_fragmentCache.size() * (qint64)(sizeof(quint64) + sizeof(Cpp::Fragment) + 4 * sizeof(void*)));
+
+    MemoryUsage& arenas = usage.add("Arenas", Memory::listBytes(m_arenas) + m_arenas.size() * (qint64)sizeof(Arena));
+    arenas.add("Used", usedBytes);
+    arenas.add("Unused", reservedBytes - usedBytes);
+
+    return usage;
+}
+
+void CppCodeModel::parseDwarf(Dwarf* dwarf)
+{
+    TRACE_SCOPE("CppCodeModel::parseDwarf");
+
+    clear();
+
+    if (!dwarf)
+    {
+        return;
+    }
+
+    m_firstSourceStatementTableOwner = nullptr;
 
     if (dwarf->entryCount > 0)
     {
-        for (int i = 0; i < dwarf->entryCount; i++)
+        assignEntitySlots();
+
+        QList<QList<Diagnostic>> diagnostics(m_compileUnits.size());
+
+        // one arena per compile unit plus one for the serial merge below
+        for (int i = 0; i <= m_compileUnits.size(); i++)
         {
-            DwarfEntry* entry = &dwarf->entries[i];
+            m_arenas.append(new Arena());
+        }
+
+        // In lazy mode compile units are only parsed once something asks
+        // for one of their entities, see ensureParsed. Otherwise they only
+        // write into their own pre-assigned entity slots, so they can be
+        // parsed in parallel. Everything shared (diagnostics, the path map and
+        // member functions) is merged in order afterwards.
+        if (!m_settings.lazyParsing)
+        {
+            Util::parallelFor(m_compileUnits.size(), [&](int i)
+                {
+                    s_diagnosticBuffer = &diagnostics[i];
+                    s_arena = m_arenas[i];
+                    parseCompileUnit(m_compileUnits[i]);
+                    s_arena = nullptr;
+                    s_diagnosticBuffer = nullptr;
 
-            m_offsetToEntryMap[entry->offset] = entry;
+                    m_compileUnitsParsed[i].storeRelease(1);
+                });
         }
 
+        int compileUnitIndex = 0;
+
         for (DwarfEntry* entry = &dwarf->entries[0]; entry != nullptr; entry = entry->sibling)
         {
             switch (entry->tag)
             {
             case DW_TAG_compile_unit:
-                parseCompileUnit(entry);
+            {
+                Diagnostics::add(diagnostics[compileUnitIndex]);
+
+                compileUnitIndex++;
                 break;
+            }
             default:
                 warnUnknownEntry(entry, nullptr);
                 break;
             }
         }
 
-        for (Cpp::Function& f : m_offsetToFunctionMap)
+        for (DwarfEntry* entry : m_compileUnits)
+        {
+            m_pathToOffsetMultiMap.insert(QLatin1String(entry->getName()), entry->offset);
+        }
+
+        // Member functions are attached to their classes straight from the
+        // AT_member attributes so that classes have all of them even if the
+        // compile units of the functions haven't been parsed yet
+        Arena* arena = m_arenas.last();
+
+        for (int i = 0; i < dwarf->entryCount; i++)
         {
-            if (f.isMember)
+            if (m_entityKinds[i] != Cpp::EntityKind::Function)
             {
-                Q_ASSERT(m_offsetToClassTypeMap.contains(f.memberTypeOffset));
+                continue;
+            }
+
+            DwarfEntry* entry = &dwarf->entries[i];
+            DwarfAttribute* memberAttribute = entry->findAttribute(DW_AT_member);
+
+            if (!memberAttribute)
+            {
+                continue;
+            }
+
+            DwarfEntry* classEntry = findEntry(memberAttribute->ref);
+            int slot = entitySlot(classEntry, Cpp::EntityKind::ClassType);
+
+            Q_ASSERT(slot >= 0);
 
-                Cpp::ClassType& c = m_offsetToClassTypeMap[f.memberTypeOffset];
-                c.functionOffsets.append(f.entry->offset);
+            if (slot >= 0)
+            {
+                // copies of a merged class keep their own member functions,
+                // each compile unit only declares the ones it has
+                if (isMergedType(classEntry))
+                {
+                    m_mergedTypeFunctionOffsets[classEntry->offset].append(entry->offset);
+                }
+                else
+                {
+                    m_classTypes[slot].functionOffsets.append(*arena, entry->offset);
+                }
             }
         }
     }
@@ -384,12 +813,22 @@ void CppCodeModel::parseDwarf(Dwarf* dwarf)
 
 void CppCodeModel::parseCompileUnit(DwarfEntry* entry)
 {
-    Cpp::File& file = m_offsetToFileMap[entry->offset];
+    TRACE_SCOPE_DETAIL("CppCodeModel::parseCompileUnit", entry->getName());
+
+    Cpp::File& file = m_files[entitySlot(entry, Cpp::EntityKind::File)];
 
     file.entry = entry;
 
     for (DwarfEntry* child = entry->firstChild; child != nullptr; child = child->sibling)
     {
+        // identical copies of a type share the canonical entity, which is
+        // parsed along with its own compile unit
+        if (isMergedType(child))
+        {
+            file.typeOffsets.append(*s_arena, child->offset);
+            continue;
+        }
+
         switch (child->tag)
         {
         case DW_TAG_class_type:
@@ -434,7 +873,7 @@ void CppCodeModel::parseCompileUnit(DwarfEntry* entry)
         {
             // Name attribute
         case DW_AT_name:
-            file.path = attr->string;
+            file.path = QLatin1String(attr->string);
             break;
 
             // Statement list attribute
@@ -458,41 +897,27 @@ void CppCodeModel::parseCompileUnit(DwarfEntry* entry)
 
     if (statementListAttribute)
     {
-        // Hack to prevent unknown line number function warnings.
-        // Some compile units have an AT_stmt_list offset of 0 if they don't have any line numbers,
-        // despite 0 being a valid offset (it's the offset of the first table in the .line section).
-        // This causes a bunch of warnings because the Cpp::File will contain all of the line numbers
-        // from the first table when it really shouldn't contain any.
-        // To get around this, we only parse the table at offset 0 once, under the assumption
-        // that it corresponds to the correct compile unit (though this might not always be true...)
-        bool canParse = true;
-        
-        if (statementListAttribute->data4 == 0)
-        {
-            if (m_firstSourceStatementTableParsed)
-            {
-                canParse = false;
-            }
-            else
-            {
-                m_firstSourceStatementTableParsed = true;
-            }
-        }
+        // See assignEntitySlots
+        bool canParse = statementListAttribute->data4 != 0
+            || entry == m_firstSourceStatementTableOwner;
 
         if (canParse)
         {
-            Q_ASSERT(m_offsetToSourceStatementTableMap.contains(statementListAttribute->data4));
+            DwarfSourceStatementTable* table = dwarf()->findSourceStatementTable(statementListAttribute->data4);
+
+            Q_ASSERT(table);
 
-            parseSourceStatementTable(m_offsetToSourceStatementTableMap[statementListAttribute->data4], file);
+            if (table)
+            {
+                parseSourceStatementTable(table, file);
+            }
         }
     }
-
-    m_pathToOffsetMultiMap.insert(file.path, entry->offset);
 }
 
 void CppCodeModel::parseClassType(DwarfEntry* entry, Cpp::File& file)
 {
-    Cpp::ClassType& c = m_offsetToClassTypeMap[entry->offset];
+    Cpp::ClassType& c = m_classTypes[entitySlot(entry, Cpp::EntityKind::ClassType)];
 
     c.entry = entry;
 
@@ -509,7 +934,7 @@ void CppCodeModel::parseClassType(DwarfEntry* entry, Cpp::File& file)
         break;
     }
 
-    c.name = entry->getName();
+    c.name = QLatin1String(entry->getName());
     c.size = 0;
 
     if (DwarfAttribute* a = entry->findAttribute(DW_AT_byte_size))
@@ -536,7 +961,7 @@ void CppCodeModel::parseClassType(DwarfEntry* entry, Cpp::File& file)
         }
     }
 
-    file.typeOffsets.append(entry->offset);
+    file.typeOffsets.append(*s_arena, entry->offset);
 }
 
 void CppCodeModel::parseMember(DwarfEntry* entry, Cpp::ClassType& c)
@@ -565,7 +990,7 @@ void CppCodeModel::parseMember(DwarfEntry* entry, Cpp::ClassType& c)
         {
             // Name attribute
         case DW_AT_name:
-            m.name = attr->string;
+            m.name = QLatin1String(attr->string);
             break;
 
             // Access attribute
@@ -625,20 +1050,18 @@ void CppCodeModel::parseMember(DwarfEntry* entry, Cpp::ClassType& c)
 
     if (locationAttribute)
     {
-        DwarfLocation location;
-        location.read(dwarf(), locationAttribute);
-
-        for (const DwarfLocationAtom& atom : location.atoms)
+        if (const DwarfCompiledLocation* location = dwarf()->findLocation(locationAttribute))
         {
-            if (atom.op == DW_OP_CONST)
+            Elf32_Word offset;
+
+            if (location->findConstant(offset))
             {
-                m.offset = atom.number;
-                break;
+                m.offset = offset;
             }
         }
     }
 
-    c.members.append(m);
+    c.members.append(*s_arena, m);
 }
 
 void CppCodeModel::parseInheritance(DwarfEntry* entry, Cpp::ClassType& c)
@@ -701,19 +1124,19 @@ void CppCodeModel::parseInheritance(DwarfEntry* entry, Cpp::ClassType& c)
         parseType(dt, in.type);
     }
 
-    c.inheritances.append(in);
+    c.inheritances.append(*s_arena, in);
 }
 
 void CppCodeModel::parseTypedef(DwarfEntry* entry, Cpp::ClassType& c)
 {
     Cpp::Typedef t;
     parseTypedef(entry, t);
-    c.typedefs.append(t);
+    c.typedefs.append(*s_arena, t);
 }
 
 void CppCodeModel::parseEnumerationType(DwarfEntry* entry, Cpp::File& file)
 {
-    Cpp::EnumType& e = m_offsetToEnumTypeMap[entry->offset];
+    Cpp::EnumType& e = m_enumTypes[entitySlot(entry, Cpp::EntityKind::EnumType)];
 
     e.entry = entry;
 
@@ -727,7 +1150,7 @@ void CppCodeModel::parseEnumerationType(DwarfEntry* entry, Cpp::File& file)
         {
             // Name attribute
         case DW_AT_name:
-            e.name = attr->string;
+            e.name = QLatin1String(attr->string);
             break;
 
             // Element list attribute
@@ -748,25 +1171,27 @@ void CppCodeModel::parseEnumerationType(DwarfEntry* entry, Cpp::File& file)
 
     if (elementListAttribute)
     {
-        DwarfElementList list;
-        list.read(dwarf(), elementListAttribute);
-
-        for (DwarfElementListItem& item : list.items)
+        if (const DwarfElementList* list = dwarf()->findElementList(elementListAttribute))
         {
-            Cpp::EnumElement element;
-            element.name = item.name;
-            element.value = item.value;
+            for (int i = 0; i < list->itemCount; i++)
+            {
+                const DwarfElementListItem& item = list->items[i];
 
-            e.elements.append(element);
+                Cpp::EnumElement element;
+                element.name = QLatin1String(item.name, item.nameLength);
+                element.value = item.value;
+
+                e.elements.append(*s_arena, element);
+            }
         }
     }
 
-    file.typeOffsets.append(entry->offset);
+    file.typeOffsets.append(*s_arena, entry->offset);
 }
 
 void CppCodeModel::parseArrayType(DwarfEntry* entry, Cpp::File& file)
 {
-    Cpp::ArrayType& a = m_offsetToArrayTypeMap[entry->offset];
+    Cpp::ArrayType& a = m_arrayTypes[entitySlot(entry, Cpp::EntityKind::ArrayType)];
 
     a.entry = entry;
     a.type.isFundamental = true;
@@ -784,7 +1209,7 @@ void CppCodeModel::parseArrayType(DwarfEntry* entry, Cpp::File& file)
         {
             // Name attribute
         case DW_AT_name:
-            a.name = attr->string;
+            a.name = QLatin1String(attr->string);
             break;
 
             // Subscript data attribute
@@ -805,35 +1230,37 @@ void CppCodeModel::parseArrayType(DwarfEntry* entry, Cpp::File& file)
 
     if (subscrDataAttribute)
     {
-        DwarfSubscriptData data;
-        data.read(dwarf(), subscrDataAttribute);
-
-        parseType(data.elementType, a.type);
-
-        for (DwarfSubscriptDataItem& item : data.items)
+        if (const DwarfSubscriptData* data = dwarf()->findSubscriptData(subscrDataAttribute))
         {
-            int dimension = 1;
+            parseType(data->elementType, a.type);
 
-            if (item.lowBound.isConstant)
+            for (int i = 0; i < data->itemCount; i++)
             {
-                dimension -= item.lowBound.constant;
-            }
+                const DwarfSubscriptDataItem& item = data->items[i];
 
-            if (item.highBound.isConstant)
-            {
-                dimension += item.highBound.constant;
-            }
+                int dimension = 1;
 
-            a.dimensions.prepend(dimension);
-        }
+                if (item.lowBound.isConstant)
+                {
+                    dimension -= item.lowBound.constant;
+                }
+
+                if (item.highBound.isConstant)
+                {
+                    dimension += item.highBound.constant;
+                }
+
+                a.dimensions.prepend(*s_arena, dimension);
+            }
+        }
     }
 
-    file.typeOffsets.append(entry->offset);
+    file.typeOffsets.append(*s_arena, entry->offset);
 }
 
 void CppCodeModel::parseSubroutineType(DwarfEntry* entry, Cpp::File& file)
 {
-    Cpp::FunctionType& f = m_offsetToFunctionTypeMap[entry->offset];
+    Cpp::FunctionType& f = m_functionTypes[entitySlot(entry, Cpp::EntityKind::FunctionType)];
 
     f.entry = entry;
     f.type.isFundamental = true;
@@ -851,7 +1278,7 @@ void CppCodeModel::parseSubroutineType(DwarfEntry* entry, Cpp::File& file)
         {
             // Name attribute
         case DW_AT_name:
-            f.name = attr->string;
+            f.name = QLatin1String(attr->string);
             break;
 
             // Type attribute
@@ -890,12 +1317,12 @@ void CppCodeModel::parseSubroutineType(DwarfEntry* entry, Cpp::File& file)
         }
     }
 
-    file.typeOffsets.append(entry->offset);
+    file.typeOffsets.append(*s_arena, entry->offset);
 }
 
 void CppCodeModel::parseSubroutine(DwarfEntry* entry, Cpp::File& file)
 {
-    Cpp::Function& f = m_offsetToFunctionMap[entry->offset];
+    Cpp::Function& f = m_functions[entitySlot(entry, Cpp::EntityKind::Function)];
 
     f.entry = entry;
     f.type.isFundamental = true;
@@ -920,7 +1347,7 @@ void CppCodeModel::parseSubroutine(DwarfEntry* entry, Cpp::File& file)
         {
             // Name attribute
         case DW_AT_name:
-            f.name = attr->string;
+            f.name = QLatin1String(attr->string);
             break;
 
             // Type attribute
@@ -963,7 +1390,7 @@ void CppCodeModel::parseSubroutine(DwarfEntry* entry, Cpp::File& file)
 
             // Metrowerks mangled name attribute
         case DW_AT_MW_mangled:
-            f.mangledName = attr->string;
+            f.mangledName = QLatin1String(attr->string);
             break;
 
             // Ignored attributes
@@ -1006,7 +1433,7 @@ void CppCodeModel::parseSubroutine(DwarfEntry* entry, Cpp::File& file)
         }
     }
 
-    file.functionOffsets.append(entry->offset);
+    file.functionOffsets.append(*s_arena, entry->offset);
 }
 
 void CppCodeModel::parseFormalParameter(DwarfEntry* entry, Cpp::FunctionType& f)
@@ -1030,7 +1457,7 @@ void CppCodeModel::parseFormalParameter(DwarfEntry* entry, Cpp::FunctionType& f)
         {
             // Name attribute
         case DW_AT_name:
-            p.name = attr->string;
+            p.name = QLatin1String(attr->string);
             break;
 
             // Type attribute
@@ -1067,10 +1494,10 @@ void CppCodeModel::parseFormalParameter(DwarfEntry* entry, Cpp::FunctionType& f)
 
     if (locationAttribute)
     {
-        DwarfLocation location;
-        location.read(dwarf(), locationAttribute);
-
-        p.location = locationToString(location);
+        if (const DwarfCompiledLocation* location = dwarf()->findLocation(locationAttribute))
+        {
+            p.location = s_arena->copyLatin1(locationToString(*location));
+        }
 
         if (p.location.isEmpty())
         {
@@ -1078,7 +1505,7 @@ void CppCodeModel::parseFormalParameter(DwarfEntry* entry, Cpp::FunctionType& f)
         }
     }
 
-    f.parameters.append(p);
+    f.parameters.append(*s_arena, p);
 }
 
 void CppCodeModel::parseLocalVariable(DwarfEntry* entry, Cpp::Function& f)
@@ -1102,7 +1529,7 @@ void CppCodeModel::parseLocalVariable(DwarfEntry* entry, Cpp::Function& f)
         {
             // Name attribute
         case DW_AT_name:
-            v.name = attr->string;
+            v.name = QLatin1String(attr->string);
             break;
 
             // Type attribute
@@ -1120,7 +1547,7 @@ void CppCodeModel::parseLocalVariable(DwarfEntry* entry, Cpp::Function& f)
 
             // Metrowerks mangled name attribute
         case DW_AT_MW_mangled:
-            v.mangledName = attr->string;
+            v.mangledName = QLatin1String(attr->string);
             break;
 
             // Ignored attributes
@@ -1144,10 +1571,10 @@ void CppCodeModel::parseLocalVariable(DwarfEntry* entry, Cpp::Function& f)
 
     if (locationAttribute)
     {
-        DwarfLocation location;
-        location.read(dwarf(), locationAttribute);
-
-        v.location = locationToString(location);
+        if (const DwarfCompiledLocation* location = dwarf()->findLocation(locationAttribute))
+        {
+            v.location = s_arena->copyLatin1(locationToString(*location));
+        }
 
         if (v.location.isEmpty())
         {
@@ -1155,7 +1582,7 @@ void CppCodeModel::parseLocalVariable(DwarfEntry* entry, Cpp::Function& f)
         }
     }
 
-    f.variables.append(v);
+    f.variables.append(*s_arena, v);
 }
 
 void CppCodeModel::parseLexicalBlock(DwarfEntry* entry, Cpp::Function& f)
@@ -1176,7 +1603,7 @@ void CppCodeModel::parseLexicalBlock(DwarfEntry* entry, Cpp::Function& f)
 
 void CppCodeModel::parsePointerToMemberType(DwarfEntry* entry, Cpp::File& file)
 {
-    Cpp::PointerToMemberType& p = m_offsetToPointerToMemberTypeMap[entry->offset];
+    Cpp::PointerToMemberType& p = m_pointerToMemberTypes[entitySlot(entry, Cpp::EntityKind::PointerToMemberType)];
 
     p.entry = entry;
     p.type.isFundamental = true;
@@ -1198,7 +1625,7 @@ void CppCodeModel::parsePointerToMemberType(DwarfEntry* entry, Cpp::File& file)
         {
             // Name attribute
         case DW_AT_name:
-            p.name = attr->string;
+            p.name = QLatin1String(attr->string);
             break;
 
             // Type attribute
@@ -1229,12 +1656,12 @@ void CppCodeModel::parsePointerToMemberType(DwarfEntry* entry, Cpp::File& file)
         parseType(dt, p.type);
     }
 
-    file.typeOffsets.append(entry->offset);
+    file.typeOffsets.append(*s_arena, entry->offset);
 }
 
 void CppCodeModel::parseVariable(DwarfEntry* entry, Cpp::File& f)
 {
-    Cpp::Variable& v = m_offsetToVariableMap[entry->offset];
+    Cpp::Variable& v = m_variables[entitySlot(entry, Cpp::EntityKind::Variable)];
 
     v.entry = entry;
     v.type.isFundamental = true;
@@ -1255,7 +1682,7 @@ void CppCodeModel::parseVariable(DwarfEntry* entry, Cpp::File& f)
         {
             // Name attribute
         case DW_AT_name:
-            v.name = attr->string;
+            v.name = QLatin1String(attr->string);
             break;
 
             // Type attribute
@@ -1273,7 +1700,7 @@ void CppCodeModel::parseVariable(DwarfEntry* entry, Cpp::File& f)
 
             // Metrowerks mangled name attribute
         case DW_AT_MW_mangled:
-            v.mangledName = attr->string;
+            v.mangledName = QLatin1String(attr->string);
             break;
 
             // Unknown attribute
@@ -1293,21 +1720,13 @@ void CppCodeModel::parseVariable(DwarfEntry* entry, Cpp::File& f)
 
     if (locationAttribute)
     {
-        DwarfLocation location;
-        location.read(dwarf(), locationAttribute);
-
-        for (const DwarfLocationAtom& atom : location.atoms)
+        if (const DwarfCompiledLocation* location = dwarf()->findLocation(locationAttribute))
         {
-            switch (atom.op)
-            {
-            case DW_OP_ADDR:
-                v.address = atom.addr;
-                break;
-            }
+            location->findAddress(v.address);
         }
     }
 
-    f.variableOffsets.append(entry->offset);
+    f.variableOffsets.append(*s_arena, entry->offset);
 }
 
 void CppCodeModel::parseTypedef(DwarfEntry* entry, Cpp::Typedef& t)
@@ -1328,7 +1747,7 @@ void CppCodeModel::parseTypedef(DwarfEntry* entry, Cpp::Typedef& t)
         {
             // Name attribute
         case DW_AT_name:
-            t.name = attr->string;
+            t.name = QLatin1String(attr->string);
             break;
 
             // Type attribute
@@ -1355,7 +1774,7 @@ void CppCodeModel::parseTypedef(DwarfEntry* entry, Cpp::Typedef& t)
     }
 }
 
-void CppCodeModel::parseType(DwarfType& dt, Cpp::Type& t)
+void CppCodeModel::parseType(const DwarfType& dt, Cpp::Type& t)
 {
     t.isConst = false;
     t.isVolatile = false;
@@ -1370,13 +1789,13 @@ void CppCodeModel::parseType(DwarfType& dt, Cpp::Type& t)
         t.userTypeOffset = dt.udTypeOffset;
     }
 
-    if (!dt.modifiers.empty())
+    if (dt.modifierCount > 0)
     {
         Cpp::Modifier modifier;
         modifier.isConst = false;
         modifier.isVolatile = false;
 
-        for (int i = 0; i < dt.modifiers.size(); i++)
+        for (int i = 0; i < dt.modifierCount; i++)
         {
             char mod = dt.modifiers[i];
 
@@ -1384,7 +1803,7 @@ void CppCodeModel::parseType(DwarfType& dt, Cpp::Type& t)
             {
                 modifier.type = Cpp::ModifierType::Pointer;
 
-                t.modifiers.prepend(modifier);
+                t.modifiers.append(*s_arena, modifier);
 
                 // reset modifier
                 modifier.isConst = false;
@@ -1394,27 +1813,30 @@ void CppCodeModel::parseType(DwarfType& dt, Cpp::Type& t)
             {
                 modifier.type = Cpp::ModifierType::Reference;
 
-                t.modifiers.prepend(modifier);
+                t.modifiers.append(*s_arena, modifier);
 
                 // reset modifier
                 modifier.isConst = false;
                 modifier.isVolatile = false;
             }
-            else if (mod == DW_MOD_const && i < dt.modifiers.size() - 1)
+            else if (mod == DW_MOD_const && i < dt.modifierCount - 1)
             {
                 modifier.isConst = true;
             }
-            else if (mod == DW_MOD_volatile && i < dt.modifiers.size() - 1)
+            else if (mod == DW_MOD_volatile && i < dt.modifierCount - 1)
             {
                 modifier.isVolatile = true;
             }
         }
 
-        if (dt.modifiers.back() == DW_MOD_const)
+        // modifiers were collected in DWARF order, the writers expect them reversed
+        std::reverse(t.modifiers.begin(), t.modifiers.end());
+
+        if (dt.modifiers[dt.modifierCount - 1] == DW_MOD_const)
         {
             t.isConst = true;
         }
-        else if (dt.modifiers.back() == DW_MOD_volatile)
+        else if (dt.modifiers[dt.modifierCount - 1] == DW_MOD_volatile)
         {
             t.isVolatile = true;
         }
@@ -1423,6 +1845,29 @@ void CppCodeModel::parseType(DwarfType& dt, Cpp::Type& t)
 
 void CppCodeModel::parseSourceStatementTable(DwarfSourceStatementTable* table, Cpp::File& file)
 {
+    // Functions with code, sorted by start address so each line can binary
+    // search for the last function starting at or before its address.
+    // stable_sort keeps the file order for functions sharing a start address.
+    QList<Cpp::Function*> functions;
+    functions.reserve(file.functionOffsets.size());
+
+    for (Elf32_Off offset : file.functionOffsets)
+    {
+        // not findFunction, this runs while the compile unit is being parsed
+        Cpp::Function* f = &m_functions[entitySlot(findEntry(offset), Cpp::EntityKind::Function)];
+
+        if (f->startAddress < f->endAddress)
+        {
+            functions.append(f);
+        }
+    }
+
+    std::stable_sort(functions.begin(), functions.end(),
+        [](Cpp::Function* a, Cpp::Function* b)
+        {
+            return a->startAddress < b->startAddress;
+        });
+
     for (int i = 0; i < table->entryCount; i++)
     {
         DwarfSourceStatementEntry* entry = &table->entries[i];
@@ -1434,15 +1879,25 @@ void CppCodeModel::parseSourceStatementTable(DwarfSourceStatementTable* table, C
 
         Cpp::Function* f = nullptr;
 
-        for (Elf32_Off offset : file.functionOffsets)
+        auto it = std::upper_bound(functions.begin(), functions.end(), entry->address,
+            [](Elf32_Addr address, Cpp::Function* function)
+            {
+                return address < function->startAddress;
+            });
+
+        if (it != functions.begin())
         {
-            Cpp::Function& testFunction = m_offsetToFunctionMap[offset];
+            // first function in file order among those sharing this start address
+            Elf32_Addr startAddress = (*(it - 1))->startAddress;
 
-            if (entry->address >= testFunction.startAddress
-                && entry->address < testFunction.endAddress)
+            while (it != functions.begin() && (*(it - 1))->startAddress == startAddress)
             {
-                f = &testFunction;
-                break;
+                --it;
+            }
+
+            if (entry->address < (*it)->endAddress)
+            {
+                f = *it;
             }
         }
 
@@ -1458,8 +1913,19 @@ void CppCodeModel::parseSourceStatementTable(DwarfSourceStatementTable* table, C
         l.address = entry->address;
         l.isWholeLine = (entry->lineCharacter == DW_SOURCE_NO_POS);
 
-        f->lineNumbers.append(l);
+        f->lineNumbers.append(*s_arena, l);
+    }
+}
+
+void CppCodeModel::addDiagnostic(const Diagnostic& diagnostic)
+{
+    if (s_diagnosticBuffer)
+    {
+        s_diagnosticBuffer->append(diagnostic);
+        return;
     }
+
+    Diagnostics::add(diagnostic);
 }
 
 void CppCodeModel::warnUnknownEntry(DwarfEntry* child, DwarfEntry* parent)
@@ -1482,21 +1948,15 @@ void CppCodeModel::warnUnknownEntry(DwarfEntry* child, DwarfEntry* parent)
         return;
     }
 
-#ifdef MAX_WARNINGS_ACTIVE
-    if (s_warningCount >= MAX_WARNINGS)
-    {
-        return;
-    }
-
-    s_warningCount++;
-#endif
-
-    Output::write(tr("Warning: Unknown child entry %1 (%2) at offset %3 in parent entry %4 (%5)")
-        .arg(Dwarf::tagToString(child->tag))
-        .arg(child->getName())
-        .arg(Util::hexToString(child->offset))
-        .arg(parent ? Dwarf::tagToString(parent->tag) : tr("(root)"))
-        .arg(parent ? parent->getName() : QString()));
+    addDiagnostic({
+        DiagnosticKind::UnknownEntry,
+        child->tag,
+        parent ? parent->tag : (Elf32_Half)0,
+        child->offset,
+        parent ? parent->offset : 0,
+        QLatin1String(child->getName()),
+        parent ? QLatin1String(parent->getName()) : QLatin1String()
+        });
 }
 
 void CppCodeModel::warnUnknownAttribute(DwarfAttribute* attribute, DwarfEntry* entry)
@@ -1513,285 +1973,765 @@ void CppCodeModel::warnUnknownAttribute(DwarfAttribute* attribute, DwarfEntry* e
         return;
     }
 
-#ifdef MAX_WARNINGS_ACTIVE
-    if (s_warningCount >= MAX_WARNINGS)
+    addDiagnostic({
+        DiagnosticKind::UnknownAttribute,
+        attribute->name,
+        entry->tag,
+        attribute->offset,
+        entry->offset,
+        QLatin1String(),
+        QLatin1String(entry->getName())
+        });
+}
+
+void CppCodeModel::warnUnknownLineNumberFunction(DwarfSourceStatementEntry* entry, Cpp::File& file)
+{
+    if (!m_settings.warnUnknownLineNumberFunctions)
     {
         return;
     }
 
-    s_warningCount++;
-#endif
-
-    Output::write(tr("Warning: Unknown attribute %1 at offset %2 in entry %3 (%4)")
-        .arg(Dwarf::attrNameToString(attribute->name))
-        .arg(Util::hexToString(attribute->offset))
-        .arg(Dwarf::tagToString(entry->tag))
-        .arg(entry->getName()));
+    addDiagnostic({
+        DiagnosticKind::UnknownLineNumberFunction,
+        0,
+        file.entry->tag,
+        entry->address,
+        file.entry->offset,
+        file.path,
+        QLatin1String(file.entry->getName())
+        });
 }
 
-void CppCodeModel::warnUnknownLineNumberFunction(DwarfSourceStatementEntry* entry, Cpp::File& file)
+void CppCodeModel::warnUnknownLocationConfiguration(DwarfAttribute* attribute, DwarfEntry* entry)
 {
-    if (!m_settings.warnUnknownLineNumberFunctions)
+    if (!m_settings.warnUnknownLocationConfigurations)
     {
         return;
     }
 
-#ifdef MAX_WARNINGS_ACTIVE
-    if (s_warningCount >= MAX_WARNINGS)
+    addDiagnostic({
+        DiagnosticKind::UnknownLocationConfiguration,
+        0,
+        entry->tag,
+        attribute->offset,
+        entry->offset,
+        QLatin1String(),
+        QLatin1String(entry->getName())
+        });
+}
+
+void CppCodeModel::writeDwarfEntry(CodeSink& code, Elf32_Off offset)
+{
+    Cpp::WriteContext ctx = { code, 0, 0, false, nullptr };
+
+    writeDwarfEntry(ctx, offset);
+}
+
+void CppCodeModel::writeFile(CodeSink& code, const QString& path)
+{
+    Cpp::WriteContext ctx = { code, 0, 0, false, nullptr };
+
+    writeFile(ctx, path);
+}
+
+void CppCodeModel::writeDwarfEntry(Cpp::WriteContext& ctx, Elf32_Off offset)
+{
+    resetIndent(ctx);
+
+    DwarfEntry* entry = findEntry(offset);
+
+    Q_ASSERT(entry);
+
+    if (!entry)
     {
         return;
     }
 
-    s_warningCount++;
-#endif
+    int compileUnit = compileUnitIndex(entry);
+
+    ctx.compileUnit = compileUnit >= 0 ? m_compileUnits[compileUnit] : nullptr;
 
-    Output::write(tr("Warning: Line number address %1 is not in any function in file %2")
-        .arg(Util::hexToString(entry->address))
-        .arg(file.path));
+    // only entries directly inside compile units have an entity, e.g. local
+    // variables can be in both compile units and subroutines but only the
+    // ones in compile units are written for now
+    switch (entityKind(entry))
+    {
+    case Cpp::EntityKind::ClassType:
+        if (Cpp::ClassType* c = findClassType(offset))
+        {
+            writeFragment(ctx, Cpp::FragmentKind::ClassType, offset, [&](Cpp::WriteContext& fragment) { writeClassType(fragment, *c); });
+        }
+        break;
+    case Cpp::EntityKind::EnumType:
+        if (Cpp::EnumType* e = findEnumType(offset))
+        {
+            writeFragment(ctx, Cpp::FragmentKind::EnumType, offset, [&](Cpp::WriteContext& fragment) { writeEnumType(fragment, *e); });
+        }
+        break;
+    case Cpp::EntityKind::ArrayType:
+        if (Cpp::ArrayType* a = findArrayType(offset))
+        {
+            writeFragment(ctx, Cpp::FragmentKind::ArrayType, offset, [&](Cpp::WriteContext& fragment) { writeArrayType(fragment, *a); });
+        }
+        break;
+    case Cpp::EntityKind::FunctionType:
+        if (Cpp::FunctionType* f = findFunctionType(offset))
+        {
+            writeFragment(ctx, Cpp::FragmentKind::FunctionType, offset, [&](Cpp::WriteContext& fragment) { writeFunctionType(fragment, *f); });
+        }
+        break;
+    case Cpp::EntityKind::PointerToMemberType:
+        if (Cpp::PointerToMemberType* p = findPointerToMemberType(offset))
+        {
+            writeFragment(ctx, Cpp::FragmentKind::PointerToMemberType, offset, [&](Cpp::WriteContext& fragment) { writePointerToMemberType(fragment, *p); });
+        }
+        break;
+    case Cpp::EntityKind::Variable:
+        if (Cpp::Variable* v = findVariable(offset))
+        {
+            writeFragment(ctx, Cpp::FragmentKind::Variable, offset, [&](Cpp::WriteContext& fragment) { writeVariable(fragment, *v); });
+        }
+        break;
+    case Cpp::EntityKind::Function:
+        if (Cpp::Function* f = findFunction(offset))
+        {
+            writeFragment(ctx, Cpp::FragmentKind::FunctionDeclaration, offset, [&](Cpp::WriteContext& fragment) { writeFunctionDeclaration(fragment, *f); });
+            writeNewline(ctx);
+            writeNewline(ctx);
+            writeFragment(ctx, Cpp::FragmentKind::FunctionDefinition, offset, [&](Cpp::WriteContext& fragment) { writeFunctionDefinition(fragment, *f); });
+        }
+        break;
+    default:
+        if (entry->tag == DW_TAG_compile_unit)
+        {
+            writeFiles(ctx, { offset });
+        }
+        break;
+    }
 }
 
-void CppCodeModel::warnUnknownLocationConfiguration(DwarfAttribute* attribute, DwarfEntry* entry)
+void CppCodeModel::writeFile(Cpp::WriteContext& ctx, const QString& path)
 {
-    if (!m_settings.warnUnknownLocationConfigurations)
+    if (!m_pathToOffsetMultiMap.contains(path))
     {
         return;
     }
 
-#ifdef MAX_WARNINGS_ACTIVE
-    if (s_warningCount >= MAX_WARNINGS)
+    writeFiles(ctx, m_pathToOffsetMultiMap.values(path));
+}
+
+void CppCodeModel::clearFragmentCache()
+{
+    QMutexLocker locker(&m_fragmentCacheMutex);
+    m_fragmentCache.clear();
+
+    // generations are unique across models, so a thread's spellings can
+    // never be mistaken for those of another model either
+    m_typeSpellingGeneration.storeRelease(++s_typeSpellingGenerations);
+}
+
+quint64 CppCodeModel::fragmentSettings() const
+{
+    quint64 settings = 0;
+
+    if (m_settings.writeDwarfEntryOffsets) settings |= WriteDwarfEntryOffsetsSetting;
+    if (m_settings.writeClassSizes) settings |= WriteClassSizesSetting;
+    if (m_settings.writeClassMemberOffsets) settings |= WriteClassMemberOffsetsSetting;
+    if (m_settings.writeClassMemberBitOffsets) settings |= WriteClassMemberBitOffsetsSetting;
+    if (m_settings.writeClassMemberBitSizes) settings |= WriteClassMemberBitSizesSetting;
+    if (m_settings.writeVariableAddresses) settings |= WriteVariableAddressesSetting;
+    if (m_settings.writeVariableMangledNames) settings |= WriteVariableMangledNamesSetting;
+    if (m_settings.writeFunctionMangledNames) settings |= WriteFunctionMangledNamesSetting;
+    if (m_settings.writeFunctionAddresses) settings |= WriteFunctionAddressesSetting;
+    if (m_settings.writeFunctionSizes) settings |= WriteFunctionSizesSetting;
+    if (m_settings.writeFunctionVariableLocations) settings |= WriteFunctionVariableLocationsSetting;
+    if (m_settings.writeFunctionDisassembly) settings |= WriteFunctionDisassemblySetting;
+    if (m_settings.writeLineNumbers) settings |= WriteLineNumbersSetting;
+    if (m_settings.writeLineNumberAddresses) settings |= WriteLineNumberAddressesSetting;
+    if (m_settings.sortFunctionsByLineNumber) settings |= SortFunctionsByLineNumberSetting;
+    if (m_settings.treatClassesAsStructs) settings |= TreatClassesAsStructsSetting;
+    if (m_settings.hideThisParameter) settings |= HideThisParameterSetting;
+    if (m_settings.staticMemberFunctions) settings |= StaticMemberFunctionsSetting;
+    if (m_settings.anonymousStructsUnions) settings |= AnonymousStructsUnionsSetting;
+    if (m_settings.inlineMetrowerksAnonymousTypes) settings |= InlineMetrowerksAnonymousTypesSetting;
+    if (m_settings.hexadecimalEnumValues) settings |= HexadecimalEnumValuesSetting;
+    if (m_settings.forceExplicitEnumValues) settings |= ForceExplicitEnumValuesSetting;
+    if (DisassemblyCache::isReady()) settings |= DisassemblyReadySetting;
+
+    return settings;
+}
+
+void CppCodeModel::writeFragment(Cpp::WriteContext& ctx, Cpp::FragmentKind kind, Elf32_Off offset, const std::function<void(Cpp::WriteContext&)>& write)
+{
+    quint64 key = ((quint64)offset << 8) | (quint64)kind;
+    quint64 settings = fragmentSettings();
+
+    {
+        QMutexLocker locker(&m_fragmentCacheMutex);
+
+        if (Cpp::Fragment* fragment = m_fragmentCache.object(key))
+        {
+            if ((settings & fragment->usedSettings) == fragment->settings)
+            {
+                // implicitly shared, so the copies are cheap and stay valid
+                // even if the fragment is evicted right after
+                QString code = fragment->code;
+                QList<CodeToken> tokens = fragment->tokens;
+
+                locker.unlock();
+                ctx.code.writeTokens(code, tokens);
+                return;
+            }
+        }
+    }
+
+    // fragments are only written at the top level, so they don't depend on
+    // the indentation of whatever they end up in
+    Q_ASSERT(ctx.indentLevel == 0);
+
+    Cpp::Fragment* fragment = new Cpp::Fragment();
+
+    TokenCodeSink sink(fragment->code, fragment->tokens);
+    Cpp::WriteContext fragmentContext = { sink, 0, 0, false, ctx.compileUnit };
+
+    write(fragmentContext);
+
+    switch (kind)
+    {
+    case Cpp::FragmentKind::ClassType:
+        fragment->usedSettings = ClassTypeSettings;
+        break;
+    case Cpp::FragmentKind::EnumType:
+        fragment->usedSettings = EnumTypeSettings;
+        break;
+    case Cpp::FragmentKind::ArrayType:
+    case Cpp::FragmentKind::FunctionType:
+    case Cpp::FragmentKind::PointerToMemberType:
+        fragment->usedSettings = TypeSettings | WriteDwarfEntryOffsetsSetting;
+        break;
+    case Cpp::FragmentKind::Variable:
+        fragment->usedSettings = TypeSettings | WriteVariableAddressesSetting | WriteVariableMangledNamesSetting;
+        break;
+    case Cpp::FragmentKind::FunctionDeclaration:
+        fragment->usedSettings = TypeSettings;
+        break;
+    case Cpp::FragmentKind::FunctionDefinition:
+        fragment->usedSettings = TypeSettings | WriteDwarfEntryOffsetsSetting | WriteVariableMangledNamesSetting
+            | WriteFunctionMangledNamesSetting | WriteFunctionAddressesSetting | WriteFunctionSizesSetting
+            | WriteFunctionVariableLocationsSetting | WriteFunctionDisassemblySetting | WriteLineNumbersSetting
+            | WriteLineNumberAddressesSetting | DisassemblyReadySetting;
+        break;
+    }
+
+    if (fragmentContext.inlinedType)
+    {
+        fragment->usedSettings |= InlineTypeSettings;
+    }
+
+    fragment->settings = settings & fragment->usedSettings;
+
+    ctx.code.writeTokens(fragment->code, fragment->tokens);
+
+    QMutexLocker locker(&m_fragmentCacheMutex);
+    m_fragmentCache.insert(key, fragment, fragment->code.size() + fragment->tokens.size() * (int)(sizeof(CodeToken) / sizeof(QChar)) + 1);
+}
+
+void CppCodeModel::writeFiles(Cpp::WriteContext& ctx, const QList<Elf32_Off>& fileOffsets)
+{
+    if (fileOffsets.isEmpty())
     {
         return;
     }
 
-    s_warningCount++;
-#endif
+    TRACE_SCOPE_DETAIL("CppCodeModel::writeFiles", findEntry(fileOffsets.first())->getName());
 
-    Output::write(tr("Warning: Unknown location configuration at offset %1 in entry %2 (%3)")
-        .arg(Util::hexToString(attribute->offset))
-        .arg(Dwarf::tagToString(entry->tag))
-        .arg(entry->getName()));
+    QList<Cpp::File*> files;
+
+    for (Elf32_Off fileOffset : fileOffsets)
+    {
+        Cpp::File* file = findFile(fileOffset);
+
+        Q_ASSERT(file);
+
+        if (file)
+        {
+            files.append(file);
+        }
+    }
+
+    if (m_settings.writeDwarfEntryOffsets)
+    {
+        for (Cpp::File* file : files)
+        {
+            writeComment(ctx, QString("DWARF: %1").arg(Util::hexToString(file->entry->offset)));
+            writeNewline(ctx);
+            writeNewline(ctx);
+        }
+    }
+
+    for (Cpp::File* file : files)
+    {
+        QList<DwarfEntry*> entries;
+
+        ctx.compileUnit = file->entry;
+
+        for (Elf32_Off typeOffset : file->typeOffsets)
+        {
+            DwarfEntry* entry = findEntry(typeOffset);
+
+            if (!typeCanBeInlined(entry->getName()))
+            {
+                entries.append(entry);
+            }
+        }
+
+        if (m_settings.sortTypesAlphabetically)
+        {
+            QStringList names;
+            QList<DwarfEntry*> sortedEntries;
+
+            names.reserve(entries.size());
+            sortedEntries.reserve(entries.size());
+
+            for (DwarfEntry* entry : entries)
+            {
+                names.append(entry->getName());
+            }
+
+            for (int i : SortKeys::sortedRows(SortKeys::collationKeys(names)))
+            {
+                sortedEntries.append(entries[i]);
+            }
+
+            entries = sortedEntries;
+        }
+
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+            [&](DwarfEntry* entry)
+            {
+                switch (entry->tag)
+                {
+                case DW_TAG_class_type:
+                case DW_TAG_structure_type:
+                case DW_TAG_union_type:
+                    return !m_settings.writeClassTypes;
+                case DW_TAG_enumeration_type:
+                    return !m_settings.writeEnumTypes;
+                case DW_TAG_array_type:
+                    return !m_settings.writeArrayTypes;
+                case DW_TAG_subroutine_type:
+                    return !m_settings.writeFunctionTypes;
+                case DW_TAG_ptr_to_member_type:
+                    return !m_settings.writePointerToMemberTypes;
+                }
+
+                return false;
+            }), entries.end());
+
+        if (m_settings.orderTypesByDependency)
+        {
+            QList<Cpp::ClassType*> forwardDeclarations;
+
+            entries = orderTypesByDependency(entries, forwardDeclarations);
+
+            for (Cpp::ClassType* c : forwardDeclarations)
+            {
+                writeForwardDeclaration(ctx, *c);
+                writeNewline(ctx);
+            }
+
+            if (!forwardDeclarations.isEmpty())
+            {
+                writeNewline(ctx);
+            }
+        }
+
+        for (DwarfEntry* entry : entries)
+        {
+            writeDwarfEntry(ctx, entry->offset);
+            writeNewline(ctx);
+            writeNewline(ctx);
+        }
+    }
+
+    if (m_settings.writeVariables)
+    {
+        for (Cpp::File* file : files)
+        {
+            for (Elf32_Off variableOffset : file->variableOffsets)
+            {
+                Cpp::Variable* v = findVariable(variableOffset);
+
+                writeFragment(ctx, Cpp::FragmentKind::Variable, variableOffset, [&](Cpp::WriteContext& fragment) { writeVariable(fragment, *v); });
+                writeNewline(ctx);
+            }
+        }
+
+        writeNewline(ctx);
+    }
+
+    if (m_settings.writeFunctionDeclarations
+        || m_settings.writeFunctionDefinitions)
+    {
+        QList<Cpp::Function*> functions;
+
+        for (Cpp::File* file : files)
+        {
+            for (Elf32_Off functionOffset : file->functionOffsets)
+            {
+                functions.append(findFunction(functionOffset));
+            }
+        }
+
+        if (m_settings.sortFunctionsByLineNumber)
+        {
+            sortFunctionsByLineNumber(functions);
+        }
+
+        if (m_settings.writeFunctionDeclarations)
+        {
+            for (Cpp::Function* f : functions)
+            {
+                writeFragment(ctx, Cpp::FragmentKind::FunctionDeclaration, f->entry->offset, [&](Cpp::WriteContext& fragment) { writeFunctionDeclaration(fragment, *f); });
+                writeNewline(ctx);
+            }
+
+            writeNewline(ctx);
+        }
+
+        if (m_settings.writeFunctionDefinitions)
+        {
+            for (Cpp::Function* f : functions)
+            {
+                writeFragment(ctx, Cpp::FragmentKind::FunctionDefinition, f->entry->offset, [&](Cpp::WriteContext& fragment) { writeFunctionDefinition(fragment, *f); });
+                writeNewline(ctx);
+                writeNewline(ctx);
+            }
+        }
+    }
 }
 
-void CppCodeModel::writeDwarfEntry(QString& code, Elf32_Off offset)
+void CppCodeModel::collectTypeDependencies(Cpp::Type& t, bool isIndirect, QList<Cpp::TypeDependency>& dependencies, int depth)
 {
-    resetIndent();
+    if (t.isFundamental)
+    {
+        return;
+    }
 
-    Q_ASSERT(m_offsetToEntryMap.contains(offset));
+    DwarfEntry* entry = findEntry(t.userTypeOffset);
+
+    if (!entry)
+    {
+        return;
+    }
 
-    DwarfEntry* entry = m_offsetToEntryMap[offset];
+    isIndirect = isIndirect || !t.modifiers.isEmpty();
 
-    switch (entry->tag)
+    if (!typeCanBeInlined(entry->getName()))
     {
-    case DW_TAG_compile_unit:
-        writeFiles(code, { offset });
+        // only classes can be forward declared, everything else has to be
+        // written out before it's used no matter how it's used
+        bool isClass = (entityKind(entry) == Cpp::EntityKind::ClassType);
+
+        dependencies.append({ entry->offset, !(isIndirect && isClass) });
+        return;
+    }
+
+    // inlined types are written as part of whatever uses them, so their
+    // dependencies become dependencies of the user
+    if (depth >= MAX_TYPE_DEPENDENCY_DEPTH)
+    {
+        return;
+    }
+
+    switch (entityKind(entry))
+    {
+    case Cpp::EntityKind::ClassType:
+        if (Cpp::ClassType* c = findClassType(entry->offset))
+        {
+            collectClassDependencies(*c, dependencies, depth + 1);
+        }
         break;
-    case DW_TAG_class_type:
-    case DW_TAG_structure_type:
-    case DW_TAG_union_type:
-        writeClassType(code, m_offsetToClassTypeMap[offset]);
+    case Cpp::EntityKind::ArrayType:
+        if (Cpp::ArrayType* a = findArrayType(entry->offset))
+        {
+            collectTypeDependencies(a->type, isIndirect, dependencies, depth + 1);
+        }
         break;
-    case DW_TAG_enumeration_type:
-        writeEnumType(code, m_offsetToEnumTypeMap[offset]);
+    case Cpp::EntityKind::FunctionType:
+    case Cpp::EntityKind::PointerToMemberType:
+        collectEntryDependencies(entry, dependencies, depth + 1);
         break;
-    case DW_TAG_array_type:
-        writeArrayType(code, m_offsetToArrayTypeMap[offset]);
+    default:
         break;
-    case DW_TAG_subroutine_type:
-        writeFunctionType(code, m_offsetToFunctionTypeMap[offset]);
+    }
+}
+
+void CppCodeModel::collectClassDependencies(Cpp::ClassType& c, QList<Cpp::TypeDependency>& dependencies, int depth)
+{
+    for (Cpp::ClassInheritance& in : c.inheritances)
+    {
+        collectTypeDependencies(in.type, false, dependencies, depth);
+    }
+
+    for (Cpp::ClassMember& m : c.members)
+    {
+        collectTypeDependencies(m.type, false, dependencies, depth);
+    }
+
+    for (Cpp::Typedef& t : c.typedefs)
+    {
+        collectTypeDependencies(t.type, false, dependencies, depth);
+    }
+
+    // member functions are only declared inside the class, which doesn't
+    // need complete parameter or return types
+    for (Elf32_Off functionOffset : c.functionOffsets)
+    {
+        if (Cpp::Function* f = findFunction(functionOffset))
+        {
+            collectTypeDependencies(f->type, true, dependencies, depth);
+
+            for (Cpp::FunctionParameter& p : f->parameters)
+            {
+                collectTypeDependencies(p.type, true, dependencies, depth);
+            }
+        }
+    }
+}
+
+void CppCodeModel::collectEntryDependencies(DwarfEntry* entry, QList<Cpp::TypeDependency>& dependencies, int depth)
+{
+    switch (entityKind(entry))
+    {
+    case Cpp::EntityKind::ClassType:
+        if (Cpp::ClassType* c = findClassType(entry->offset))
+        {
+            collectClassDependencies(*c, dependencies, depth);
+        }
         break;
-    case DW_TAG_ptr_to_member_type:
-        writePointerToMemberType(code, m_offsetToPointerToMemberTypeMap[offset]);
+    case Cpp::EntityKind::ArrayType:
+        if (Cpp::ArrayType* a = findArrayType(entry->offset))
+        {
+            collectTypeDependencies(a->type, false, dependencies, depth);
+        }
         break;
-    case DW_TAG_global_variable:
-        writeVariable(code, m_offsetToVariableMap[offset]);
+    case Cpp::EntityKind::FunctionType:
+        if (Cpp::FunctionType* f = findFunctionType(entry->offset))
+        {
+            collectTypeDependencies(f->type, true, dependencies, depth);
+
+            for (Cpp::FunctionParameter& p : f->parameters)
+            {
+                collectTypeDependencies(p.type, true, dependencies, depth);
+            }
+        }
         break;
-    case DW_TAG_local_variable:
-        // local variables can be in both compile units and subroutines
-        // only write local variables in compile units for now
-        if (m_offsetToVariableMap.contains(offset))
+    case Cpp::EntityKind::PointerToMemberType:
+        if (Cpp::PointerToMemberType* p = findPointerToMemberType(entry->offset))
         {
-            writeVariable(code, m_offsetToVariableMap[offset]);
+            collectTypeDependencies(p->type, true, dependencies, depth);
+            collectTypeDependencies(p->containingType, true, dependencies, depth);
         }
         break;
-    case DW_TAG_subroutine:
-    case DW_TAG_global_subroutine:
-    case DW_TAG_inlined_subroutine:
-        writeFunctionDeclaration(code, m_offsetToFunctionMap[offset]);
-        writeNewline(code);
-        writeNewline(code);
-        writeFunctionDefinition(code, m_offsetToFunctionMap[offset]);
+    default:
         break;
     }
 }
 
-void CppCodeModel::writeFile(QString& code, const QString& path)
+QList<DwarfEntry*> CppCodeModel::orderTypesByDependency(const QList<DwarfEntry*>& entries, QList<Cpp::ClassType*>& outForwardDeclarations)
 {
-    if (!m_pathToOffsetMultiMap.contains(path))
-    {
-        return;
-    }
+    TRACE_SCOPE("CppCodeModel::orderTypesByDependency");
 
-    writeFiles(code, m_pathToOffsetMultiMap.values(path));
-}
+    int count = entries.size();
+    QHash<Elf32_Off, int> offsetToNode;
+    int compileUnit = count > 0 ? compileUnitIndex(entries.first()) : -1;
 
-void CppCodeModel::writeFiles(QString& code, const QList<Elf32_Off>& fileOffsets)
-{
-    if (fileOffsets.isEmpty())
-    {
-        return;
-    }
+    offsetToNode.reserve(count);
 
-#ifdef QT_DEBUG
-    for (Elf32_Off fileOffset : fileOffsets)
+    for (int i = 0; i < count; i++)
     {
-        Q_ASSERT(m_offsetToFileMap.contains(fileOffset));
+        offsetToNode.insert(entries[i]->offset, i);
     }
-#endif
-
-    if (m_settings.writeDwarfEntryOffsets)
-    {
-        for (Elf32_Off fileOffset : fileOffsets)
-        {
-            Cpp::File& file = m_offsetToFileMap[fileOffset];
 
-            writeComment(code, QString("DWARF: %1").arg(Util::hexToString(file.entry->offset)));
-            writeNewline(code);
-            writeNewline(code);
-        }
-    }
+    // edges of node i are edges[edgeStarts[i]..edgeStarts[i + 1]), only
+    // edges between types written here are kept
+    QList<int> edgeStarts(count + 1);
+    QList<int> edges;
+    QList<bool> edgeIsHard;
+    QList<Cpp::TypeDependency> dependencies;
 
-    for (Elf32_Off fileOffset : fileOffsets)
+    for (int i = 0; i < count; i++)
     {
-        Cpp::File& file = m_offsetToFileMap[fileOffset];
-        QList<DwarfEntry*> entries;
+        edgeStarts[i] = edges.size();
+
+        dependencies.clear();
+        collectEntryDependencies(entries[i], dependencies);
 
-        for (Elf32_Off typeOffset : file.typeOffsets)
+        for (const Cpp::TypeDependency& d : dependencies)
         {
-            DwarfEntry* entry = m_offsetToEntryMap[typeOffset];
+            // dependencies of merged types are in the canonical copy's
+            // compile unit
+            auto it = offsetToNode.constFind(localTypeOffset(compileUnit >= 0 ? m_compileUnits[compileUnit] : nullptr, d.offset));
 
-            if (!typeCanBeInlined(entry->getName()))
+            if (it != offsetToNode.constEnd() && *it != i)
             {
-                entries.append(entry);
+                edges.append(*it);
+                edgeIsHard.append(d.isHard);
             }
         }
+    }
 
-        if (m_settings.sortTypesAlphabetically)
+    edgeStarts[count] = edges.size();
+
+    // Tarjan's algorithm over the hard edges, iterative so that long chains
+    // can't overflow the stack. Components come out with everything they
+    // depend on already emitted, and roots are visited in the incoming
+    // order so unrelated types keep it.
+    QList<int> index(count, -1);
+    QList<int> lowLink(count, 0);
+    QList<bool> onStack(count, false);
+    QList<int> stack;
+    QList<QPair<int, int>> callStack;
+    QList<int> order;
+    int nextIndex = 0;
+
+    order.reserve(count);
+
+    for (int root = 0; root < count; root++)
+    {
+        if (index[root] != -1)
         {
-            std::sort(entries.begin(), entries.end(),
-                [](DwarfEntry* a, DwarfEntry* b)
-                {
-                    return stricmp(a->getName(), b->getName()) < 0;
-                });
+            continue;
         }
 
-        for (DwarfEntry* entry : entries)
+        callStack.append(qMakePair(root, edgeStarts[root]));
+        index[root] = lowLink[root] = nextIndex++;
+        stack.append(root);
+        onStack[root] = true;
+
+        while (!callStack.isEmpty())
         {
-            switch (entry->tag)
+            int node = callStack.last().first;
+            int& edge = callStack.last().second;
+
+            if (edge < edgeStarts[node + 1])
             {
-            case DW_TAG_class_type:
-            case DW_TAG_structure_type:
-            case DW_TAG_union_type:
-                if (!m_settings.writeClassTypes)
-                {
-                    continue;
-                }
-                break;
-            case DW_TAG_enumeration_type:
-                if (!m_settings.writeEnumTypes)
-                {
-                    continue;
-                }
-                break;
-            case DW_TAG_array_type:
-                if (!m_settings.writeArrayTypes)
+                int target = edges[edge];
+                bool isHard = edgeIsHard[edge];
+
+                edge++;
+
+                if (!isHard)
                 {
                     continue;
                 }
-                break;
-            case DW_TAG_subroutine_type:
-                if (!m_settings.writeFunctionTypes)
+
+                if (index[target] == -1)
                 {
-                    continue;
+                    index[target] = lowLink[target] = nextIndex++;
+                    stack.append(target);
+                    onStack[target] = true;
+                    callStack.append(qMakePair(target, edgeStarts[target]));
                 }
-                break;
-            case DW_TAG_ptr_to_member_type:
-                if (!m_settings.writePointerToMemberTypes)
+                else if (onStack[target])
                 {
-                    continue;
+                    lowLink[node] = qMin(lowLink[node], index[target]);
                 }
-                break;
+
+                continue;
             }
 
-            writeDwarfEntry(code, entry->offset);
-            writeNewline(code);
-            writeNewline(code);
-        }
-    }
+            callStack.removeLast();
 
-    if (m_settings.writeVariables)
-    {
-        for (Elf32_Off fileOffset : fileOffsets)
-        {
-            Cpp::File& file = m_offsetToFileMap[fileOffset];
+            if (!callStack.isEmpty())
+            {
+                int parent = callStack.last().first;
+                lowLink[parent] = qMin(lowLink[parent], lowLink[node]);
+            }
 
-            for (Elf32_Off variableOffset : file.variableOffsets)
+            if (lowLink[node] == index[node])
             {
-                Cpp::Variable& v = m_offsetToVariableMap[variableOffset];
+                // the stack holds a cycle's members in discovery order, they're
+                // written in the incoming order instead (node numbers are
+                // incoming indices)
+                int start = stack.lastIndexOf(node);
+
+                std::sort(stack.begin() + start, stack.end());
+
+                for (int i = start; i < stack.size(); i++)
+                {
+                    onStack[stack[i]] = false;
+                    order.append(stack[i]);
+                }
 
-                writeVariable(code, v);
-                writeNewline(code);
+                stack.resize(start);
             }
         }
-
-        writeNewline(code);
     }
 
-    if (m_settings.writeFunctionDeclarations
-        || m_settings.writeFunctionDefinitions)
+    QList<int> position(count);
+
+    for (int i = 0; i < count; i++)
     {
-        QList<Cpp::Function*> functions;
+        position[order[i]] = i;
+    }
+
+    // anything used before it's written needs a forward declaration, which
+    // is all soft uses and any hard ones left inside a cycle
+    QList<bool> isForwardDeclared(count, false);
 
-        for (Elf32_Off fileOffset : fileOffsets)
+    for (int node = 0; node < count; node++)
+    {
+        for (int edge = edgeStarts[node]; edge < edgeStarts[node + 1]; edge++)
         {
-            Cpp::File& file = m_offsetToFileMap[fileOffset];
+            int target = edges[edge];
 
-            for (Elf32_Off functionOffset : file.functionOffsets)
+            if (position[target] > position[node] && entityKind(entries[target]) == Cpp::EntityKind::ClassType)
             {
-                functions.append(&m_offsetToFunctionMap[functionOffset]);
+                isForwardDeclared[target] = true;
             }
         }
+    }
 
-        if (m_settings.sortFunctionsByLineNumber)
-        {
-            sortFunctionsByLineNumber(functions);
-        }
+    QList<DwarfEntry*> orderedEntries;
 
-        if (m_settings.writeFunctionDeclarations)
-        {
-            for (Cpp::Function* f : functions)
-            {
-                writeFunctionDeclaration(code, *f);
-                writeNewline(code);
-            }
+    orderedEntries.reserve(count);
 
-            writeNewline(code);
-        }
+    for (int node : order)
+    {
+        orderedEntries.append(entries[node]);
 
-        if (m_settings.writeFunctionDefinitions)
+        if (isForwardDeclared[node])
         {
-            for (Cpp::Function* f : functions)
+            if (Cpp::ClassType* c = findClassType(entries[node]->offset))
             {
-                writeFunctionDefinition(code, *f);
-                writeNewline(code);
-                writeNewline(code);
+                outForwardDeclarations.append(c);
             }
         }
     }
+
+    return orderedEntries;
+}
+
+void CppCodeModel::writeForwardDeclaration(Cpp::WriteContext& ctx, Cpp::ClassType& c)
+{
+    Cpp::Keyword classKeyword = c.keyword;
+
+    if (classKeyword == Cpp::Keyword::Class && m_settings.treatClassesAsStructs)
+    {
+        classKeyword = Cpp::Keyword::Struct;
+    }
+
+    writeKeyword(ctx, classKeyword);
+    ctx.code += " ";
+    ctx.code.writeToken(CodeTokenKind::TypeReference, c.name, localTypeOffset(ctx.compileUnit, c.entry->offset));
+    ctx.code += ";";
 }
 
-void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInline)
+void CppCodeModel::writeClassType(Cpp::WriteContext& ctx, Cpp::ClassType& c, bool isInline)
 {
-    m_minIndentLevel = m_indentLevel;
+    ctx.minIndentLevel = ctx.indentLevel;
 
     QStringList comment;
 
@@ -1802,13 +2742,13 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
 
     if (m_settings.writeDwarfEntryOffsets)
     {
-        comment += QString("DWARF: %1").arg(Util::hexToString(c.entry->offset));
+        comment += QString("DWARF: %1").arg(Util::hexToString(localTypeOffset(ctx.compileUnit, c.entry->offset)));
     }
 
     if (!comment.isEmpty())
     {
-        writeComment(code, comment.join(", "));
-        writeNewline(code);
+        writeComment(ctx, comment.join(", "));
+        writeNewline(ctx);
     }
 
     Cpp::Keyword classKeyword = c.keyword;
@@ -1818,16 +2758,17 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
         classKeyword = Cpp::Keyword::Struct;
     }
 
-    writeKeyword(code, classKeyword);
+    writeKeyword(ctx, classKeyword);
 
     if (!isInline && !c.name.isEmpty())
     {
-        code += QString(" %1").arg(c.name);
+        ctx.code += " ";
+        ctx.code.writeToken(CodeTokenKind::Identifier, c.name);
     }
 
     if (!c.inheritances.isEmpty())
     {
-        code += " : ";
+        ctx.code += " : ";
 
         for (int i = 0; i < c.inheritances.size(); i++)
         {
@@ -1849,38 +2790,38 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
 
             if (explicitAccess)
             {
-                writeKeyword(code, in.access);
-                code += " ";
+                writeKeyword(ctx, in.access);
+                ctx.code += " ";
             }
 
-            writeTypePrefix(code, in.type);
-            writeTypePostfix(code, in.type);
+            writeTypePrefix(ctx, in.type);
+            writeTypePostfix(ctx, in.type);
 
             if (i < c.inheritances.size() - 1)
             {
-                code += ", ";
+                ctx.code += ", ";
             }
         }
     }
 
-    writeNewline(code);
-    code += "{";
+    writeNewline(ctx);
+    ctx.code += "{";
 
     bool empty = true;
 
     if (!c.typedefs.empty())
     {
-        increaseIndent();
+        increaseIndent(ctx);
 
         for (Cpp::Typedef& t : c.typedefs)
         {
-            writeNewline(code);
-            writeTypedef(code, t);
+            writeNewline(ctx);
+            writeTypedef(ctx, t);
         }
 
-        decreaseIndent();
+        decreaseIndent(ctx);
 
-        writeNewline(code);
+        writeNewline(ctx);
         empty = false;
     }
 
@@ -1917,7 +2858,7 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
         }
         }
 
-        increaseIndent();
+        increaseIndent(ctx);
 
         bool first = true;
         QList<QPair<int, int>> anonUnionStack;
@@ -1929,18 +2870,18 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
 
             if (m.access != prevAccess)
             {
-                writeNewline(code, false);
+                writeNewline(ctx, false);
 
                 if (!first)
                 {
-                    writeNewline(code, false);
+                    writeNewline(ctx, false);
                 }
 
-                writeKeyword(code, m.access);
-                code += ":";
+                writeKeyword(ctx, m.access);
+                ctx.code += ":";
             }
 
-            writeNewline(code);
+            writeNewline(ctx);
 
             if (m_settings.anonymousStructsUnions)
             {
@@ -1965,11 +2906,11 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
                     if (foundIndex != -1)
                     {
                         anonUnionStack.push_back({ i, foundIndex });
-                        writeKeyword(code, Cpp::Keyword::Union);
-                        writeNewline(code);
-                        code += "{";
-                        increaseIndent();
-                        writeNewline(code);
+                        writeKeyword(ctx, Cpp::Keyword::Union);
+                        writeNewline(ctx);
+                        ctx.code += "{";
+                        increaseIndent(ctx);
+                        writeNewline(ctx);
                     }
                 }
 
@@ -1995,33 +2936,33 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
                     if (foundIndex != -1)
                     {
                         anonStructStack.push_back({ i, foundIndex });
-                        writeKeyword(code, Cpp::Keyword::Struct);
-                        writeNewline(code);
-                        code += "{";
-                        increaseIndent();
-                        writeNewline(code);
+                        writeKeyword(ctx, Cpp::Keyword::Struct);
+                        writeNewline(ctx);
+                        ctx.code += "{";
+                        increaseIndent(ctx);
+                        writeNewline(ctx);
                     }
                 }
             }
 
-            writeClassMember(code, m);
+            writeClassMember(ctx, m);
 
             if (m_settings.anonymousStructsUnions)
             {
                 if (!anonStructStack.empty() && i == anonStructStack.back().second)
                 {
                     anonStructStack.pop_back();
-                    decreaseIndent();
-                    writeNewline(code);
-                    code += "};";
+                    decreaseIndent(ctx);
+                    writeNewline(ctx);
+                    ctx.code += "};";
                 }
 
                 if (!anonUnionStack.empty() && i == anonUnionStack.back().second)
                 {
                     anonUnionStack.pop_back();
-                    decreaseIndent();
-                    writeNewline(code);
-                    code += "};";
+                    decreaseIndent(ctx);
+                    writeNewline(ctx);
+                    ctx.code += "};";
                 }
             }
 
@@ -2029,19 +2970,34 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
             first = false;
         }
 
-        decreaseIndent();
+        decreaseIndent(ctx);
 
-        writeNewline(code);
+        writeNewline(ctx);
         empty = false;
     }
 
-    if (!c.functionOffsets.empty())
+    Elf32_Off entryOffset = localTypeOffset(ctx.compileUnit, c.entry->offset);
+    QList<Elf32_Off> functionOffsets;
+
+    if (entryOffset == c.entry->offset)
+    {
+        for (Elf32_Off offset : c.functionOffsets)
+        {
+            functionOffsets.append(offset);
+        }
+    }
+    else
+    {
+        functionOffsets = m_mergedTypeFunctionOffsets.value(entryOffset);
+    }
+
+    if (!functionOffsets.isEmpty())
     {
         QList<Cpp::Function*> functions;
 
-        for (Elf32_Off offset : c.functionOffsets)
+        for (Elf32_Off offset : functionOffsets)
         {
-            functions.append(&m_offsetToFunctionMap[offset]);
+            functions.append(findFunction(offset));
         }
 
         if (m_settings.sortFunctionsByLineNumber)
@@ -2081,7 +3037,7 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
             }
         }
 
-        increaseIndent();
+        increaseIndent(ctx);
 
         bool first = true;
 
@@ -2089,55 +3045,56 @@ void CppCodeModel::writeClassType(QString& code, Cpp::ClassType& c, bool isInlin
         {
             if (f->memberAccess != prevAccess)
             {
-                writeNewline(code, false);
+                writeNewline(ctx, false);
 
                 if (!first)
                 {
-                    writeNewline(code, false);
+                    writeNewline(ctx, false);
                 }
 
-                writeKeyword(code, f->memberAccess);
-                code += ":";
+                writeKeyword(ctx, f->memberAccess);
+                ctx.code += ":";
             }
 
-            writeNewline(code);
-            writeFunctionDeclaration(code, *f, true);
+            writeNewline(ctx);
+            writeFunctionDeclaration(ctx, *f, true);
 
             prevAccess = f->memberAccess;
             first = false;
         }
 
-        decreaseIndent();
+        decreaseIndent(ctx);
 
-        writeNewline(code);
+        writeNewline(ctx);
         empty = false;
     }
 
     if (empty)
     {
-        writeNewline(code);
+        writeNewline(ctx);
     }
 
-    code += "}";
+    ctx.code += "}";
 
     if (!isInline)
     {
-        code += ";";
+        ctx.code += ";";
     }
 
-    m_minIndentLevel = 0;
+    ctx.minIndentLevel = 0;
 }
 
-void CppCodeModel::writeClassMember(QString& code, Cpp::ClassMember& m)
+void CppCodeModel::writeClassMember(Cpp::WriteContext& ctx, Cpp::ClassMember& m)
 {
-    writeDeclaration(code, m);
+    writeDeclaration(ctx, m);
 
     if (m.isBitfield)
     {
-        code += QString(" : %1").arg(m.bitSize);
+        ctx.code += " : ";
+        ctx.code.writeToken(CodeTokenKind::Number, QString::number(m.bitSize));
     }
 
-    code += ";";
+    ctx.code += ";";
 
     QStringList comment;
 
@@ -2166,195 +3123,196 @@ void CppCodeModel::writeClassMember(QString& code, Cpp::ClassMember& m)
 
     if (!comment.isEmpty())
     {
-        code += " ";
-        writeComment(code, comment.join(", "));
+        ctx.code += " ";
+        writeComment(ctx, comment.join(", "));
     }
 }
 
-void CppCodeModel::writeEnumType(QString& code, Cpp::EnumType& e, bool isInline)
+void CppCodeModel::writeEnumType(Cpp::WriteContext& ctx, Cpp::EnumType& e, bool isInline)
 {
     QStringList comment;
 
     if (m_settings.writeDwarfEntryOffsets)
     {
-        comment += QString("DWARF: %1").arg(Util::hexToString(e.entry->offset));
+        comment += QString("DWARF: %1").arg(Util::hexToString(localTypeOffset(ctx.compileUnit, e.entry->offset)));
     }
 
     if (!comment.isEmpty())
     {
-        writeComment(code, comment.join(", "));
-        writeNewline(code);
+        writeComment(ctx, comment.join(", "));
+        writeNewline(ctx);
     }
 
-    writeKeyword(code, Cpp::Keyword::Enum);
+    writeKeyword(ctx, Cpp::Keyword::Enum);
 
     if (!isInline && !e.name.isEmpty())
     {
-        code += QString(" %1").arg(e.name);
+        ctx.code += " ";
+        ctx.code.writeToken(CodeTokenKind::Identifier, e.name);
     }
 
-    writeNewline(code);
-    code += "{";
+    writeNewline(ctx);
+    ctx.code += "{";
 
     if (!e.elements.empty())
     {
         int prevValue = -1;
 
-        increaseIndent();
+        increaseIndent(ctx);
 
         for (int i = 0; i < e.elements.size(); i++)
         {
             Cpp::EnumElement& el = e.elements[i];
             bool explicitValue = (el.value != prevValue + 1);
 
-            writeNewline(code);
-            writeEnumElement(code, el, explicitValue);
+            writeNewline(ctx);
+            writeEnumElement(ctx, el, explicitValue);
 
             if (i < e.elements.size() - 1)
             {
-                code += ",";
+                ctx.code += ",";
             }
 
             prevValue = el.value;
         }
 
-        decreaseIndent();
+        decreaseIndent(ctx);
     }
 
-    writeNewline(code);
-    code += "}";
+    writeNewline(ctx);
+    ctx.code += "}";
 
     if (!isInline)
     {
-        code += ";";
+        ctx.code += ";";
     }
 }
 
-void CppCodeModel::writeEnumElement(QString& code, Cpp::EnumElement& e, bool explicitValue)
+void CppCodeModel::writeEnumElement(Cpp::WriteContext& ctx, Cpp::EnumElement& e, bool explicitValue)
 {
-    code += e.name;
+    ctx.code.writeToken(CodeTokenKind::Identifier, e.name);
 
     if (explicitValue || m_settings.forceExplicitEnumValues)
     {
-        code += " = ";
+        ctx.code += " = ";
 
         if (m_settings.hexadecimalEnumValues)
         {
-            code += Util::hexToString(e.value);
+            ctx.code.writeToken(CodeTokenKind::Number, Util::hexToString(e.value));
         }
         else
         {
-            code += QString("%1").arg(e.value);
+            ctx.code.writeToken(CodeTokenKind::Number, QString("%1").arg(e.value));
         }
     }
 }
 
-void CppCodeModel::writeArrayType(QString& code, Cpp::ArrayType& a, bool isInline)
+void CppCodeModel::writeArrayType(Cpp::WriteContext& ctx, Cpp::ArrayType& a, bool isInline)
 {
     QStringList comment;
 
     if (m_settings.writeDwarfEntryOffsets)
     {
-        comment += QString("DWARF: %1").arg(Util::hexToString(a.entry->offset));
+        comment += QString("DWARF: %1").arg(Util::hexToString(localTypeOffset(ctx.compileUnit, a.entry->offset)));
     }
 
     if (!comment.isEmpty())
     {
-        writeComment(code, comment.join(", "));
-        writeNewline(code);
+        writeComment(ctx, comment.join(", "));
+        writeNewline(ctx);
     }
 
-    writeKeyword(code, Cpp::Keyword::Typedef);
-    code += " ";
-    writeArrayTypePrefix(code, a);
+    writeKeyword(ctx, Cpp::Keyword::Typedef);
+    ctx.code += " ";
+    writeArrayTypePrefix(ctx, a);
 
     if (!isInline && !a.name.isEmpty())
     {
-        code += a.name;
+        ctx.code.writeToken(CodeTokenKind::Identifier, a.name);
     }
 
-    writeArrayTypePostfix(code, a);
+    writeArrayTypePostfix(ctx, a);
 
     if (!isInline)
     {
-        code += ";";
+        ctx.code += ";";
     }
 }
 
-void CppCodeModel::writeFunctionType(QString& code, Cpp::FunctionType& f, bool isInline)
+void CppCodeModel::writeFunctionType(Cpp::WriteContext& ctx, Cpp::FunctionType& f, bool isInline)
 {
     QStringList comment;
 
     if (m_settings.writeDwarfEntryOffsets)
     {
-        comment += QString("DWARF: %1").arg(Util::hexToString(f.entry->offset));
+        comment += QString("DWARF: %1").arg(Util::hexToString(localTypeOffset(ctx.compileUnit, f.entry->offset)));
     }
 
     if (!comment.isEmpty())
     {
-        writeComment(code, comment.join(", "));
-        writeNewline(code);
+        writeComment(ctx, comment.join(", "));
+        writeNewline(ctx);
     }
 
-    writeKeyword(code, Cpp::Keyword::Typedef);
-    code += " ";
-    writeFunctionTypePrefix(code, f);
+    writeKeyword(ctx, Cpp::Keyword::Typedef);
+    ctx.code += " ";
+    writeFunctionTypePrefix(ctx, f);
 
     if (!isInline && !f.name.isEmpty())
     {
-        code += f.name;
+        ctx.code.writeToken(CodeTokenKind::Identifier, f.name);
     }
 
-    writeFunctionTypePostfix(code, f);
+    writeFunctionTypePostfix(ctx, f);
 
     if (!isInline)
     {
-        code += ";";
+        ctx.code += ";";
     }
 }
 
-void CppCodeModel::writePointerToMemberType(QString& code, Cpp::PointerToMemberType& p, bool isInline)
+void CppCodeModel::writePointerToMemberType(Cpp::WriteContext& ctx, Cpp::PointerToMemberType& p, bool isInline)
 {
     QStringList comment;
 
     if (m_settings.writeDwarfEntryOffsets)
     {
-        comment += QString("DWARF: %1").arg(Util::hexToString(p.entry->offset));
+        comment += QString("DWARF: %1").arg(Util::hexToString(localTypeOffset(ctx.compileUnit, p.entry->offset)));
     }
 
     if (!comment.isEmpty())
     {
-        writeComment(code, comment.join(", "));
-        writeNewline(code);
+        writeComment(ctx, comment.join(", "));
+        writeNewline(ctx);
     }
 
-    writeKeyword(code, Cpp::Keyword::Typedef);
-    code += " ";
-    writePointerToMemberTypePrefix(code, p);
+    writeKeyword(ctx, Cpp::Keyword::Typedef);
+    ctx.code += " ";
+    writePointerToMemberTypePrefix(ctx, p);
 
     if (!isInline && !p.name.isEmpty())
     {
-        code += p.name;
+        ctx.code.writeToken(CodeTokenKind::Identifier, p.name);
     }
 
-    writePointerToMemberTypePostfix(code, p);
+    writePointerToMemberTypePostfix(ctx, p);
 
     if (!isInline)
     {
-        code += ";";
+        ctx.code += ";";
     }
 }
 
-void CppCodeModel::writeVariable(QString& code, Cpp::Variable& v)
+void CppCodeModel::writeVariable(Cpp::WriteContext& ctx, Cpp::Variable& v)
 {
     if (!v.isGlobal)
     {
-        writeKeyword(code, Cpp::Keyword::Static);
-        code += " ";
+        writeKeyword(ctx, Cpp::Keyword::Static);
+        ctx.code += " ";
     }
 
-    writeDeclaration(code, v);
-    code += ";";
+    writeDeclaration(ctx, v);
+    ctx.code += ";";
 
     QStringList comment;
 
@@ -2370,72 +3328,86 @@ void CppCodeModel::writeVariable(QString& code, Cpp::Variable& v)
 
     if (!comment.isEmpty())
     {
-        code += " ";
-        writeComment(code, comment.join(", "));
+        ctx.code += " ";
+        writeComment(ctx, comment.join(", "));
     }
 }
 
-void CppCodeModel::writeFunctionDeclaration(QString& code, Cpp::Function& f, bool isInsideClass)
+void CppCodeModel::writeFunctionDeclaration(Cpp::WriteContext& ctx, Cpp::Function& f, bool isInsideClass)
 {
-    writeFunctionSignature(code, f, true, isInsideClass);
-    code += ";";
+    writeFunctionSignature(ctx, f, true, isInsideClass);
+    ctx.code += ";";
 }
 
-void CppCodeModel::writeFunctionDefinition(QString& code, Cpp::Function& f)
+void CppCodeModel::writeFunctionDefinition(Cpp::WriteContext& ctx, Cpp::Function& f)
 {
+    TRACE_SCOPE_DETAIL("CppCodeModel::writeFunctionDefinition", f.name);
+
     if (m_settings.writeFunctionMangledNames)
     {
-        writeComment(code, f.mangledName);
-        writeNewline(code);
+        writeComment(ctx, f.mangledName);
+        writeNewline(ctx);
     }
 
     if (m_settings.writeDwarfEntryOffsets)
     {
-        writeComment(code, QString("DWARF: %1").arg(Util::hexToString(f.entry->offset)));
-        writeNewline(code);
+        writeComment(ctx, QString("DWARF: %1").arg(Util::hexToString(f.entry->offset)));
+        writeNewline(ctx);
     }
 
     if (m_settings.writeFunctionAddresses)
     {
-        writeComment(code, QString("Address: %1").arg(Util::hexToString(f.startAddress)));
-        writeNewline(code);
+        writeComment(ctx, QString("Address: %1").arg(Util::hexToString(f.startAddress)));
+        writeNewline(ctx);
     }
 
     if (m_settings.writeFunctionSizes)
     {
-        writeComment(code, QString("Size: %1").arg(Util::hexToString(f.endAddress - f.startAddress)));
-        writeNewline(code);
+        writeComment(ctx, QString("Size: %1").arg(Util::hexToString(f.endAddress - f.startAddress)));
+        writeNewline(ctx);
     }
 
-    writeFunctionSignature(code, f, false, false);
-    writeNewline(code);
-    code += "{";
+    writeFunctionSignature(ctx, f, false, false);
+    writeNewline(ctx);
+    ctx.code += "{";
 
-    increaseIndent();
+    increaseIndent(ctx);
 
     for (Cpp::FunctionVariable& v : f.variables)
     {
-        writeNewline(code);
-        writeFunctionVariable(code, v);
+        writeNewline(ctx);
+        writeFunctionVariable(ctx, v);
     }
 
     bool wroteDisassembly = false;
 
     if (m_settings.writeFunctionDisassembly)
     {
-        Disassembly disasm;
+        // never disassembled here, the cache does that on the thread pool
+        const Disassembly* disasm = DisassemblyCache::find(f.startAddress, f.endAddress);
 
-        if (Disassemblers::disassemble(disasm, dwarf()->elf, f.startAddress, f.endAddress))
+        if (disasm)
         {
-            writeNewline(code);
+            writeNewline(ctx);
 
             int leftSize = 0;
             int rightSize = 0;
+            QStringList leftTexts;
+            QStringList rightTexts;
 
-            for (int line = 0; line < disasm.lineCount(); line++)
+            // each line is read once here and reused for both passes
+            for (int line = 0; line < disasm->lineCount(); line++)
             {
-                leftSize = qMax(leftSize, disasm.leftText(line).size());
-                rightSize = qMax(rightSize, disasm.rightText(line).size());
+                QString leftText;
+                QString rightText;
+
+                disasm->formatLine(line, leftText, rightText);
+
+                leftSize = qMax(leftSize, leftText.size());
+                rightSize = qMax(rightSize, rightText.size());
+
+                leftTexts.append(leftText);
+                rightTexts.append(rightText);
             }
 
             leftSize += 4;
@@ -2445,32 +3417,38 @@ void CppCodeModel::writeFunctionDefinition(QString& code, Cpp::Function& f)
             {
                 int lineNumberIndex = 0;
 
-                for (int line = 0; line < disasm.lineCount(); line++)
+                for (int line = 0; line < disasm->lineCount(); line++)
                 {
-                    writeNewline(code);
-                    writeDisassemblyLineComment(code, disasm.leftText(line), disasm.rightText(line), leftSize, rightSize);
+                    writeNewline(ctx);
+                    writeDisassemblyLineComment(ctx, leftTexts[line], rightTexts[line], leftSize, rightSize);
 
                     if (lineNumberIndex < f.lineNumbers.size()
-                        && f.lineNumbers[lineNumberIndex].address == disasm.address(line))
+                        && f.lineNumbers[lineNumberIndex].address == disasm->address(line))
                     {
-                        writeLineNumberComment(code, f.lineNumbers[lineNumberIndex]);
+                        writeLineNumberComment(ctx, f.lineNumbers[lineNumberIndex]);
                         lineNumberIndex++;
                     }
                 }
             }
             else
             {
-                for (int line = 0; line < disasm.lineCount(); line++)
+                for (int line = 0; line < disasm->lineCount(); line++)
                 {
-                    writeNewline(code);
-                    writeDisassemblyLineComment(code, disasm.leftText(line), disasm.rightText(line), leftSize, rightSize);
+                    writeNewline(ctx);
+                    writeDisassemblyLineComment(ctx, leftTexts[line], rightTexts[line], leftSize, rightSize);
                 }
             }
 
-            writeNewline(code);
+            writeNewline(ctx);
 
             wroteDisassembly = true;
         }
+        else if (!DisassemblyCache::isReady())
+        {
+            writeNewline(ctx);
+            writeNewline(ctx);
+            writeComment(ctx, tr("Disassembling..."));
+        }
         else
         {
             Output::write(tr("Warning: Failed to disassemble function %1").arg(f.name));
@@ -2479,27 +3457,27 @@ void CppCodeModel::writeFunctionDefinition(QString& code, Cpp::Function& f)
     
     if (!wroteDisassembly && !f.lineNumbers.isEmpty() && m_settings.writeLineNumbers)
     {
-        writeNewline(code);
+        writeNewline(ctx);
 
         for (Cpp::LineNumber& l : f.lineNumbers)
         {
-            writeNewline(code);
-            writeLineNumberComment(code, l);
+            writeNewline(ctx);
+            writeLineNumberComment(ctx, l);
         }
     }
 
-    decreaseIndent();
+    decreaseIndent(ctx);
 
-    writeNewline(code);
-    code += "}";
+    writeNewline(ctx);
+    ctx.code += "}";
 }
 
-void CppCodeModel::writeDisassemblyLineComment(QString& code, const QString& leftText, const QString& rightText, int leftSize, int rightSize)
+void CppCodeModel::writeDisassemblyLineComment(Cpp::WriteContext& ctx, const QString& leftText, const QString& rightText, int leftSize, int rightSize)
 {
-    code += QString("// %1%2").arg(leftText, -leftSize, ' ').arg(rightText, -rightSize, ' ');
+    ctx.code.writeToken(CodeTokenKind::Comment, QString("// %1%2").arg(leftText, -leftSize, ' ').arg(rightText, -rightSize, ' '));
 }
 
-void CppCodeModel::writeLineNumberComment(QString& code, Cpp::LineNumber& l)
+void CppCodeModel::writeLineNumberComment(Cpp::WriteContext& ctx, Cpp::LineNumber& l)
 {
     QStringList comment;
 
@@ -2515,10 +3493,10 @@ void CppCodeModel::writeLineNumberComment(QString& code, Cpp::LineNumber& l)
         comment += QString("Address: %1").arg(Util::hexToString(l.address));
     }
 
-    writeComment(code, comment.join(", "));
+    writeComment(ctx, comment.join(", "));
 }
 
-void CppCodeModel::writeFunctionSignature(QString& code, Cpp::Function& f, bool isDeclaration, bool isInsideClass)
+void CppCodeModel::writeFunctionSignature(Cpp::WriteContext& ctx, Cpp::Function& f, bool isDeclaration, bool isInsideClass)
 {
     bool isNonStaticMemberFunction = false;
     bool isConstMemberFunction = false;
@@ -2544,70 +3522,83 @@ void CppCodeModel::writeFunctionSignature(QString& code, Cpp::Function& f, bool
     if ((!f.isMember && !f.isGlobal)
         || (f.isMember && !isNonStaticMemberFunction && isInsideClass && m_settings.staticMemberFunctions))
     {
-        writeKeyword(code, Cpp::Keyword::Static);
-        code += " ";
+        writeKeyword(ctx, Cpp::Keyword::Static);
+        ctx.code += " ";
     }
 
     if (f.isInline)
     {
-        writeKeyword(code, Cpp::Keyword::Inline);
-        code += " ";
+        writeKeyword(ctx, Cpp::Keyword::Inline);
+        ctx.code += " ";
     }
 
     if (!isConstructorOrDestructor)
     {
-        writeTypePrefix(code, f.type);
-        writeTypePostfix(code, f.type);
-        code += " ";
+        writeTypePrefix(ctx, f.type);
+        writeTypePostfix(ctx, f.type);
+        ctx.code += " ";
     }
 
     QString name = f.name;
 
-    if (f.isMember)
-    {
-        Q_ASSERT(m_offsetToClassTypeMap.contains(f.memberTypeOffset));
+    Cpp::ClassType* c = f.isMember ? findClassType(f.memberTypeOffset) : nullptr;
 
-        Cpp::ClassType& c = m_offsetToClassTypeMap[f.memberTypeOffset];
+    Q_ASSERT(!f.isMember || c);
 
+    if (c)
+    {
         if (!isInsideClass)
         {
-            code += QString("%1::").arg(c.name);
+            ctx.code.writeToken(CodeTokenKind::TypeReference, c->name, localTypeOffset(ctx.compileUnit, c->entry->offset));
+            ctx.code += "::";
         }
         
         if (isConstructorOrDestructor)
         {
             if (f.name == "__ct")
             {
-                name = c.name;
+                name = c->name;
             }
             else if (f.name == "__dt")
             {
-                name = QString("~%1").arg(c.name);
+                name = QString("~%1").arg(c->name);
             }
         }
     }
 
     if (!isConstructorOrDestructor
-        && f.name.startsWith("__")
-        && operatorDemangleMap.contains(f.name))
+        && f.name.startsWith(QLatin1String("__")))
+    {
+        QString operatorName = Demangler::operatorName(f.name);
+
+        if (!operatorName.isEmpty())
+        {
+            name = operatorName;
+        }
+    }
+
+    if (isInsideClass)
+    {
+        ctx.code.writeToken(CodeTokenKind::FunctionReference, name, f.entry->offset);
+    }
+    else
     {
-        name = operatorDemangleMap[f.name];
+        ctx.code.writeToken(CodeTokenKind::Identifier, name);
     }
 
-    code += name;
-    writeFunctionParameters(code, f, isDeclaration);
+    writeFunctionParameters(ctx, f, isDeclaration);
 
     if (isConstMemberFunction)
     {
-        code += " ";
-        writeKeyword(code, Cpp::Keyword::Const);
+        ctx.code += " ";
+        writeKeyword(ctx, Cpp::Keyword::Const);
     }
 }
 
-void CppCodeModel::writeFunctionVariable(QString& code, Cpp::FunctionVariable& v)
+void CppCodeModel::writeFunctionVariable(Cpp::WriteContext& ctx, Cpp::FunctionVariable& v)
 {
-    writeDeclaration(code, v);
-    code += ";";
+    writeDeclaration(ctx, v);
+    ctx.code += ";";
 
     QStringList comment;
 
@@ -2623,53 +3614,149 @@ void CppCodeModel::writeFunctionVariable(QString& code, Cpp::FunctionVariable& v
 
     if (!comment.isEmpty())
     {
-        code += " ";
-        writeComment(code, comment.join(", "));
+        ctx.code += " ";
+        writeComment(ctx, comment.join(", "));
     }
 }
 
-void CppCodeModel::writeDeclaration(QString& code, Cpp::Declaration& d)
+void CppCodeModel::writeDeclaration(Cpp::WriteContext& ctx, Cpp::Declaration& d)
 {
     bool isFunctionType = false;
 
-    writeTypePrefix(code, d.type, &isFunctionType);
+    writeTypePrefix(ctx, d.type, &isFunctionType);
 
     if (!d.name.isEmpty())
     {
         if (!isFunctionType)
         {
-            code += " ";
+            ctx.code += " ";
         }
 
-        code += d.name;
+        ctx.code.writeToken(CodeTokenKind::Identifier, d.name);
     }
 
-    writeTypePostfix(code, d.type);
+    writeTypePostfix(ctx, d.type);
 }
 
-void CppCodeModel::writeTypedef(QString& code, Cpp::Typedef& t)
+void CppCodeModel::writeTypedef(Cpp::WriteContext& ctx, Cpp::Typedef& t)
 {
     bool isFunctionType = false;
 
-    writeKeyword(code, Cpp::Keyword::Typedef);
-    code += " ";
-    writeTypePrefix(code, t.type, &isFunctionType);
+    writeKeyword(ctx, Cpp::Keyword::Typedef);
+    ctx.code += " ";
+    writeTypePrefix(ctx, t.type, &isFunctionType);
 
     if (!t.name.isEmpty())
     {
         if (!isFunctionType)
         {
-            code += " ";
+            ctx.code += " ";
+        }
+
+        ctx.code.writeToken(CodeTokenKind::Identifier, t.name);
+    }
+
+    writeTypePostfix(ctx, t.type);
+    ctx.code += ";";
+}
+
+const Cpp::TypeSpelling* CppCodeModel::typeSpelling(Cpp::WriteContext& ctx, Cpp::Type& t)
+{
+    if (t.modifiers.size() > MAX_TYPE_SPELLING_MODIFIERS)
+    {
+        return nullptr;
+    }
+
+    TypeSpellingCache& cache = s_typeSpellingCache;
+    quint64 generation = m_typeSpellingGeneration.loadAcquire();
+    quint64 settings = fragmentSettings() & TypeSettings;
+
+    if (cache.generation != generation || cache.settings != settings)
+    {
+        cache.generation = generation;
+        cache.settings = settings;
+        cache.spellings.clear();
+    }
+
+    // the whole type fits in the key: offset or fundamental type in the low
+    // 32 bits, then the qualifiers, modifier count and 3 bits per modifier
+    quint64 key = t.isFundamental ? (quint64)t.fundType : (quint64)localTypeOffset(ctx.compileUnit, t.userTypeOffset);
+
+    key |= (quint64)t.isFundamental << 32;
+    key |= (quint64)t.isConst << 33;
+    key |= (quint64)t.isVolatile << 34;
+    key |= (quint64)t.modifiers.size() << 35;
+
+    for (int i = 0; i < t.modifiers.size(); i++)
+    {
+        const Cpp::Modifier& m = t.modifiers[i];
+        quint64 bits = (quint64)m.type | ((quint64)m.isConst << 1) | ((quint64)m.isVolatile << 2);
+
+        key |= bits << (38 + i * 3);
+    }
+
+    auto it = cache.spellings.constFind(key);
+
+    if (it == cache.spellings.constEnd())
+    {
+        Cpp::TypeSpelling spelling;
+
+        TokenCodeSink prefixSink(spelling.prefix, spelling.prefixTokens);
+        Cpp::WriteContext prefixContext = { prefixSink, ctx.indentLevel, ctx.minIndentLevel, false, ctx.compileUnit };
+
+        renderTypePrefix(prefixContext, t, &spelling.isFunctionType);
+
+        spelling.isInlined = prefixContext.inlinedType;
+
+        if (spelling.isInlined)
+        {
+            spelling.prefix.clear();
+            spelling.prefixTokens.clear();
+        }
+        else
+        {
+            TokenCodeSink postfixSink(spelling.postfix, spelling.postfixTokens);
+            Cpp::WriteContext postfixContext = { postfixSink, ctx.indentLevel, ctx.minIndentLevel, false, ctx.compileUnit };
+
+            renderTypePostfix(postfixContext, t);
+        }
+
+        // rendering may have added spellings of its own, so look it up again
+        // through insert rather than reusing the iterator
+        it = cache.spellings.insert(key, spelling);
+    }
+
+    return it->isInlined ? nullptr : &*it;
+}
+
+void CppCodeModel::writeTypePrefix(Cpp::WriteContext& ctx, Cpp::Type& t, bool* outIsFunctionType)
+{
+    if (const Cpp::TypeSpelling* spelling = typeSpelling(ctx, t))
+    {
+        if (outIsFunctionType)
+        {
+            *outIsFunctionType = spelling->isFunctionType;
         }
 
-        code += t.name;
+        ctx.code.writeTokens(spelling->prefix, spelling->prefixTokens);
+        return;
+    }
+
+    renderTypePrefix(ctx, t, outIsFunctionType);
+}
+
+void CppCodeModel::writeTypePostfix(Cpp::WriteContext& ctx, Cpp::Type& t)
+{
+    if (const Cpp::TypeSpelling* spelling = typeSpelling(ctx, t))
+    {
+        ctx.code.writeTokens(spelling->postfix, spelling->postfixTokens);
+        return;
     }
 
-    writeTypePostfix(code, t.type);
-    code += ";";
+    renderTypePostfix(ctx, t);
 }
 
-void CppCodeModel::writeTypePrefix(QString& code, Cpp::Type& t, bool* outIsFunctionType)
+void CppCodeModel::renderTypePrefix(Cpp::WriteContext& ctx, Cpp::Type& t, bool* outIsFunctionType)
 {
     if (outIsFunctionType)
     {
@@ -2678,39 +3765,52 @@ void CppCodeModel::writeTypePrefix(QString& code, Cpp::Type& t, bool* outIsFunct
 
     if (t.isConst || t.isVolatile)
     {
-        writeConstVolatile(code, t.isConst, t.isVolatile);
-        code += " ";
+        writeConstVolatile(ctx, t.isConst, t.isVolatile);
+        ctx.code += " ";
     }
 
     if (t.isFundamental)
     {
-        writeFundamentalType(code, t.fundType);
+        writeFundamentalType(ctx, t.fundType);
     }
     else
     {
-        Q_ASSERT(m_offsetToEntryMap.contains(t.userTypeOffset));
+        DwarfEntry* userTypeEntry = findEntry(localTypeOffset(ctx.compileUnit, t.userTypeOffset));
+
+        Q_ASSERT(userTypeEntry);
 
-        DwarfEntry* userTypeEntry = m_offsetToEntryMap[t.userTypeOffset];
         QString name = userTypeEntry->getName();
 
         if (typeCanBeInlined(name))
         {
-            switch (userTypeEntry->tag)
+            switch (entityKind(userTypeEntry))
             {
-            case DW_TAG_class_type:
-            case DW_TAG_structure_type:
-            case DW_TAG_union_type:
-                writeClassTypePrefix(code, m_offsetToClassTypeMap[userTypeEntry->offset]);
+            case Cpp::EntityKind::ClassType:
+                if (Cpp::ClassType* c = findClassType(userTypeEntry->offset))
+                {
+                    writeClassTypePrefix(ctx, *c);
+                    ctx.inlinedType = true;
+                }
                 break;
-            case DW_TAG_enumeration_type:
-                writeEnumTypePrefix(code, m_offsetToEnumTypeMap[userTypeEntry->offset]);
+            case Cpp::EntityKind::EnumType:
+                if (Cpp::EnumType* e = findEnumType(userTypeEntry->offset))
+                {
+                    writeEnumTypePrefix(ctx, *e);
+                    ctx.inlinedType = true;
+                }
                 break;
-            case DW_TAG_array_type:
-                writeArrayTypePrefix(code, m_offsetToArrayTypeMap[userTypeEntry->offset]);
+            case Cpp::EntityKind::ArrayType:
+                if (Cpp::ArrayType* a = findArrayType(userTypeEntry->offset))
+                {
+                    writeArrayTypePrefix(ctx, *a);
+                }
                 break;
-            case DW_TAG_subroutine_type:
+            case Cpp::EntityKind::FunctionType:
             {
-                writeFunctionTypePrefix(code, m_offsetToFunctionTypeMap[userTypeEntry->offset]);
+                if (Cpp::FunctionType* f = findFunctionType(userTypeEntry->offset))
+                {
+                    writeFunctionTypePrefix(ctx, *f);
+                }
 
                 if (outIsFunctionType)
                 {
@@ -2719,125 +3819,151 @@ void CppCodeModel::writeTypePrefix(QString& code, Cpp::Type& t, bool* outIsFunct
 
                 break;
             }
-            case DW_TAG_ptr_to_member_type:
+            case Cpp::EntityKind::PointerToMemberType:
             {
-                Cpp::PointerToMemberType& p = m_offsetToPointerToMemberTypeMap[userTypeEntry->offset];
-                writePointerToMemberTypePrefix(code, p);
+                Cpp::PointerToMemberType* p = findPointerToMemberType(userTypeEntry->offset);
+
+                if (!p)
+                {
+                    break;
+                }
+
+                writePointerToMemberTypePrefix(ctx, *p);
 
                 if (outIsFunctionType
-                    && !p.type.isFundamental
-                    && m_offsetToEntryMap[p.type.userTypeOffset]->tag == DW_TAG_subroutine_type)
+                    && !p->type.isFundamental
+                    && findEntry(p->type.userTypeOffset)->tag == DW_TAG_subroutine_type)
                 {
                     *outIsFunctionType = true;
                 }
 
                 break;
             }
+            default:
+                break;
             }
         }
         else
         {
-            code += name;
+            ctx.code.writeToken(CodeTokenKind::TypeReference, name, userTypeEntry->offset);
         }
     }
 
     for (int i = 0; i < t.modifiers.size(); i++)
     {
-        writeModifier(code, t.modifiers[i]);
+        writeModifier(ctx, t.modifiers[i]);
 
         if (i < t.modifiers.size() - 1 && (t.modifiers[i].isConst || t.modifiers[i].isVolatile))
         {
-            code += " ";
+            ctx.code += " ";
         }
     }
 }
 
-void CppCodeModel::writeTypePostfix(QString& code, Cpp::Type& t)
+void CppCodeModel::renderTypePostfix(Cpp::WriteContext& ctx, Cpp::Type& t)
 {
     if (t.isFundamental)
     {
         return;
     }
 
-    Q_ASSERT(m_offsetToEntryMap.contains(t.userTypeOffset));
+    DwarfEntry* userTypeEntry = findEntry(t.userTypeOffset);
+
+    Q_ASSERT(userTypeEntry);
 
-    DwarfEntry* userTypeEntry = m_offsetToEntryMap[t.userTypeOffset];
     QString name = userTypeEntry->getName();
 
     if (typeCanBeInlined(name))
     {
-        switch (userTypeEntry->tag)
+        switch (entityKind(userTypeEntry))
         {
-        case DW_TAG_class_type:
-        case DW_TAG_structure_type:
-        case DW_TAG_union_type:
-            writeClassTypePostfix(code, m_offsetToClassTypeMap[userTypeEntry->offset]);
+        case Cpp::EntityKind::ClassType:
+            if (Cpp::ClassType* c = findClassType(userTypeEntry->offset))
+            {
+                writeClassTypePostfix(ctx, *c);
+            }
             break;
-        case DW_TAG_enumeration_type:
-            writeEnumTypePostfix(code, m_offsetToEnumTypeMap[userTypeEntry->offset]);
+        case Cpp::EntityKind::EnumType:
+            if (Cpp::EnumType* e = findEnumType(userTypeEntry->offset))
+            {
+                writeEnumTypePostfix(ctx, *e);
+            }
             break;
-        case DW_TAG_array_type:
-            writeArrayTypePostfix(code, m_offsetToArrayTypeMap[userTypeEntry->offset]);
+        case Cpp::EntityKind::ArrayType:
+            if (Cpp::ArrayType* a = findArrayType(userTypeEntry->offset))
+            {
+                writeArrayTypePostfix(ctx, *a);
+            }
             break;
-        case DW_TAG_subroutine_type:
-            writeFunctionTypePostfix(code, m_offsetToFunctionTypeMap[userTypeEntry->offset]);
+        case Cpp::EntityKind::FunctionType:
+            if (Cpp::FunctionType* f = findFunctionType(userTypeEntry->offset))
+            {
+                writeFunctionTypePostfix(ctx, *f);
+            }
             break;
-        case DW_TAG_ptr_to_member_type:
-            writePointerToMemberTypePostfix(code, m_offsetToPointerToMemberTypeMap[userTypeEntry->offset]);
+        case Cpp::EntityKind::PointerToMemberType:
+            if (Cpp::PointerToMemberType* p = findPointerToMemberType(userTypeEntry->offset))
+            {
+                writePointerToMemberTypePostfix(ctx, *p);
+            }
+            break;
+        default:
             break;
         };
     }
 }
 
-void CppCodeModel::writeClassTypePrefix(QString& code, Cpp::ClassType& c)
+void CppCodeModel::writeClassTypePrefix(Cpp::WriteContext& ctx, Cpp::ClassType& c)
 {
-    writeClassType(code, c, true);
+    writeClassType(ctx, c, true);
 }
 
-void CppCodeModel::writeClassTypePostfix(QString& code, Cpp::ClassType& c)
+void CppCodeModel::writeClassTypePostfix(Cpp::WriteContext& ctx, Cpp::ClassType& c)
 {
 }
 
-void CppCodeModel::writeEnumTypePrefix(QString& code, Cpp::EnumType& e)
+void CppCodeModel::writeEnumTypePrefix(Cpp::WriteContext& ctx, Cpp::EnumType& e)
 {
-    writeEnumType(code, e, true);
+    writeEnumType(ctx, e, true);
 }
 
-void CppCodeModel::writeEnumTypePostfix(QString& code, Cpp::EnumType& e)
+void CppCodeModel::writeEnumTypePostfix(Cpp::WriteContext& ctx, Cpp::EnumType& e)
 {
 }
 
-void CppCodeModel::writeArrayTypePrefix(QString& code, Cpp::ArrayType& a)
+void CppCodeModel::writeArrayTypePrefix(Cpp::WriteContext& ctx, Cpp::ArrayType& a)
 {
-    writeTypePrefix(code, a.type);
+    writeTypePrefix(ctx, a.type);
 }
 
-void CppCodeModel::writeArrayTypePostfix(QString& code, Cpp::ArrayType& a)
+void CppCodeModel::writeArrayTypePostfix(Cpp::WriteContext& ctx, Cpp::ArrayType& a)
 {
     for (int dimension : a.dimensions)
     {
-        code += QString("[%1]").arg(dimension);
+        ctx.code += "[";
+        ctx.code.writeToken(CodeTokenKind::Number, QString::number(dimension));
+        ctx.code += "]";
     }
 
-    writeTypePostfix(code, a.type);
+    writeTypePostfix(ctx, a.type);
 }
 
-void CppCodeModel::writeFunctionTypePrefix(QString& code, Cpp::FunctionType& f)
+void CppCodeModel::writeFunctionTypePrefix(Cpp::WriteContext& ctx, Cpp::FunctionType& f)
 {
-    writeTypePrefix(code, f.type);
-    code += "(";
+    writeTypePrefix(ctx, f.type);
+    ctx.code += "(";
 }
 
-void CppCodeModel::writeFunctionTypePostfix(QString& code, Cpp::FunctionType& f)
+void CppCodeModel::writeFunctionTypePostfix(Cpp::WriteContext& ctx, Cpp::FunctionType& f)
 {
-    code += ")";
-    writeFunctionParameters(code, f, true);
-    writeTypePostfix(code, f.type);
+    ctx.code += ")";
+    writeFunctionParameters(ctx, f, true);
+    writeTypePostfix(ctx, f.type);
 }
 
-void CppCodeModel::writeFunctionParameters(QString& code, Cpp::FunctionType& f, bool isDeclaration)
+void CppCodeModel::writeFunctionParameters(Cpp::WriteContext& ctx, Cpp::FunctionType& f, bool isDeclaration)
 {
-    code += "(";
+    ctx.code += "(";
 
     for (int i = 0; i < f.parameters.size(); i++)
     {
@@ -2846,150 +3972,150 @@ void CppCodeModel::writeFunctionParameters(QString& code, Cpp::FunctionType& f,
             continue;
         }
 
-        writeFunctionParameter(code, f.parameters[i], isDeclaration);
+        writeFunctionParameter(ctx, f.parameters[i], isDeclaration);
 
         if (i < f.parameters.size() - 1)
         {
-            code += ", ";
+            ctx.code += ", ";
         }
     }
 
-    code += ")";
+    ctx.code += ")";
 }
 
-void CppCodeModel::writeFunctionParameter(QString& code, Cpp::FunctionParameter& p, bool isDeclaration)
+void CppCodeModel::writeFunctionParameter(Cpp::WriteContext& ctx, Cpp::FunctionParameter& p, bool isDeclaration)
 {
-    writeDeclaration(code, p);
+    writeDeclaration(ctx, p);
 
     if (!isDeclaration
         && m_settings.writeFunctionVariableLocations
         && !p.location.isEmpty())
     {
-        code += " ";
-        writeMultilineComment(code, p.location);
+        ctx.code += " ";
+        writeMultilineComment(ctx, p.location);
     }
 }
 
-void CppCodeModel::writePointerToMemberTypePrefix(QString& code, Cpp::PointerToMemberType& p)
+void CppCodeModel::writePointerToMemberTypePrefix(Cpp::WriteContext& ctx, Cpp::PointerToMemberType& p)
 {
     bool isFunctionType = false;
 
-    writeTypePrefix(code, p.type, &isFunctionType);
+    writeTypePrefix(ctx, p.type, &isFunctionType);
 
     if (!isFunctionType)
     {
-        code += " ";
+        ctx.code += " ";
     }
 
-    writeTypePrefix(code, p.containingType);
-    code += "::*";
+    writeTypePrefix(ctx, p.containingType);
+    ctx.code += "::*";
 }
 
-void CppCodeModel::writePointerToMemberTypePostfix(QString& code, Cpp::PointerToMemberType& p)
+void CppCodeModel::writePointerToMemberTypePostfix(Cpp::WriteContext& ctx, Cpp::PointerToMemberType& p)
 {
-    writeTypePostfix(code, p.containingType);
-    writeTypePostfix(code, p.type);
+    writeTypePostfix(ctx, p.containingType);
+    writeTypePostfix(ctx, p.type);
 }
 
-void CppCodeModel::writeFundamentalType(QString& code, Cpp::FundamentalType t)
+void CppCodeModel::writeFundamentalType(Cpp::WriteContext& ctx, Cpp::FundamentalType t)
 {
     if (m_settings.fundamentalTypeNames.contains(t))
     {
-        code += m_settings.fundamentalTypeNames[t];
+        ctx.code.writeToken(CodeTokenKind::Keyword, m_settings.fundamentalTypeNames[t]);
     }
     else
     {
-        code += QString("<unknown type %1>").arg(Util::hexToString((quint32)t));
+        ctx.code += QString("<unknown type %1>").arg(Util::hexToString((quint32)t));
     }
 }
 
-void CppCodeModel::writeModifier(QString& code, Cpp::Modifier& m)
+void CppCodeModel::writeModifier(Cpp::WriteContext& ctx, Cpp::Modifier& m)
 {
     if (m.type == Cpp::ModifierType::Pointer)
     {
-        code += "*";
+        ctx.code += "*";
     }
     else if (m.type == Cpp::ModifierType::Reference)
     {
-        code += "&";
+        ctx.code += "&";
     }
 
     if (m.isConst || m.isVolatile)
     {
-        code += " ";
-        writeConstVolatile(code, m.isConst, m.isVolatile);
+        ctx.code += " ";
+        writeConstVolatile(ctx, m.isConst, m.isVolatile);
     }
 }
 
-void CppCodeModel::writeConstVolatile(QString& code, bool isConst, bool isVolatile)
+void CppCodeModel::writeConstVolatile(Cpp::WriteContext& ctx, bool isConst, bool isVolatile)
 {
     if (isConst && isVolatile)
     {
-        writeKeyword(code, Cpp::Keyword::Const);
-        code += " ";
-        writeKeyword(code, Cpp::Keyword::Volatile);
+        writeKeyword(ctx, Cpp::Keyword::Const);
+        ctx.code += " ";
+        writeKeyword(ctx, Cpp::Keyword::Volatile);
     }
     else if (isConst)
     {
-        writeKeyword(code, Cpp::Keyword::Const);
+        writeKeyword(ctx, Cpp::Keyword::Const);
     }
     else if (isVolatile)
     {
-        writeKeyword(code, Cpp::Keyword::Volatile);
+        writeKeyword(ctx, Cpp::Keyword::Volatile);
     }
 }
 
-void CppCodeModel::writeKeyword(QString& code, Cpp::Keyword keyword)
+void CppCodeModel::writeKeyword(Cpp::WriteContext& ctx, Cpp::Keyword keyword)
 {
     Q_ASSERT(s_keywordToStringMap.contains(keyword));
 
-    code += s_keywordToStringMap[keyword];
+    ctx.code.writeToken(CodeTokenKind::Keyword, s_keywordToStringMap[keyword]);
 }
 
-void CppCodeModel::writeComment(QString& code, const QString& text)
+void CppCodeModel::writeComment(Cpp::WriteContext& ctx, const QString& text)
 {
-    code += QString("// %1").arg(text);
+    ctx.code.writeToken(CodeTokenKind::Comment, QString("// %1").arg(text));
 }
 
-void CppCodeModel::writeMultilineComment(QString& code, const QString& text)
+void CppCodeModel::writeMultilineComment(Cpp::WriteContext& ctx, const QString& text)
 {
-    code += QString("/* %1 */").arg(text);
+    ctx.code.writeToken(CodeTokenKind::Comment, QString("/* %1 */").arg(text));
 }
 
-void CppCodeModel::writeNewline(QString& code, bool indent)
+void CppCodeModel::writeNewline(Cpp::WriteContext& ctx, bool indent)
 {
-    code += "\n";
+    ctx.code += "\n";
 
     if (indent)
     {
-        for (int i = 0; i < m_indentLevel; i++)
+        for (int i = 0; i < ctx.indentLevel; i++)
         {
-            code += "    ";
+            ctx.code += "    ";
         }
     }
     else
     {
-        for (int i = 0; i < m_minIndentLevel; i++)
+        for (int i = 0; i < ctx.minIndentLevel; i++)
         {
-            code += "    ";
+            ctx.code += "    ";
         }
     }
 }
 
-void CppCodeModel::increaseIndent()
+void CppCodeModel::increaseIndent(Cpp::WriteContext& ctx)
 {
-    m_indentLevel++;
+    ctx.indentLevel++;
 }
 
-void CppCodeModel::decreaseIndent()
+void CppCodeModel::decreaseIndent(Cpp::WriteContext& ctx)
 {
-    m_indentLevel--;
+    ctx.indentLevel--;
 }
 
-void CppCodeModel::resetIndent()
+void CppCodeModel::resetIndent(Cpp::WriteContext& ctx)
 {
-    m_indentLevel = 0;
-    m_minIndentLevel = 0;
+    ctx.indentLevel = 0;
+    ctx.minIndentLevel = 0;
 }
 
 bool CppCodeModel::typeCanBeInlined(const QString& name) const
@@ -3010,62 +4136,65 @@ bool CppCodeModel::typeCanBeInlined(const QString& name) const
     return false;
 }
 
-QString CppCodeModel::locationAtomToString(DwarfLocationAtom& atom)
+QString CppCodeModel::registerToString(Elf32_Word reg)
 {
-    switch (atom.op)
+    /* PowerPC (Gekko) */
+    if (reg < 32)
     {
-    case DW_OP_REG:
-    case DW_OP_BASEREG:
-        /* PowerPC (Gekko) */
-        if (atom.number < 32)
-        {
-            return QString("r%1").arg(atom.number);
-        }
-        else if (atom.number < 64)
-        {
-            return QString("f%1").arg(atom.number - 32);
-        }
-        break;
-    case DW_OP_ADDR:
-        return Util::hexToString(atom.addr);
-    case DW_OP_CONST:
-        return Util::hexToString(atom.number);
+        return QString("r%1").arg(reg);
+    }
+    else if (reg < 64)
+    {
+        return QString("f%1").arg(reg - 32);
     }
 
     return QString();
 }
 
-QString CppCodeModel::locationToString(DwarfLocation& location)
+QString CppCodeModel::locationToString(const DwarfCompiledLocation& location)
 {
-    switch (location.atoms.size())
-    {
-    case 1:
-        return locationAtomToString(location.atoms[0]);
-    case 2:
-        if (location.atoms[0].op == DW_OP_CONST
-            && location.atoms[1].op == DW_OP_ADD)
+    switch (location.kind)
+    {
+    case DwarfCompiledLocation::Register:
+        return registerToString(location.reg);
+    case DwarfCompiledLocation::Address:
+        return Util::hexToString(location.address);
+    case DwarfCompiledLocation::BaseOffset:
+        if (location.reg == DwarfCompiledLocation::ObjectBase)
+        {
+            return Util::hexToString(location.offset);
+        }
+
+        if (location.atomCount == 1)
         {
-            return locationAtomToString(location.atoms[0]);
+            return registerToString(location.reg);
         }
-    case 3:
-        if (location.atoms[0].op == DW_OP_BASEREG
-            && location.atoms[1].op == DW_OP_CONST
-            && location.atoms[2].op == DW_OP_ADD)
+
+        if (!registerToString(location.reg).isEmpty())
         {
             return QString("%1(%2)")
-                .arg(locationAtomToString(location.atoms[1]))
-                .arg(locationAtomToString(location.atoms[0]));
+                .arg(Util::hexToString(location.offset))
+                .arg(registerToString(location.reg));
         }
+
+        break;
     }
 
     return QString();
 }
 
+QStringList CppCodeModel::filePaths() const
+{
+    return m_pathToOffsetMultiMap.uniqueKeys();
+}
+
 QString CppCodeModel::dwarfEntryName(Elf32_Off offset) const
 {
-    Q_ASSERT(m_offsetToEntryMap.contains(offset));
+    DwarfEntry* entry = findEntry(offset);
 
-    return m_offsetToEntryMap[offset]->getName();
+    Q_ASSERT(entry);
+
+    return entry->getName();
 }
 
 void CppCodeModel::setupSettingsMenu(QMenu* menu)
@@ -3082,6 +4211,7 @@ void CppCodeModel::setupSettingsMenu(QMenu* menu)
             if (dialog.exec() == QDialog::Accepted)
             {
                 m_settings.fundamentalTypeNames = dialog.names();
+                clearFragmentCache();
                 saveSettings();
                 requestRewrite();
             }
@@ -3177,6 +4307,16 @@ void CppCodeModel::setupSettingsMenu(QMenu* menu)
             requestRewrite();
         });
 
+    action = menu->addAction(tr("Order types by dependency"));
+    action->setCheckable(true);
+    action->setChecked(m_settings.orderTypesByDependency);
+    connect(action, &QAction::triggered, this, [=]
+        {
+            m_settings.orderTypesByDependency = action->isChecked();
+            saveSettings();
+            requestRewrite();
+        });
+
     action = menu->addAction(tr("Sort functions by line number"));
     action->setCheckable(true);
     action->setChecked(m_settings.sortFunctionsByLineNumber);
@@ -3253,6 +4393,26 @@ void CppCodeModel::setupSettingsMenu(QMenu* menu)
             requestRewrite();
         });
 
+    action = menu->addAction(tr("Parse on demand"));
+    action->setCheckable(true);
+    action->setChecked(m_settings.lazyParsing);
+    connect(action, &QAction::triggered, this, [=]
+        {
+            m_settings.lazyParsing = action->isChecked();
+            saveSettings();
+            parseDwarf(dwarf());
+        });
+
+    action = menu->addAction(tr("Merge identical types"));
+    action->setCheckable(true);
+    action->setChecked(m_settings.mergeIdenticalTypes);
+    connect(action, &QAction::triggered, this, [=]
+        {
+            m_settings.mergeIdenticalTypes = action->isChecked();
+            saveSettings();
+            parseDwarf(dwarf());
+        });
+
     /* Comments */
     QMenu* commentsMenu = menu->addMenu(tr("Comments"));
     action = commentsMenu->addAction(tr("DWARF entry offsets"));
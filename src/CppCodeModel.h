@@ -2,9 +2,16 @@
 
 #include "AbstractCodeModel.h"
 #include "DwarfAttributes.h"
+#include "Arena.h"
+#include "Diagnostics.h"
 
 #include <qmap.h>
 #include <qhash.h>
+#include <qmutex.h>
+#include <qatomic.h>
+#include <qcache.h>
+
+#include <functional>
 
 namespace Cpp
 {
@@ -72,21 +79,21 @@ namespace Cpp
 
         bool isConst;
         bool isVolatile;
-        QList<Modifier> modifiers;
+        ArenaList<Modifier> modifiers;
     };
 
     struct Typedef
     {
         DwarfEntry* entry;
         Type type;
-        QString name;
+        QLatin1String name;
     };
 
     struct Declaration
     {
         DwarfEntry* entry;
         Type type;
-        QString name;
+        QLatin1String name;
     };
 
     struct PointerToMemberType
@@ -94,7 +101,7 @@ namespace Cpp
         DwarfEntry* entry;
         Type type;
         Type containingType;
-        QString name;
+        QLatin1String name;
     };
 
     struct ClassMember : Declaration
@@ -118,52 +125,52 @@ namespace Cpp
     {
         DwarfEntry* entry;
         Keyword keyword;
-        QString name;
+        QLatin1String name;
         int size;
-        QList<ClassMember> members;
-        QList<ClassInheritance> inheritances;
-        QList<Typedef> typedefs;
-        QList<Elf32_Off> functionOffsets;
+        ArenaList<ClassMember> members;
+        ArenaList<ClassInheritance> inheritances;
+        ArenaList<Typedef> typedefs;
+        ArenaList<Elf32_Off> functionOffsets;
     };
 
     struct EnumElement
     {
-        QString name;
+        QLatin1String name;
         int value;
     };
 
     struct EnumType
     {
         DwarfEntry* entry;
-        QString name;
-        QList<EnumElement> elements;
+        QLatin1String name;
+        ArenaList<EnumElement> elements;
     };
 
     struct ArrayType
     {
         DwarfEntry* entry;
         Type type;
-        QString name;
-        QList<int> dimensions;
+        QLatin1String name;
+        ArenaList<int> dimensions;
     };
 
     struct FunctionParameter : Declaration
     {
-        QString location;
+        QLatin1String location;
     };
 
     struct FunctionType
     {
         DwarfEntry* entry;
         Type type;
-        QString name;
-        QList<FunctionParameter> parameters;
+        QLatin1String name;
+        ArenaList<FunctionParameter> parameters;
     };
 
     struct FunctionVariable : Declaration
     {
-        QString location;
-        QString mangledName;
+        QLatin1String location;
+        QLatin1String mangledName;
     };
 
     struct LineNumber
@@ -183,25 +190,98 @@ namespace Cpp
         bool isMember;
         Elf32_Off memberTypeOffset;
         Cpp::Keyword memberAccess;
-        QString mangledName;
-        QList<FunctionVariable> variables;
-        QList<LineNumber> lineNumbers;
+        QLatin1String mangledName;
+        ArenaList<FunctionVariable> variables;
+        ArenaList<LineNumber> lineNumbers;
     };
 
     struct Variable : Declaration
     {
         bool isGlobal;
         Elf32_Addr address;
-        QString mangledName;
+        QLatin1String mangledName;
+    };
+
+    enum class EntityKind : quint8
+    {
+        None,
+        File,
+        ClassType,
+        EnumType,
+        ArrayType,
+        FunctionType,
+        PointerToMemberType,
+        Function,
+        Variable,
+        Count
     };
 
     struct File
     {
         DwarfEntry* entry;
-        QString path;
-        QList<Elf32_Off> typeOffsets;
-        QList<Elf32_Off> functionOffsets;
-        QList<Elf32_Off> variableOffsets;
+        QLatin1String path;
+        ArenaList<Elf32_Off> typeOffsets;
+        ArenaList<Elf32_Off> functionOffsets;
+        ArenaList<Elf32_Off> variableOffsets;
+    };
+
+    // A type another type refers to. Hard dependencies need the full
+    // definition first, soft ones (classes used through a pointer or
+    // reference) only a forward declaration.
+    struct TypeDependency
+    {
+        Elf32_Off offset;
+        bool isHard;
+    };
+
+    enum class FragmentKind : quint8
+    {
+        ClassType,
+        EnumType,
+        ArrayType,
+        FunctionType,
+        PointerToMemberType,
+        Variable,
+        FunctionDeclaration,
+        FunctionDefinition
+    };
+
+    // Code written for a top-level entity, along with the settings it was
+    // written with. Only the settings in usedSettings matter, so it can be
+    // reused as long as those haven't changed.
+    struct Fragment
+    {
+        quint64 usedSettings;
+        quint64 settings;
+        QString code;
+        QList<CodeToken> tokens;
+    };
+
+    // Rendered spelling of a type, reused every time the same type is
+    // written. Types that inline a class or enum depend on the indentation
+    // they're written at, so those are only marked and written directly.
+    struct TypeSpelling
+    {
+        QString prefix;
+        QList<CodeToken> prefixTokens;
+        QString postfix;
+        QList<CodeToken> postfixTokens;
+        bool isFunctionType;
+        bool isInlined;
+    };
+
+    // Everything that changes while writing, so that any number of writes
+    // can run at the same time on one model
+    struct WriteContext
+    {
+        CodeSink& code;
+        int indentLevel;
+        int minIndentLevel;
+        bool inlinedType;
+
+        // compile unit of the entry being written, merged types are written
+        // with the entries of their copies in it
+        const DwarfEntry* compileUnit;
     };
 }
 
@@ -234,6 +314,7 @@ struct CppCodeModelSettings
     bool writeLineNumbers;
     bool writeLineNumberAddresses;
     bool sortTypesAlphabetically;
+    bool orderTypesByDependency;
     bool sortFunctionsByLineNumber;
     bool treatClassesAsStructs;
     bool hideThisParameter;
@@ -242,6 +323,8 @@ struct CppCodeModelSettings
     bool inlineMetrowerksAnonymousTypes;
     bool hexadecimalEnumValues;
     bool forceExplicitEnumValues;
+    bool lazyParsing;
+    bool mergeIdenticalTypes;
     QHash<Cpp::FundamentalType, QString> fundamentalTypeNames;
 };
 
@@ -257,10 +340,12 @@ public:
     CppCodeModelSettings& settings();
     const CppCodeModelSettings& settings() const;
 
-    void writeDwarfEntry(QString& code, Elf32_Off offset) override;
-    void writeFile(QString& code, const QString& path) override;
+    void writeDwarfEntry(CodeSink& code, Elf32_Off offset) override;
+    void writeFile(CodeSink& code, const QString& path) override;
+    QStringList filePaths() const override;
     QString dwarfEntryName(Elf32_Off offset) const override;
     void setupSettingsMenu(QMenu* menu) override;
+    MemoryUsage memoryUsage() const override;
 
 protected:
     void parseDwarf(Dwarf* dwarf) override;
@@ -271,25 +356,54 @@ private:
 
     CppCodeModelSettings m_settings;
     QMultiMap<QString, Elf32_Off> m_pathToOffsetMultiMap;
-    QHash<Elf32_Off, DwarfEntry*> m_offsetToEntryMap;
-    QHash<Elf32_Off, DwarfSourceStatementTable*> m_offsetToSourceStatementTableMap;
-    QHash<Elf32_Off, Cpp::File> m_offsetToFileMap;
-    QHash<Elf32_Off, Cpp::ClassType> m_offsetToClassTypeMap;
-    QHash<Elf32_Off, Cpp::EnumType> m_offsetToEnumTypeMap;
-    QHash<Elf32_Off, Cpp::ArrayType> m_offsetToArrayTypeMap;
-    QHash<Elf32_Off, Cpp::FunctionType> m_offsetToFunctionTypeMap;
-    QHash<Elf32_Off, Cpp::PointerToMemberType> m_offsetToPointerToMemberTypeMap;
-    QHash<Elf32_Off, Cpp::Function> m_offsetToFunctionMap;
-    QHash<Elf32_Off, Cpp::Variable> m_offsetToVariableMap;
-    int m_indentLevel;
-    int m_minIndentLevel;
-    bool m_firstSourceStatementTableParsed;
+
+    // indexed by entry index, gives the kind and slot of the entity parsed
+    // from that entry (if any) in the matching dense list below
+    QList<Cpp::EntityKind> m_entityKinds;
+    QList<int> m_entitySlots;
+
+    QList<Cpp::File> m_files;
+    QList<Cpp::ClassType> m_classTypes;
+    QList<Cpp::EnumType> m_enumTypes;
+    QList<Cpp::ArrayType> m_arrayTypes;
+    QList<Cpp::FunctionType> m_functionTypes;
+    QList<Cpp::PointerToMemberType> m_pointerToMemberTypes;
+    QList<Cpp::Function> m_functions;
+    QList<Cpp::Variable> m_variables;
+    QList<Arena*> m_arenas;
+    QList<DwarfEntry*> m_compileUnits;
+    QList<QAtomicInt> m_compileUnitsParsed;
+    QMutex m_lazyParseMutex;
+    QHash<quint64, Elf32_Off> m_mergedTypeCopies;
+    QHash<Elf32_Off, QList<Elf32_Off>> m_mergedTypeFunctionOffsets;
+    QCache<quint64, Cpp::Fragment> m_fragmentCache;
+    mutable QMutex m_fragmentCacheMutex;
+    QAtomicInteger<quint64> m_typeSpellingGeneration;
+    DwarfEntry* m_firstSourceStatementTableOwner;
 
     void loadSettings();
     void saveSettings();
 
     void clear();
 
+    void assignEntitySlots();
+    int entitySlot(const DwarfEntry* entry, Cpp::EntityKind kind) const;
+    int entitySlot(Elf32_Off offset, Cpp::EntityKind kind) const;
+    int resolveSlot(Elf32_Off offset, Cpp::EntityKind kind);
+    bool isMergedType(DwarfEntry* entry) const;
+    Elf32_Off localTypeOffset(const DwarfEntry* compileUnit, Elf32_Off offset) const;
+    int compileUnitIndex(const DwarfEntry* entry) const;
+    void ensureParsed(const DwarfEntry* entry);
+    DwarfEntry* findEntry(Elf32_Off offset) const;
+    Cpp::File* findFile(Elf32_Off offset);
+    Cpp::ClassType* findClassType(Elf32_Off offset);
+    Cpp::EnumType* findEnumType(Elf32_Off offset);
+    Cpp::ArrayType* findArrayType(Elf32_Off offset);
+    Cpp::FunctionType* findFunctionType(Elf32_Off offset);
+    Cpp::PointerToMemberType* findPointerToMemberType(Elf32_Off offset);
+    Cpp::Function* findFunction(Elf32_Off offset);
+    Cpp::Variable* findVariable(Elf32_Off offset);
+
     void parseCompileUnit(DwarfEntry* entry);
     void parseClassType(DwarfEntry* entry, Cpp::File& file);
     void parseMember(DwarfEntry* entry, Cpp::ClassType& c);
@@ -305,59 +419,74 @@ private:
     void parsePointerToMemberType(DwarfEntry* entry, Cpp::File& file);
     void parseVariable(DwarfEntry* entry, Cpp::File& f);
     void parseTypedef(DwarfEntry* entry, Cpp::Typedef& t);
-    void parseType(DwarfType& dt, Cpp::Type& t);
+    void parseType(const DwarfType& dt, Cpp::Type& t);
     void parseSourceStatementTable(DwarfSourceStatementTable* table, Cpp::File& file);
 
+    void addDiagnostic(const Diagnostic& diagnostic);
     void warnUnknownEntry(DwarfEntry* child, DwarfEntry* parent);
     void warnUnknownAttribute(DwarfAttribute* attribute, DwarfEntry* entry);
     void warnUnknownLineNumberFunction(DwarfSourceStatementEntry* entry, Cpp::File& file);
     void warnUnknownLocationConfiguration(DwarfAttribute* attribute, DwarfEntry* entry);
 
-    void writeFiles(QString& code, const QList<Elf32_Off>& fileOffsets);
-    void writeClassType(QString& code, Cpp::ClassType& c, bool isInline = false);
-    void writeClassMember(QString& code, Cpp::ClassMember& m);
-    void writeEnumType(QString& code, Cpp::EnumType& e, bool isInline = false);
-    void writeEnumElement(QString& code, Cpp::EnumElement& e, bool explicitValue);
-    void writeArrayType(QString& code, Cpp::ArrayType& a, bool isInline = false);
-    void writeFunctionType(QString& code, Cpp::FunctionType& f, bool isInline = false);
-    void writePointerToMemberType(QString& code, Cpp::PointerToMemberType& p, bool isInline = false);
-    void writeVariable(QString& code, Cpp::Variable& v);
-    void writeFunctionDeclaration(QString& code, Cpp::Function& f, bool isInsideClass = false);
-    void writeFunctionDefinition(QString& code, Cpp::Function& f);
-    void writeDisassemblyLineComment(QString& code, const QString& leftText, const QString& rightText, int leftSize, int rightSize);
-    void writeLineNumberComment(QString& code, Cpp::LineNumber& l);
-    void writeFunctionSignature(QString& code, Cpp::Function& f, bool isDeclaration, bool isInsideClass);
-    void writeFunctionVariable(QString& code, Cpp::FunctionVariable& v);
-    void writeDeclaration(QString& code, Cpp::Declaration& d);
-    void writeTypedef(QString& code, Cpp::Typedef& t);
-    void writeTypePrefix(QString& code, Cpp::Type& t, bool* outIsFunctionType = nullptr);
-    void writeTypePostfix(QString& code, Cpp::Type& t);
-    void writeClassTypePrefix(QString& code, Cpp::ClassType& c);
-    void writeClassTypePostfix(QString& code, Cpp::ClassType& c);
-    void writeEnumTypePrefix(QString& code, Cpp::EnumType& e);
-    void writeEnumTypePostfix(QString& code, Cpp::EnumType& e);
-    void writeArrayTypePrefix(QString& code, Cpp::ArrayType& a);
-    void writeArrayTypePostfix(QString& code, Cpp::ArrayType& a);
-    void writeFunctionTypePrefix(QString& code, Cpp::FunctionType& f);
-    void writeFunctionTypePostfix(QString& code, Cpp::FunctionType& f);
-    void writeFunctionParameters(QString& code, Cpp::FunctionType& f, bool isDeclaration);
-    void writeFunctionParameter(QString& code, Cpp::FunctionParameter& p, bool isDeclaration);
-    void writePointerToMemberTypePrefix(QString& code, Cpp::PointerToMemberType& p);
-    void writePointerToMemberTypePostfix(QString& code, Cpp::PointerToMemberType& p);
-    void writeFundamentalType(QString& code, Cpp::FundamentalType t);
-    void writeModifier(QString& code, Cpp::Modifier& m);
-    void writeConstVolatile(QString& code, bool isConst, bool isVolatile);
-    void writeKeyword(QString& code, Cpp::Keyword keyword);
-    void writeComment(QString& code, const QString& text);
-    void writeMultilineComment(QString& code, const QString& text);
-    void writeNewline(QString& code, bool indent = true);
-
-    void increaseIndent();
-    void decreaseIndent();
-    void resetIndent();
+    quint64 fragmentSettings() const;
+    void clearFragmentCache();
+    void writeFragment(Cpp::WriteContext& ctx, Cpp::FragmentKind kind, Elf32_Off offset, const std::function<void(Cpp::WriteContext&)>& write);
+
+    void writeDwarfEntry(Cpp::WriteContext& ctx, Elf32_Off offset);
+    void writeFile(Cpp::WriteContext& ctx, const QString& path);
+    void writeFiles(Cpp::WriteContext& ctx, const QList<Elf32_Off>& fileOffsets);
+    void collectTypeDependencies(Cpp::Type& t, bool isIndirect, QList<Cpp::TypeDependency>& dependencies, int depth = 0);
+    void collectClassDependencies(Cpp::ClassType& c, QList<Cpp::TypeDependency>& dependencies, int depth = 0);
+    void collectEntryDependencies(DwarfEntry* entry, QList<Cpp::TypeDependency>& dependencies, int depth = 0);
+    QList<DwarfEntry*> orderTypesByDependency(const QList<DwarfEntry*>& entries, QList<Cpp::ClassType*>& outForwardDeclarations);
+    void writeForwardDeclaration(Cpp::WriteContext& ctx, Cpp::ClassType& c);
+    void writeClassType(Cpp::WriteContext& ctx, Cpp::ClassType& c, bool isInline = false);
+    void writeClassMember(Cpp::WriteContext& ctx, Cpp::ClassMember& m);
+    void writeEnumType(Cpp::WriteContext& ctx, Cpp::EnumType& e, bool isInline = false);
+    void writeEnumElement(Cpp::WriteContext& ctx, Cpp::EnumElement& e, bool explicitValue);
+    void writeArrayType(Cpp::WriteContext& ctx, Cpp::ArrayType& a, bool isInline = false);
+    void writeFunctionType(Cpp::WriteContext& ctx, Cpp::FunctionType& f, bool isInline = false);
+    void writePointerToMemberType(Cpp::WriteContext& ctx, Cpp::PointerToMemberType& p, bool isInline = false);
+    void writeVariable(Cpp::WriteContext& ctx, Cpp::Variable& v);
+    void writeFunctionDeclaration(Cpp::WriteContext& ctx, Cpp::Function& f, bool isInsideClass = false);
+    void writeFunctionDefinition(Cpp::WriteContext& ctx, Cpp::Function& f);
+    void writeDisassemblyLineComment(Cpp::WriteContext& ctx, const QString& leftText, const QString& rightText, int leftSize, int rightSize);
+    void writeLineNumberComment(Cpp::WriteContext& ctx, Cpp::LineNumber& l);
+    void writeFunctionSignature(Cpp::WriteContext& ctx, Cpp::Function& f, bool isDeclaration, bool isInsideClass);
+    void writeFunctionVariable(Cpp::WriteContext& ctx, Cpp::FunctionVariable& v);
+    void writeDeclaration(Cpp::WriteContext& ctx, Cpp::Declaration& d);
+    void writeTypedef(Cpp::WriteContext& ctx, Cpp::Typedef& t);
+    const Cpp::TypeSpelling* typeSpelling(Cpp::WriteContext& ctx, Cpp::Type& t);
+    void writeTypePrefix(Cpp::WriteContext& ctx, Cpp::Type& t, bool* outIsFunctionType = nullptr);
+    void writeTypePostfix(Cpp::WriteContext& ctx, Cpp::Type& t);
+    void renderTypePrefix(Cpp::WriteContext& ctx, Cpp::Type& t, bool* outIsFunctionType = nullptr);
+    void renderTypePostfix(Cpp::WriteContext& ctx, Cpp::Type& t);
+    void writeClassTypePrefix(Cpp::WriteContext& ctx, Cpp::ClassType& c);
+    void writeClassTypePostfix(Cpp::WriteContext& ctx, Cpp::ClassType& c);
+    void writeEnumTypePrefix(Cpp::WriteContext& ctx, Cpp::EnumType& e);
+    void writeEnumTypePostfix(Cpp::WriteContext& ctx, Cpp::EnumType& e);
+    void writeArrayTypePrefix(Cpp::WriteContext& ctx, Cpp::ArrayType& a);
+    void writeArrayTypePostfix(Cpp::WriteContext& ctx, Cpp::ArrayType& a);
+    void writeFunctionTypePrefix(Cpp::WriteContext& ctx, Cpp::FunctionType& f);
+    void writeFunctionTypePostfix(Cpp::WriteContext& ctx, Cpp::FunctionType& f);
+    void writeFunctionParameters(Cpp::WriteContext& ctx, Cpp::FunctionType& f, bool isDeclaration);
+    void writeFunctionParameter(Cpp::WriteContext& ctx, Cpp::FunctionParameter& p, bool isDeclaration);
+    void writePointerToMemberTypePrefix(Cpp::WriteContext& ctx, Cpp::PointerToMemberType& p);
+    void writePointerToMemberTypePostfix(Cpp::WriteContext& ctx, Cpp::PointerToMemberType& p);
+    void writeFundamentalType(Cpp::WriteContext& ctx, Cpp::FundamentalType t);
+    void writeModifier(Cpp::WriteContext& ctx, Cpp::Modifier& m);
+    void writeConstVolatile(Cpp::WriteContext& ctx, bool isConst, bool isVolatile);
+    void writeKeyword(Cpp::WriteContext& ctx, Cpp::Keyword keyword);
+    void writeComment(Cpp::WriteContext& ctx, const QString& text);
+    void writeMultilineComment(Cpp::WriteContext& ctx, const QString& text);
+    void writeNewline(Cpp::WriteContext& ctx, bool indent = true);
+
+    void increaseIndent(Cpp::WriteContext& ctx);
+    void decreaseIndent(Cpp::WriteContext& ctx);
+    void resetIndent(Cpp::WriteContext& ctx);
 
     bool typeCanBeInlined(const QString& name) const;
 
-    QString locationAtomToString(DwarfLocationAtom& atom);
-    QString locationToString(DwarfLocation& location);
+    QString registerToString(Elf32_Word reg);
+    QString locationToString(const DwarfCompiledLocation& location);
 };
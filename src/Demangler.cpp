@@ -0,0 +1,760 @@
+#include "Demangler.h"
+
+#include "Util.h"
+
+#include <qhash.h>
+#include <qmap.h>
+#include <qmutex.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define DEMANGLER_SHARD_COUNT 16
+#define MAX_DEMANGLE_DEPTH 32
+#define MAX_DEMANGLE_NUMBER 100000000
+
+struct DemanglerShard
+{
+    QMutex mutex;
+    QHash<QString, DemangledName> names;
+};
+
+static DemanglerShard s_shards[DEMANGLER_SHARD_COUNT];
+
+static const QMap<QString, QString> operatorDemangleMap =
+{
+    { "__as", "operator=" },
+    { "__nw", "operator new" },
+    { "__dl", "operator delete" },
+    { "__nwa", "operator new[]" },
+    { "__dla", "operator delete[]" },
+    { "__pl", "operator+" },
+    { "__mi", "operator-" },
+    { "__ml", "operator*" },
+    { "__dv", "operator/" },
+    { "__md", "operator%" },
+    { "__er", "operator^" },
+    { "__ad", "operator&" },
+    { "__or", "operator|" },
+    { "__co", "operator~" },
+    { "__nt", "operator!" },
+    { "__lt", "operator<" },
+    { "__gt", "operator>" },
+    { "__apl", "operator+=" },
+    { "__ami", "operator-=" },
+    { "__amu", "operator*=" },
+    { "__adv", "operator/=" },
+    { "__amd", "operator%=" },
+    { "__aer", "operator^=" },
+    { "__aad", "operator&=" },
+    { "__aor", "operator|=" },
+    { "__ls", "operator<<" },
+    { "__rs", "operator>>" },
+    { "__als", "operator<<=" },
+    { "__ars", "operator>>=" },
+    { "__eq", "operator==" },
+    { "__ne", "operator!=" },
+    { "__le", "operator<=" },
+    { "__ge", "operator>=" },
+    { "__aa", "operator&&" },
+    { "__oo", "operator||" },
+    { "__pp", "operator++" },
+    { "__mm", "operator--" },
+    { "__cm", "operator," },
+    { "__rm", "operator->*" },
+    { "__rf", "operator->" },
+    { "__cl", "operator()" },
+    { "__vc", "operator[]" },
+};
+
+static bool parseType(const char*& p, const char* end, QString& outPrefix, QString& outPostfix, int depth);
+
+static bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool parseNumber(const char*& p, const char* end, int& outNumber)
+{
+    if (p == end || !isDigit(*p))
+    {
+        return false;
+    }
+
+    int number = 0;
+
+    while (p < end && isDigit(*p))
+    {
+        number = number * 10 + (*p - '0');
+
+        if (number > MAX_DEMANGLE_NUMBER)
+        {
+            return false;
+        }
+
+        p++;
+    }
+
+    outNumber = number;
+    return true;
+}
+
+// Name with optional template arguments, like Vector<f,3>. Arguments are
+// either mangled types or literal values.
+static bool parseTemplateName(const char* begin, const char* end, QString& outName, int depth)
+{
+    const char* open = std::find(begin, end, '<');
+
+    if (open == end)
+    {
+        outName = QString::fromLatin1(begin, end - begin);
+        return true;
+    }
+
+    if (open == begin || end[-1] != '>' || depth >= MAX_DEMANGLE_DEPTH)
+    {
+        return false;
+    }
+
+    QString name = QString::fromLatin1(begin, open - begin);
+    const char* p = open + 1;
+    const char* argumentsEnd = end - 1;
+    bool isFirst = true;
+
+    name += "<";
+
+    while (p < argumentsEnd)
+    {
+        const char* argumentEnd = p;
+        int nesting = 0;
+
+        while (argumentEnd < argumentsEnd && (nesting > 0 || *argumentEnd != ','))
+        {
+            if (*argumentEnd == '<')
+            {
+                nesting++;
+            }
+            else if (*argumentEnd == '>')
+            {
+                nesting--;
+            }
+
+            argumentEnd++;
+        }
+
+        if (!isFirst)
+        {
+            name += ", ";
+        }
+
+        isFirst = false;
+
+        const char* q = p;
+        QString prefix;
+        QString postfix;
+
+        if (parseType(q, argumentEnd, prefix, postfix, depth + 1) && q == argumentEnd)
+        {
+            name += prefix + postfix;
+        }
+        else
+        {
+            name += QLatin1String(p, argumentEnd - p);
+        }
+
+        p = (argumentEnd < argumentsEnd) ? argumentEnd + 1 : argumentEnd;
+    }
+
+    // keep nested template arguments from turning into >>
+    if (name.endsWith('>'))
+    {
+        name += " ";
+    }
+
+    name += ">";
+
+    outName = name;
+    return true;
+}
+
+static bool parseClassName(const char*& p, const char* end, QString& outName, int depth)
+{
+    int length = 0;
+
+    if (!parseNumber(p, end, length) || length == 0 || length > end - p)
+    {
+        return false;
+    }
+
+    if (!parseTemplateName(p, p + length, outName, depth))
+    {
+        return false;
+    }
+
+    p += length;
+    return true;
+}
+
+// Either a single class name or Q<count> followed by that many names
+static bool parseQualifiedName(const char*& p, const char* end, QString& outName, QString& outLastName, int depth)
+{
+    if (p < end && *p == 'Q')
+    {
+        p++;
+
+        if (p == end || *p < '1' || *p > '9')
+        {
+            return false;
+        }
+
+        int count = *p++ - '0';
+        QStringList names;
+
+        for (int i = 0; i < count; i++)
+        {
+            QString name;
+
+            if (!parseClassName(p, end, name, depth))
+            {
+                return false;
+            }
+
+            names.append(name);
+        }
+
+        outName = names.join("::");
+        outLastName = names.last();
+        return true;
+    }
+
+    if (!parseClassName(p, end, outLastName, depth))
+    {
+        return false;
+    }
+
+    outName = outLastName;
+    return true;
+}
+
+static bool parseParameters(const char*& p, const char* end, QString& outParameters, int depth)
+{
+    QStringList parameters;
+
+    while (p < end && *p != '_')
+    {
+        QString prefix;
+        QString postfix;
+
+        if (!parseType(p, end, prefix, postfix, depth))
+        {
+            return false;
+        }
+
+        parameters.append(prefix + postfix);
+    }
+
+    // a lone void just means there are no parameters
+    if (parameters.size() == 1 && parameters[0] == "void")
+    {
+        parameters.clear();
+    }
+
+    outParameters = parameters.join(", ");
+    return true;
+}
+
+// Types are split in a prefix and postfix around where a declarator name
+// would go, so that pointers to arrays and functions come out right
+static bool parseType(const char*& p, const char* end, QString& outPrefix, QString& outPostfix, int depth)
+{
+    if (depth >= MAX_DEMANGLE_DEPTH)
+    {
+        return false;
+    }
+
+    QString qualifiers;
+    QString modifiers;
+
+    // the first modifier is the outermost one, so each one goes in front of
+    // the ones before it. Qualifiers read before a modifier belong to it.
+    while (p < end)
+    {
+        char c = *p;
+
+        if (c == 'P' || c == 'R')
+        {
+            QString modifier = (c == 'P') ? "*" : "&";
+
+            if (!qualifiers.isEmpty())
+            {
+                modifier += " " + qualifiers.trimmed();
+                qualifiers.clear();
+            }
+
+            modifiers.prepend(modifier);
+        }
+        else if (c == 'C')
+        {
+            qualifiers += "const ";
+        }
+        else if (c == 'V')
+        {
+            qualifiers += "volatile ";
+        }
+        else if (c == 'U')
+        {
+            qualifiers += "unsigned ";
+        }
+        else if (c == 'S')
+        {
+            qualifiers += "signed ";
+        }
+        else
+        {
+            break;
+        }
+
+        p++;
+    }
+
+    if (p == end)
+    {
+        return false;
+    }
+
+    if (*p == 'Q' || isDigit(*p))
+    {
+        QString name;
+        QString lastName;
+
+        if (!parseQualifiedName(p, end, name, lastName, depth + 1))
+        {
+            return false;
+        }
+
+        outPrefix = qualifiers + name + modifiers;
+        outPostfix.clear();
+        return true;
+    }
+
+    if (*p == 'M' || *p == 'F')
+    {
+        QString memberScope;
+        bool isConstMember = false;
+
+        if (*p == 'M')
+        {
+            QString lastName;
+
+            p++;
+
+            if (!parseQualifiedName(p, end, memberScope, lastName, depth + 1))
+            {
+                return false;
+            }
+
+            if (p == end || *p != 'F')
+            {
+                // pointer to data member
+                QString prefix;
+                QString postfix;
+
+                if (!parseType(p, end, prefix, postfix, depth + 1))
+                {
+                    return false;
+                }
+
+                outPrefix = prefix + " " + memberScope + "::*" + modifiers;
+                outPostfix = postfix;
+                return true;
+            }
+        }
+
+        p++;
+
+        // member functions take a hidden this pointer first, whose
+        // qualifiers are those of the member function
+        if (!memberScope.isEmpty())
+        {
+            static const char* thisParameters[] = { "PCVv", "PCv", "PVv", "Pv" };
+
+            for (const char* thisParameter : thisParameters)
+            {
+                int length = (int)strlen(thisParameter);
+
+                if (end - p >= length && memcmp(p, thisParameter, length) == 0)
+                {
+                    isConstMember = (thisParameter[1] == 'C');
+                    p += length;
+                    break;
+                }
+            }
+        }
+
+        QString parameters;
+        QString returnPrefix;
+        QString returnPostfix;
+
+        if (!parseParameters(p, end, parameters, depth + 1) || p == end || *p != '_')
+        {
+            return false;
+        }
+
+        p++;
+
+        if (!parseType(p, end, returnPrefix, returnPostfix, depth + 1))
+        {
+            return false;
+        }
+
+        QString declarator = memberScope.isEmpty() ? modifiers : memberScope + "::*" + modifiers;
+
+        outPrefix = returnPrefix + " (" + declarator;
+        outPostfix = ")(" + parameters + ")" + (isConstMember ? " const" : "") + returnPostfix;
+        return true;
+    }
+
+    if (*p == 'A')
+    {
+        int count = 0;
+        QString elementPrefix;
+        QString elementPostfix;
+
+        p++;
+
+        if (!parseNumber(p, end, count) || p == end || *p != '_')
+        {
+            return false;
+        }
+
+        p++;
+
+        if (!parseType(p, end, elementPrefix, elementPostfix, depth + 1))
+        {
+            return false;
+        }
+
+        QString dimension = QString("[%1]").arg(count);
+
+        if (modifiers.isEmpty())
+        {
+            outPrefix = qualifiers + elementPrefix;
+            outPostfix = dimension + elementPostfix;
+        }
+        else
+        {
+            outPrefix = elementPrefix + " (" + modifiers;
+            outPostfix = ")" + dimension + elementPostfix;
+        }
+
+        return true;
+    }
+
+    const char* fundamentalType = nullptr;
+
+    switch (*p)
+    {
+    case 'v': fundamentalType = "void"; break;
+    case 'b': fundamentalType = "bool"; break;
+    case 'c': fundamentalType = "char"; break;
+    case 'w': fundamentalType = "wchar_t"; break;
+    case 's': fundamentalType = "short"; break;
+    case 'i': fundamentalType = "int"; break;
+    case 'l': fundamentalType = "long"; break;
+    case 'x': fundamentalType = "long long"; break;
+    case 'f': fundamentalType = "float"; break;
+    case 'd': fundamentalType = "double"; break;
+    case 'r': fundamentalType = "long double"; break;
+    case 'e': fundamentalType = "..."; break;
+    default:
+        return false;
+    }
+
+    p++;
+
+    outPrefix = qualifiers + fundamentalType + modifiers;
+    outPostfix.clear();
+    return true;
+}
+
+// Everything after the double underscore that ends the name: an optional
+// class, then an optional function signature
+static bool parseSignature(const char* nameBegin, const char* nameEnd, const char* p, const char* end, bool isSpecial, DemangledName& outName)
+{
+    DemangledName n;
+    QString className;
+
+    if (p < end && (*p == 'Q' || isDigit(*p)))
+    {
+        if (!parseQualifiedName(p, end, n.scope, className, 0))
+        {
+            return false;
+        }
+    }
+
+    if (p < end && *p == 'C')
+    {
+        n.isConst = true;
+        p++;
+
+        if (p == end || *p != 'F')
+        {
+            return false;
+        }
+    }
+
+    if (p < end && *p == 'F')
+    {
+        p++;
+        n.isFunction = true;
+
+        if (!parseParameters(p, end, n.parameters, 0))
+        {
+            return false;
+        }
+
+        // template functions have their return type mangled in as well
+        if (p < end && *p == '_')
+        {
+            QString prefix;
+            QString postfix;
+
+            p++;
+
+            if (!parseType(p, end, prefix, postfix, 0))
+            {
+                return false;
+            }
+
+            n.returnType = prefix + postfix;
+        }
+    }
+
+    if (p != end || (n.scope.isEmpty() && !n.isFunction))
+    {
+        return false;
+    }
+
+    if (isSpecial)
+    {
+        QLatin1String special(nameBegin, nameEnd - nameBegin);
+
+        if (special == QLatin1String("ct") || special == QLatin1String("dt"))
+        {
+            if (className.isEmpty())
+            {
+                return false;
+            }
+
+            QString baseName = className.left(className.indexOf('<'));
+
+            n.name = (special == QLatin1String("dt")) ? "~" + baseName : baseName;
+        }
+        else if (special.startsWith(QLatin1String("op")))
+        {
+            const char* q = nameBegin + 2;
+            QString prefix;
+            QString postfix;
+
+            if (!parseType(q, nameEnd, prefix, postfix, 0) || q != nameEnd)
+            {
+                return false;
+            }
+
+            n.name = "operator " + prefix + postfix;
+        }
+        else
+        {
+            QString specialName = "__" + special;
+            QString operatorName = Demangler::operatorName(specialName);
+
+            n.name = operatorName.isEmpty() ? specialName : operatorName;
+        }
+    }
+    else if (!parseTemplateName(nameBegin, nameEnd, n.name, 0))
+    {
+        return false;
+    }
+
+    n.isValid = true;
+    outName = n;
+    return true;
+}
+
+DemangledName::DemangledName()
+    : isValid(false)
+    , isFunction(false)
+    , isConst(false)
+    , scope()
+    , name()
+    , parameters()
+    , returnType()
+{
+}
+
+QString DemangledName::qualifiedName() const
+{
+    if (scope.isEmpty())
+    {
+        return name;
+    }
+
+    return scope + "::" + name;
+}
+
+QString DemangledName::toString() const
+{
+    QString string;
+
+    if (!returnType.isEmpty())
+    {
+        string += returnType + " ";
+    }
+
+    string += qualifiedName();
+
+    if (isFunction)
+    {
+        string += "(" + parameters + ")";
+
+        if (isConst)
+        {
+            string += " const";
+        }
+    }
+
+    return string;
+}
+
+DemangledName Demangler::demangle(const QString& mangledName)
+{
+    DemanglerShard& shard = s_shards[qHash(mangledName) % DEMANGLER_SHARD_COUNT];
+
+    {
+        QMutexLocker locker(&shard.mutex);
+
+        auto it = shard.names.constFind(mangledName);
+
+        if (it != shard.names.constEnd())
+        {
+            return *it;
+        }
+    }
+
+    // parsed outside the lock; if two threads race on the same name they
+    // both get the same result anyway
+    DemangledName name = parse(mangledName);
+
+    QMutexLocker locker(&shard.mutex);
+    shard.names.insert(mangledName, name);
+
+    return name;
+}
+
+QString Demangler::demangleToString(const QString& mangledName)
+{
+    DemangledName name = demangle(mangledName);
+
+    return name.isValid ? name.toString() : mangledName;
+}
+
+QStringList Demangler::demangleAll(const QStringList& mangledNames)
+{
+    QStringList names = mangledNames;
+
+    // detached here, each task only touches its own name
+    QString* data = names.data();
+
+    Util::parallelFor(names.size(), [=](int i)
+        {
+            if (!data[i].isEmpty())
+            {
+                data[i] = demangleToString(data[i]);
+            }
+        });
+
+    return names;
+}
+
+QString Demangler::operatorName(const QString& specialName)
+{
+    return operatorDemangleMap.value(specialName);
+}
+
+void Demangler::clear()
+{
+    for (DemanglerShard& shard : s_shards)
+    {
+        QMutexLocker locker(&shard.mutex);
+        shard.names.clear();
+    }
+}
+
+MemoryUsage Demangler::memoryUsage()
+{
+    qint64 cacheBytes = 0;
+    Memory::StringCounter strings;
+
+    for (DemanglerShard& shard : s_shards)
+    {
+        QMutexLocker locker(&shard.mutex);
+
+        cacheBytes += Memory::hashBytes(shard.names);
+
+        for (auto it = shard.names.constBegin(); it != shard.names.constEnd(); ++it)
+        {
+            strings.add(it.key());
+            strings.add(it->scope);
+            strings.add(it->name);
+            strings.add(it->parameters);
+            strings.add(it->returnType);
+        }
+    }
+
+    MemoryUsage usage("Demangler");
+    usage.add("Cache", cacheBytes);
+    usage.add("Strings", strings.bytes());
+    return usage;
+}
+
+DemangledName Demangler::parse(const QString& mangledName)
+{
+    QByteArray text = mangledName.toLatin1();
+    const char* begin = text.constData();
+    const char* end = begin + text.size();
+    bool isSpecial = false;
+
+    // constructors, destructors, operators and the like start with __
+    if (end - begin > 2 && begin[0] == '_' && begin[1] == '_')
+    {
+        isSpecial = true;
+        begin += 2;
+    }
+
+    // the name ends at a double underscore, but names can contain double
+    // underscores themselves, so every one is tried until the rest parses
+    for (const char* split = begin + 1; split + 2 <= end; split++)
+    {
+        if (split[0] != '_' || split[1] != '_')
+        {
+            continue;
+        }
+
+        // extra underscores belong to the name
+        const char* nameEnd = split;
+
+        while (nameEnd + 2 < end && nameEnd[2] == '_')
+        {
+            nameEnd++;
+        }
+
+        DemangledName name;
+
+        if (parseSignature(begin, nameEnd, nameEnd + 2, end, isSpecial, name))
+        {
+            return name;
+        }
+    }
+
+    return DemangledName();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <qstring.h>
+#include <qstringlist.h>
+
+#include "MemoryUsage.h"
+
+// Parts of a demangled Metrowerks/CodeWarrior name. Only names that are
+// actually mangled are valid, parameters and returnType are only set for
+// functions (returnType only when it's part of the mangled name, which is
+// the case for template functions).
+struct DemangledName
+{
+    bool isValid;
+    bool isFunction;
+    bool isConst;
+    QString scope;
+    QString name;
+    QString parameters;
+    QString returnType;
+
+    DemangledName();
+
+    QString qualifiedName() const;
+    QString toString() const;
+};
+
+// Demangler for names generated by the Metrowerks/CodeWarrior compiler.
+// Results are memoized in a cache split into shards, so any number of
+// threads can demangle at the same time without waiting on each other.
+class Demangler
+{
+public:
+    static DemangledName demangle(const QString& mangledName);
+
+    // Full demangled name, or mangledName itself if it isn't mangled
+    static QString demangleToString(const QString& mangledName);
+
+    // demangleToString for every name, run on the global thread pool. Empty
+    // names stay empty.
+    static QStringList demangleAll(const QStringList& mangledNames);
+
+    // Name of the operator for special names like __as, or an empty string
+    static QString operatorName(const QString& specialName);
+
+    static void clear();
+    static MemoryUsage memoryUsage();
+
+private:
+    static DemangledName parse(const QString& mangledName);
+};
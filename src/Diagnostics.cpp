@@ -0,0 +1,148 @@
+#include "Diagnostics.h"
+
+#include "Util.h"
+
+#include <qcoreapplication.h>
+
+QMutex Diagnostics::s_mutex;
+QList<Diagnostic> Diagnostics::s_diagnostics;
+int Diagnostics::s_counts[(int)DiagnosticKind::Count] = {};
+int Diagnostics::s_generation = 0;
+Diagnostics::ChangedCallback Diagnostics::s_changedCallback = nullptr;
+
+QString Diagnostic::message() const
+{
+    switch (kind)
+    {
+    case DiagnosticKind::UnknownEntry:
+        return QCoreApplication::translate("Diagnostics", "Unknown child entry %1 (%2) at offset %3 in parent entry %4 (%5)")
+            .arg(Dwarf::tagToString(code))
+            .arg(name)
+            .arg(Util::hexToString(offset))
+            .arg(ownerTag ? Dwarf::tagToString(ownerTag) : QCoreApplication::translate("Diagnostics", "(root)"))
+            .arg(ownerName);
+    case DiagnosticKind::UnknownAttribute:
+        return QCoreApplication::translate("Diagnostics", "Unknown attribute %1 at offset %2 in entry %3 (%4)")
+            .arg(Dwarf::attrNameToString(code))
+            .arg(Util::hexToString(offset))
+            .arg(Dwarf::tagToString(ownerTag))
+            .arg(ownerName);
+    case DiagnosticKind::UnknownLineNumberFunction:
+        return QCoreApplication::translate("Diagnostics", "Line number address %1 is not in any function in file %2")
+            .arg(Util::hexToString(offset))
+            .arg(name);
+    case DiagnosticKind::UnknownLocationConfiguration:
+        return QCoreApplication::translate("Diagnostics", "Unknown location configuration at offset %1 in entry %2 (%3)")
+            .arg(Util::hexToString(offset))
+            .arg(Dwarf::tagToString(ownerTag))
+            .arg(ownerName);
+    }
+
+    return QString();
+}
+
+void Diagnostics::add(const Diagnostic& diagnostic)
+{
+    {
+        QMutexLocker locker(&s_mutex);
+
+        s_diagnostics.append(diagnostic);
+        s_counts[(int)diagnostic.kind]++;
+    }
+
+    changed();
+}
+
+void Diagnostics::add(const QList<Diagnostic>& diagnostics)
+{
+    if (diagnostics.isEmpty())
+    {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&s_mutex);
+
+        s_diagnostics.append(diagnostics);
+
+        for (const Diagnostic& diagnostic : diagnostics)
+        {
+            s_counts[(int)diagnostic.kind]++;
+        }
+    }
+
+    changed();
+}
+
+void Diagnostics::clear()
+{
+    {
+        QMutexLocker locker(&s_mutex);
+
+        s_diagnostics.clear();
+
+        for (int& count : s_counts)
+        {
+            count = 0;
+        }
+
+        s_generation++;
+    }
+
+    changed();
+}
+
+int Diagnostics::count()
+{
+    QMutexLocker locker(&s_mutex);
+    return s_diagnostics.size();
+}
+
+int Diagnostics::count(DiagnosticKind kind)
+{
+    QMutexLocker locker(&s_mutex);
+    return s_counts[(int)kind];
+}
+
+int Diagnostics::generation()
+{
+    QMutexLocker locker(&s_mutex);
+    return s_generation;
+}
+
+Diagnostic Diagnostics::at(int index)
+{
+    QMutexLocker locker(&s_mutex);
+    return s_diagnostics[index];
+}
+
+QString Diagnostics::kindToString(DiagnosticKind kind)
+{
+    switch (kind)
+    {
+    case DiagnosticKind::UnknownEntry: return QCoreApplication::translate("Diagnostics", "Unknown entry");
+    case DiagnosticKind::UnknownAttribute: return QCoreApplication::translate("Diagnostics", "Unknown attribute");
+    case DiagnosticKind::UnknownLineNumberFunction: return QCoreApplication::translate("Diagnostics", "Unknown line number function");
+    case DiagnosticKind::UnknownLocationConfiguration: return QCoreApplication::translate("Diagnostics", "Unknown location configuration");
+    }
+
+    return QString();
+}
+
+Diagnostics::ChangedCallback Diagnostics::changedCallback()
+{
+    return s_changedCallback;
+}
+
+void Diagnostics::setChangedCallback(ChangedCallback callback)
+{
+    s_changedCallback = callback;
+}
+
+void Diagnostics::changed()
+{
+    if (s_changedCallback)
+    {
+        s_changedCallback();
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Dwarf.h"
+
+#include <qstring.h>
+#include <qlist.h>
+#include <qmutex.h>
+
+enum class DiagnosticKind
+{
+    UnknownEntry,
+    UnknownAttribute,
+    UnknownLineNumberFunction,
+    UnknownLocationConfiguration,
+    Count
+};
+
+// Compact record of something the code model couldn't handle. Nothing is
+// formatted when it's recorded, message() builds the text only when it's
+// actually displayed. The names point into the DWARF data or the code model
+// arenas, so diagnostics have to be cleared before either goes away.
+struct Diagnostic
+{
+    DiagnosticKind kind;
+    Elf32_Half code;            // tag of the entry, or name of the attribute
+    Elf32_Half ownerTag;        // tag of the entry containing it
+    Elf32_Off offset;           // offset of the entry or attribute, or line number address
+    Elf32_Off ownerOffset;      // offset of the entry containing it
+    QLatin1String name;
+    QLatin1String ownerName;
+
+    QString message() const;
+};
+
+class Diagnostics
+{
+public:
+    typedef void(*ChangedCallback)();
+
+    static void add(const Diagnostic& diagnostic);
+    static void add(const QList<Diagnostic>& diagnostics);
+    static void clear();
+
+    static int count();
+    static int count(DiagnosticKind kind);
+
+    // changes on every clear, so readers can tell a clear followed by new
+    // diagnostics apart from diagnostics that were only appended
+    static int generation();
+    static Diagnostic at(int index);
+
+    static QString kindToString(DiagnosticKind kind);
+
+    static ChangedCallback changedCallback();
+    static void setChangedCallback(ChangedCallback callback);
+
+private:
+    static QMutex s_mutex;
+    static QList<Diagnostic> s_diagnostics;
+    static int s_counts[(int)DiagnosticKind::Count];
+    static int s_generation;
+    static ChangedCallback s_changedCallback;
+
+    static void changed();
+};
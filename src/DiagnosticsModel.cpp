@@ -0,0 +1,258 @@
+#include "DiagnosticsModel.h"
+
+#include "Util.h"
+
+DiagnosticsModel::DiagnosticsModel(QObject* parent)
+    : QAbstractItemModel(parent)
+    , m_rows()
+    , m_diagnosticCount(0)
+    , m_diagnosticGeneration(Diagnostics::generation())
+    , m_kindVisible()
+    , m_filter()
+{
+    for (bool& visible : m_kindVisible)
+    {
+        visible = true;
+    }
+}
+
+bool DiagnosticsModel::isKindVisible(DiagnosticKind kind) const
+{
+    return m_kindVisible[(int)kind];
+}
+
+void DiagnosticsModel::setKindVisible(DiagnosticKind kind, bool visible)
+{
+    if (m_kindVisible[(int)kind] == visible)
+    {
+        return;
+    }
+
+    m_kindVisible[(int)kind] = visible;
+
+    rebuild();
+}
+
+QString DiagnosticsModel::filter() const
+{
+    return m_filter;
+}
+
+void DiagnosticsModel::setFilter(const QString& filter)
+{
+    if (m_filter == filter)
+    {
+        return;
+    }
+
+    m_filter = filter;
+
+    rebuild();
+}
+
+bool DiagnosticsModel::hasOwner(const QModelIndex& index) const
+{
+    int diagnosticIndex = m_rows[index.row()];
+
+    if (diagnosticIndex >= Diagnostics::count())
+    {
+        return false;
+    }
+
+    // unknown entries at the root of the tree have nothing to show
+    return Diagnostics::at(diagnosticIndex).ownerTag != 0;
+}
+
+Elf32_Off DiagnosticsModel::dwarfOffset(const QModelIndex& index) const
+{
+    int diagnosticIndex = m_rows[index.row()];
+
+    if (diagnosticIndex >= Diagnostics::count())
+    {
+        return 0;
+    }
+
+    return Diagnostics::at(diagnosticIndex).ownerOffset;
+}
+
+void DiagnosticsModel::refresh()
+{
+    // diagnostics are only ever appended until they're cleared, so anything
+    // but a clear only needs the new ones checked. A clear and the adds of
+    // the next parse can arrive in one refresh, so the count alone can't
+    // tell whether there was a clear.
+    if (Diagnostics::generation() != m_diagnosticGeneration)
+    {
+        rebuild();
+        return;
+    }
+
+    int count = Diagnostics::count();
+    QList<int> rows;
+
+    for (int i = m_diagnosticCount; i < count; i++)
+    {
+        if (accepts(Diagnostics::at(i)))
+        {
+            rows.append(i);
+        }
+    }
+
+    m_diagnosticCount = count;
+
+    if (!rows.isEmpty())
+    {
+        beginInsertRows(QModelIndex(), m_rows.size(), m_rows.size() + rows.size() - 1);
+        m_rows.append(rows);
+        endInsertRows();
+    }
+
+    emit diagnosticsChanged();
+}
+
+bool DiagnosticsModel::accepts(const Diagnostic& diagnostic) const
+{
+    if (!m_kindVisible[(int)diagnostic.kind])
+    {
+        return false;
+    }
+
+    // only format the message if there's something to match it against
+    if (!m_filter.isEmpty() && !diagnostic.message().contains(m_filter, Qt::CaseInsensitive))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void DiagnosticsModel::rebuild()
+{
+    beginResetModel();
+
+    m_rows.clear();
+    m_diagnosticGeneration = Diagnostics::generation();
+    m_diagnosticCount = Diagnostics::count();
+
+    for (int i = 0; i < m_diagnosticCount; i++)
+    {
+        if (accepts(Diagnostics::at(i)))
+        {
+            m_rows.append(i);
+        }
+    }
+
+    endResetModel();
+
+    emit diagnosticsChanged();
+}
+
+QModelIndex DiagnosticsModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (!hasIndex(row, column, parent))
+    {
+        return QModelIndex();
+    }
+
+    if (!parent.isValid())
+    {
+        return createIndex(row, column);
+    }
+
+    return QModelIndex();
+}
+
+QModelIndex DiagnosticsModel::parent(const QModelIndex& child) const
+{
+    return QModelIndex();
+}
+
+int DiagnosticsModel::rowCount(const QModelIndex& parent) const
+{
+    if (!parent.isValid())
+    {
+        return m_rows.size();
+    }
+
+    return 0;
+}
+
+int DiagnosticsModel::columnCount(const QModelIndex& parent) const
+{
+    return ColumnCount;
+}
+
+QVariant DiagnosticsModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid())
+    {
+        return QVariant();
+    }
+
+    if (role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    int diagnosticIndex = m_rows[index.row()];
+
+    // the diagnostics may have been cleared before the refresh got here
+    if (diagnosticIndex >= Diagnostics::count())
+    {
+        return QVariant();
+    }
+
+    Diagnostic diagnostic = Diagnostics::at(diagnosticIndex);
+
+    switch (index.column())
+    {
+    case KindColumn:
+        return Diagnostics::kindToString(diagnostic.kind);
+    case MessageColumn:
+        return diagnostic.message();
+    case DwarfOffsetColumn:
+        if (diagnostic.ownerTag == 0)
+        {
+            return QVariant();
+        }
+
+        return Util::hexToString(diagnostic.ownerOffset);
+    }
+
+    return QVariant();
+}
+
+Qt::ItemFlags DiagnosticsModel::flags(const QModelIndex& index) const
+{
+    if (!index.isValid())
+    {
+        return Qt::NoItemFlags;
+    }
+
+    return QAbstractItemModel::flags(index);
+}
+
+QVariant DiagnosticsModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    if (orientation != Qt::Horizontal)
+    {
+        return QVariant();
+    }
+
+    switch (section)
+    {
+    case KindColumn:
+        return tr("Kind");
+    case MessageColumn:
+        return tr("Message");
+    case DwarfOffsetColumn:
+        return tr("DWARF Offset");
+    }
+
+    return QVariant();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <qabstractitemmodel.h>
+
+#include "Diagnostics.h"
+
+class DiagnosticsModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Column
+    {
+        KindColumn,
+        MessageColumn,
+        DwarfOffsetColumn,
+        ColumnCount
+    };
+
+    DiagnosticsModel(QObject* parent = nullptr);
+
+    bool isKindVisible(DiagnosticKind kind) const;
+    void setKindVisible(DiagnosticKind kind, bool visible);
+    QString filter() const;
+    void setFilter(const QString& filter);
+
+    bool hasOwner(const QModelIndex& index) const;
+    Elf32_Off dwarfOffset(const QModelIndex& index) const;
+
+    QVariant data(const QModelIndex& index, int role) const override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent) const override;
+    int columnCount(const QModelIndex& parent) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+signals:
+    void diagnosticsChanged();
+
+public slots:
+    void refresh();
+
+private:
+    // indices into Diagnostics of the rows that pass the filter
+    QList<int> m_rows;
+    int m_diagnosticCount;
+    int m_diagnosticGeneration;
+    bool m_kindVisible[(int)DiagnosticKind::Count];
+    QString m_filter;
+
+    bool accepts(const Diagnostic& diagnostic) const;
+    void rebuild();
+};
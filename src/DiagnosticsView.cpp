@@ -0,0 +1,115 @@
+#include "DiagnosticsView.h"
+
+#include <qheaderview.h>
+#include <qboxlayout.h>
+#include <qlabel.h>
+
+DiagnosticsView::DiagnosticsView(QWidget* parent)
+    : QWidget(parent)
+    , m_treeView(new TreeView)
+    , m_filterLineEdit(new QLineEdit)
+    , m_kindCheckBoxes()
+    , m_model(nullptr)
+    , m_filterDelay(new QTimer(this))
+{
+    connect(m_filterLineEdit, &QLineEdit::textChanged, this, &DiagnosticsView::onFilterLineEditTextChanged);
+
+    m_filterDelay->setSingleShot(true);
+    connect(m_filterDelay, &QTimer::timeout, this, &DiagnosticsView::updateFilter);
+
+    QVBoxLayout* mainLayout = new QVBoxLayout;
+
+    QHBoxLayout* topLayout = new QHBoxLayout;
+    topLayout->addWidget(new QLabel(tr("Filter:")));
+    topLayout->addWidget(m_filterLineEdit, 1);
+
+    for (int i = 0; i < (int)DiagnosticKind::Count; i++)
+    {
+        DiagnosticKind kind = (DiagnosticKind)i;
+        QCheckBox* checkBox = new QCheckBox;
+
+        checkBox->setChecked(true);
+        connect(checkBox, &QCheckBox::toggled, this, [=](bool checked) {
+            if (m_model)
+            {
+                m_model->setKindVisible(kind, checked);
+            }
+            });
+
+        topLayout->addWidget(checkBox);
+        m_kindCheckBoxes[i] = checkBox;
+    }
+
+    mainLayout->addLayout(topLayout);
+    mainLayout->addWidget(m_treeView, 1);
+
+    setLayout(mainLayout);
+
+    updateCounts();
+}
+
+DiagnosticsModel* DiagnosticsView::model() const
+{
+    return m_model;
+}
+
+void DiagnosticsView::setModel(DiagnosticsModel* model)
+{
+    m_treeView->setModel(model);
+
+    m_model = model;
+
+    connect(model, &DiagnosticsModel::diagnosticsChanged, this, &DiagnosticsView::updateCounts);
+    connect(m_treeView->selectionModel(), &QItemSelectionModel::currentChanged, this, &DiagnosticsView::currentChanged);
+
+    m_treeView->header()->setStretchLastSection(false);
+    m_treeView->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+    m_treeView->header()->setSectionResizeMode(1, QHeaderView::Stretch);
+    m_treeView->header()->setSectionResizeMode(2, QHeaderView::ResizeToContents);
+
+    for (int i = 0; i < (int)DiagnosticKind::Count; i++)
+    {
+        m_kindCheckBoxes[i]->setChecked(model->isKindVisible((DiagnosticKind)i));
+    }
+
+    m_filterLineEdit->clear();
+
+    updateFilter();
+    updateCounts();
+}
+
+void DiagnosticsView::updateFilter()
+{
+    if (m_model)
+    {
+        m_model->setFilter(m_filterLineEdit->text());
+    }
+}
+
+void DiagnosticsView::updateCounts()
+{
+    for (int i = 0; i < (int)DiagnosticKind::Count; i++)
+    {
+        DiagnosticKind kind = (DiagnosticKind)i;
+
+        m_kindCheckBoxes[i]->setText(tr("%1 (%2)").arg(Diagnostics::kindToString(kind)).arg(Diagnostics::count(kind)));
+    }
+}
+
+void DiagnosticsView::currentChanged(const QModelIndex& current, const QModelIndex& previous)
+{
+    if (!current.isValid() || !m_model)
+    {
+        return;
+    }
+
+    if (m_model->hasOwner(current))
+    {
+        emit diagnosticSelected(m_model->dwarfOffset(current));
+    }
+}
+
+void DiagnosticsView::onFilterLineEditTextChanged(const QString& text)
+{
+    m_filterDelay->start(500);
+}
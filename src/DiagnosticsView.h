@@ -0,0 +1,38 @@
+#pragma once
+
+#include <qwidget.h>
+
+#include "DiagnosticsModel.h"
+#include "TreeView.h"
+
+#include <qlineedit.h>
+#include <qcheckbox.h>
+#include <qtimer.h>
+
+class DiagnosticsView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    DiagnosticsView(QWidget* parent = nullptr);
+
+    DiagnosticsModel* model() const;
+    void setModel(DiagnosticsModel* model);
+
+signals:
+    void diagnosticSelected(Elf32_Off dwarfOffset);
+
+private:
+    TreeView* m_treeView;
+    QLineEdit* m_filterLineEdit;
+    QCheckBox* m_kindCheckBoxes[(int)DiagnosticKind::Count];
+    DiagnosticsModel* m_model;
+    QTimer* m_filterDelay;
+
+    void updateFilter();
+    void updateCounts();
+
+private slots:
+    void currentChanged(const QModelIndex& current, const QModelIndex& previous);
+    void onFilterLineEditTextChanged(const QString& text);
+};
@@ -1,11 +1,16 @@
 #include "Disassemblers.h"
 
 #include "PPCDisassembler.h"
+#include "Trace.h"
+#include "Util.h"
 
 static PPCDisassembler* ppc = new PPCDisassembler;
 
 bool Disassemblers::disassemble(Disassembly& disasm, const Elf* elf, Elf32_Addr startAddress, Elf32_Addr endAddress)
 {
+    TRACE_SCOPE_DETAIL("Disassemblers::disassemble",
+        Util::hexToString(startAddress) + "-" + Util::hexToString(endAddress));
+
     AbstractDisassembler* d = disassembler(elf->header->e_machine);
 
     if (!d)
@@ -1,43 +1,76 @@
 #include "Disassembly.h"
 
+#include "AbstractDisassembler.h"
+#include "MemoryUsage.h"
+
 Disassembly::Disassembly() :
-    m_lines()
+    m_disassembler(nullptr),
+    m_instructions()
 {
 }
 
 void Disassembly::clear()
 {
-    m_lines.clear();
+    m_disassembler = nullptr;
+    m_instructions.clear();
+}
+
+void Disassembly::setDisassembler(const AbstractDisassembler* disassembler)
+{
+    m_disassembler = disassembler;
 }
 
-void Disassembly::addLine(Elf32_Addr address, const QString& leftText, const QString& rightText)
+void Disassembly::addInstruction(Elf32_Addr address, quint32 word, quint16 opcode)
 {
-    DisassemblyLine line;
-    line.address = address;
-    line.leftText = leftText;
-    line.rightText = rightText;
-    m_lines.append(line);
+    DisassemblyInstruction instruction;
+    instruction.address = address;
+    instruction.word = word;
+    instruction.opcode = opcode;
+    m_instructions.append(instruction);
 }
 
 int Disassembly::lineCount() const
 {
-    return m_lines.size();
+    return m_instructions.size();
+}
+
+const DisassemblyInstruction& Disassembly::instruction(int line) const
+{
+    Q_ASSERT(line >= 0 && line < m_instructions.size());
+    return m_instructions[line];
 }
 
 Elf32_Addr Disassembly::address(int line) const
 {
-    Q_ASSERT(line >= 0 && line < m_lines.size());
-    return m_lines[line].address;
+    Q_ASSERT(line >= 0 && line < m_instructions.size());
+    return m_instructions[line].address;
 }
 
 QString Disassembly::leftText(int line) const
 {
-    Q_ASSERT(line >= 0 && line < m_lines.size());
-    return m_lines[line].leftText;
+    QString leftText;
+    QString rightText;
+    formatLine(line, leftText, rightText);
+    return leftText;
 }
 
 QString Disassembly::rightText(int line) const
 {
-    Q_ASSERT(line >= 0 && line < m_lines.size());
-    return m_lines[line].rightText;
+    QString leftText;
+    QString rightText;
+    formatLine(line, leftText, rightText);
+    return rightText;
+}
+
+void Disassembly::formatLine(int line, QString& leftText, QString& rightText) const
+{
+    Q_ASSERT(line >= 0 && line < m_instructions.size());
+    Q_ASSERT(m_disassembler);
+
+    m_disassembler->format(m_instructions[line], leftText, rightText);
+}
+
+qint64 Disassembly::memoryBytes() const
+{
+    return Memory::listBytes(m_instructions);
 }
@@ -5,11 +5,16 @@
 #include <qstring.h>
 #include <qlist.h>
 
-struct DisassemblyLine
+class AbstractDisassembler;
+
+// One decoded instruction. Only the raw word and the disassembler's
+// instruction ID are kept, the text is formatted on demand by the
+// disassembler that decoded it.
+struct DisassemblyInstruction
 {
     Elf32_Addr address;
-    QString leftText;
-    QString rightText;
+    quint32 word;
+    quint16 opcode; // disassembler specific instruction ID, 0 for data
 };
 
 class Disassembly
@@ -18,13 +23,22 @@ public:
     Disassembly();
 
     void clear();
-    void addLine(Elf32_Addr address, const QString& leftText, const QString& rightText);
+    void setDisassembler(const AbstractDisassembler* disassembler);
+    void addInstruction(Elf32_Addr address, quint32 word, quint16 opcode);
 
     int lineCount() const;
+    const DisassemblyInstruction& instruction(int line) const;
     Elf32_Addr address(int line) const;
     QString leftText(int line) const;
     QString rightText(int line) const;
 
+    // Formats both texts at once, which is cheaper than asking for them one
+    // at a time
+    void formatLine(int line, QString& leftText, QString& rightText) const;
+
+    qint64 memoryBytes() const;
+
 private:
-    QList<DisassemblyLine> m_lines;
+    const AbstractDisassembler* m_disassembler;
+    QList<DisassemblyInstruction> m_instructions;
 };
@@ -0,0 +1,229 @@
+#include "DisassemblyCache.h"
+
+#include "Disassemblers.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <qthreadpool.h>
+
+QList<DisassemblyCacheEntry> DisassemblyCache::s_entries;
+QHash<Elf32_Addr, int> DisassemblyCache::s_entryIndices;
+QAtomicInt DisassemblyCache::s_ready;
+QAtomicInt DisassemblyCache::s_cancelled;
+QSemaphore DisassemblyCache::s_finished;
+bool DisassemblyCache::s_running = false;
+DisassemblyCache::ReadyCallback DisassemblyCache::s_readyCallback = nullptr;
+
+void DisassemblyCache::start(const Dwarf* dwarf)
+{
+    clear();
+
+    if (!dwarf || !dwarf->elf)
+    {
+        return;
+    }
+
+    // nothing to wait for if the architecture isn't supported, every lookup
+    // just fails
+    if (!Disassemblers::disassembler(dwarf->elf->header->e_machine))
+    {
+        s_ready.storeRelease(1);
+        return;
+    }
+
+    const Elf* elf = dwarf->elf;
+
+    for (int i = 0; i < dwarf->entryCount; i++)
+    {
+        DwarfEntry* entry = &dwarf->entries[i];
+
+        if (entry->tag != DW_TAG_global_subroutine && entry->tag != DW_TAG_subroutine)
+        {
+            continue;
+        }
+
+        DwarfAttribute* lowPc = entry->findAttribute(DW_AT_low_pc);
+        DwarfAttribute* highPc = entry->findAttribute(DW_AT_high_pc);
+
+        if (lowPc && highPc && lowPc->addr < highPc->addr)
+        {
+            addFunction(lowPc->addr, highPc->addr);
+        }
+    }
+
+    if (elf->symbolTable)
+    {
+        for (Elf32_Half i = 0; i < elf->header->e_shnum; i++)
+        {
+            if (elf->sectionHeaderTable[i].sh_type != SHT_SYMTAB)
+            {
+                continue;
+            }
+
+            Elf32_Word symbolCount = elf->sectionHeaderTable[i].sh_size / sizeof(Elf32_Sym);
+
+            for (Elf32_Word j = 0; j < symbolCount; j++)
+            {
+                const Elf32_Sym& symbol = elf->symbolTable[j];
+
+                if (ELF32_ST_TYPE(symbol.st_info) == STT_FUNC && symbol.st_size > 0)
+                {
+                    addFunction(symbol.st_value, symbol.st_value + symbol.st_size);
+                }
+            }
+
+            break;
+        }
+    }
+
+    if (s_entries.isEmpty())
+    {
+        s_ready.storeRelease(1);
+        return;
+    }
+
+    // taken here so the workers never detach the list while others read it
+    DisassemblyCacheEntry* entries = s_entries.data();
+    int entryCount = s_entries.size();
+
+    s_running = true;
+
+    QThreadPool::globalInstance()->start([elf, entries, entryCount]
+        {
+            TRACE_SCOPE("DisassemblyCache::fill");
+
+            Util::parallelFor(entryCount, [&](int i)
+                {
+                    if (s_cancelled.loadAcquire())
+                    {
+                        return;
+                    }
+
+                    DisassemblyCacheEntry& entry = entries[i];
+
+                    if (Disassemblers::disassemble(entry.disassembly, elf, entry.startAddress, entry.endAddress))
+                    {
+                        entry.state.storeRelease(Done);
+                    }
+                    else
+                    {
+                        entry.state.storeRelease(Failed);
+                    }
+                });
+
+            if (!s_cancelled.loadAcquire())
+            {
+                s_ready.storeRelease(1);
+
+                if (s_readyCallback)
+                {
+                    s_readyCallback();
+                }
+            }
+
+            s_finished.release();
+        });
+}
+
+void DisassemblyCache::clear()
+{
+    if (s_running)
+    {
+        s_cancelled.storeRelease(1);
+        s_finished.acquire();
+        s_running = false;
+    }
+
+    s_entries.clear();
+    s_entryIndices.clear();
+    s_ready.storeRelease(0);
+    s_cancelled.storeRelease(0);
+}
+
+void DisassemblyCache::waitForFinished()
+{
+    if (s_running)
+    {
+        s_finished.acquire();
+        s_running = false;
+    }
+}
+
+bool DisassemblyCache::isReady()
+{
+    return s_ready.loadAcquire();
+}
+
+const Disassembly* DisassemblyCache::find(Elf32_Addr startAddress, Elf32_Addr endAddress)
+{
+    auto it = s_entryIndices.constFind(startAddress);
+
+    if (it == s_entryIndices.constEnd())
+    {
+        return nullptr;
+    }
+
+    const DisassemblyCacheEntry& entry = s_entries.at(*it);
+
+    if (entry.endAddress != endAddress || entry.state.loadAcquire() != Done)
+    {
+        return nullptr;
+    }
+
+    return &entry.disassembly;
+}
+
+int DisassemblyCache::functionCount()
+{
+    return s_entries.size();
+}
+
+const DisassemblyCacheEntry& DisassemblyCache::function(int index)
+{
+    return s_entries.at(index);
+}
+
+MemoryUsage DisassemblyCache::memoryUsage()
+{
+    qint64 disassemblyBytes = 0;
+
+    // only finished entries, the rest may still be written to
+    for (const DisassemblyCacheEntry& entry : s_entries)
+    {
+        if (entry.state.loadAcquire() == Done)
+        {
+            disassemblyBytes += entry.disassembly.memoryBytes();
+        }
+    }
+
+    MemoryUsage usage("Disassembly cache");
+    usage.add("Functions", Memory::listBytes(s_entries) + Memory::hashBytes(s_entryIndices));
+    usage.add("Instructions", disassemblyBytes);
+    return usage;
+}
+
+DisassemblyCache::ReadyCallback DisassemblyCache::readyCallback()
+{
+    return s_readyCallback;
+}
+
+void DisassemblyCache::setReadyCallback(ReadyCallback callback)
+{
+    s_readyCallback = callback;
+}
+
+void DisassemblyCache::addFunction(Elf32_Addr startAddress, Elf32_Addr endAddress)
+{
+    if (s_entryIndices.contains(startAddress))
+    {
+        return;
+    }
+
+    s_entryIndices.insert(startAddress, s_entries.size());
+
+    DisassemblyCacheEntry entry;
+    entry.startAddress = startAddress;
+    entry.endAddress = endAddress;
+    entry.state.storeRelaxed(Pending);
+    s_entries.append(entry);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Disassembly.h"
+#include "Dwarf.h"
+#include "MemoryUsage.h"
+
+#include <qlist.h>
+#include <qhash.h>
+#include <qatomic.h>
+#include <qsemaphore.h>
+
+struct DisassemblyCacheEntry
+{
+    Elf32_Addr startAddress;
+    Elf32_Addr endAddress;
+    QAtomicInt state;
+    Disassembly disassembly;
+};
+
+// Disassembly of every function in the loaded binary, shared by everything
+// that needs it. It's filled on the global thread pool as soon as a file is
+// loaded, one task per function (DWARF functions first, then symbols that
+// DWARF doesn't cover). Only the compact instruction records are kept, the
+// text is formatted from them when a line is shown.
+class DisassemblyCache
+{
+public:
+    typedef void(*ReadyCallback)();
+
+    enum State
+    {
+        Pending,
+        Done,
+        Failed
+    };
+
+    static void start(const Dwarf* dwarf);
+    static void clear();
+    static void waitForFinished();
+    static bool isReady();
+
+    // Disassembly of the function at startAddress, or nullptr if it isn't
+    // disassembled (yet)
+    static const Disassembly* find(Elf32_Addr startAddress, Elf32_Addr endAddress);
+
+    static int functionCount();
+    static const DisassemblyCacheEntry& function(int index);
+
+    static MemoryUsage memoryUsage();
+
+    static ReadyCallback readyCallback();
+    static void setReadyCallback(ReadyCallback callback);
+
+private:
+    static QList<DisassemblyCacheEntry> s_entries;
+    static QHash<Elf32_Addr, int> s_entryIndices;
+    static QAtomicInt s_ready;
+    static QAtomicInt s_cancelled;
+    static QSemaphore s_finished;
+    static bool s_running;
+    static ReadyCallback s_readyCallback;
+
+    static void addFunction(Elf32_Addr startAddress, Elf32_Addr endAddress);
+};
@@ -1,7 +1,17 @@
 #include "Dwarf.h"
 
+#include "DwarfAttributes.h"
+#include "Trace.h"
+#include "Util.h"
+#include "AllocationCounter.h"
+
 #include <memory>
+#include <algorithm>
+#include <vector>
+#include <climits>
 #include <qdebug.h>
+#include <qhash.h>
+#include <qset.h>
 
 static void countAttribute(const Elf* elf, char*& data, int& attributeCount)
 {
@@ -244,8 +254,122 @@ static void readSourceStatementTable(const Elf* elf, char*& data, DwarfSourceSta
     table++;
 }
 
+struct BlockCounts
+{
+    int locationCount;
+    int locationAtomCount;
+    int subscriptDataCount;
+    int subscriptDataItemCount;
+    int elementListCount;
+    int elementListItemCount;
+};
+
+static void addBlockCounts(BlockCounts& counts, const BlockCounts& other)
+{
+    counts.locationCount += other.locationCount;
+    counts.locationAtomCount += other.locationAtomCount;
+    counts.subscriptDataCount += other.subscriptDataCount;
+    counts.subscriptDataItemCount += other.subscriptDataItemCount;
+    counts.elementListCount += other.elementListCount;
+    counts.elementListItemCount += other.elementListItemCount;
+}
+
+static void countBlock(Dwarf* dwarf, DwarfAttribute* attribute, BlockCounts& counts)
+{
+    switch (attribute->name)
+    {
+    case DW_AT_location:
+    {
+        counts.locationCount++;
+        counts.locationAtomCount += DwarfLocation::countAtoms(dwarf->elf, attribute->block, attribute->blockLength);
+        break;
+    }
+    case DW_AT_subscr_data:
+    {
+        int atomCount = 0;
+        counts.subscriptDataCount++;
+        counts.subscriptDataItemCount += DwarfSubscriptData::count(dwarf, attribute, atomCount);
+        counts.locationAtomCount += atomCount;
+        break;
+    }
+    case DW_AT_element_list:
+    {
+        counts.elementListCount++;
+        counts.elementListItemCount += DwarfElementList::count(dwarf, attribute);
+        break;
+    }
+    }
+}
+
+// offsets is where the next decoded block of each kind goes, it is advanced past the block
+static void readBlock(Dwarf* dwarf, DwarfAttribute* attribute, BlockCounts& offsets)
+{
+    switch (attribute->name)
+    {
+    case DW_AT_location:
+    {
+        DwarfLocationAtom* atoms = &dwarf->locationAtoms[offsets.locationAtomCount];
+        int atomCount = DwarfLocation::readAtoms(dwarf->elf, attribute->block, attribute->blockLength, atoms);
+
+        DwarfCompiledLocation* location = &dwarf->locations[offsets.locationCount++];
+        location->attribute = attribute;
+        location->compile(atoms, atomCount);
+
+        offsets.locationAtomCount += atomCount;
+        break;
+    }
+    case DW_AT_subscr_data:
+    {
+        DwarfSubscriptData* subscriptData = &dwarf->subscriptData[offsets.subscriptDataCount++];
+        offsets.locationAtomCount += subscriptData->read(dwarf, attribute,
+            &dwarf->subscriptDataItems[offsets.subscriptDataItemCount], &dwarf->locationAtoms[offsets.locationAtomCount]);
+        offsets.subscriptDataItemCount += subscriptData->itemCount;
+        break;
+    }
+    case DW_AT_element_list:
+    {
+        DwarfElementList* elementList = &dwarf->elementLists[offsets.elementListCount++];
+        elementList->read(dwarf, attribute, &dwarf->elementListItems[offsets.elementListItemCount]);
+        offsets.elementListItemCount += elementList->itemCount;
+        break;
+    }
+    }
+}
+
+template <class T> static const T* findByAttribute(const T* items, int count, const DwarfAttribute* attribute)
+{
+    const T* end = items + count;
+    const T* item = std::lower_bound(items, end, attribute,
+        [](const T& i, const DwarfAttribute* a) { return i.attribute < a; });
+
+    if (item != end && item->attribute == attribute)
+    {
+        return item;
+    }
+
+    return nullptr;
+}
+
+// entries and source statement tables are read in section order,
+// so both are already sorted by offset
+template <class T> static T* findByOffset(T* items, int count, Elf32_Off offset)
+{
+    T* end = items + count;
+    T* item = std::lower_bound(items, end, offset,
+        [](const T& i, Elf32_Off o) { return i.offset < o; });
+
+    if (item != end && item->offset == offset)
+    {
+        return item;
+    }
+
+    return nullptr;
+}
+
 Dwarf::ReadResult Dwarf::read(const Elf* elf)
 {
+    TRACE_SCOPE("Dwarf::read");
+
     destroy();
 
     this->elf = elf;
@@ -267,11 +391,15 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
     char* debugDataStart = debugData;
     char* debugDataEnd = debugData + elf->sectionHeaderTable[debugSectionIndex].sh_size;
 
+    TraceScope countEntriesScope("Dwarf::read count entries");
+
     while (debugData < debugDataEnd)
     {
         countEntry(elf, debugData, entryCount, attributeCount);
     }
 
+    countEntriesScope.finish();
+
     Elf32_Half lineNumberTableSectionIndex = elf->getSectionIndex(".line");
     char* lineNumberTableData = nullptr;
 
@@ -288,6 +416,8 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
         lineNumberTableDataStart = lineNumberTableData;
         lineNumberTableDataEnd = lineNumberTableData + elf->sectionHeaderTable[lineNumberTableSectionIndex].sh_size;
 
+        TRACE_SCOPE("Dwarf::read count source statements");
+
         while (lineNumberTableData < lineNumberTableDataEnd)
         {
             countSourceStatementTable(elf, lineNumberTableData, sourceStatementTableCount, sourceStatementEntryCount);
@@ -307,6 +437,7 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
         + attributeCount * sizeof(DwarfAttribute)
         + sourceStatementTableCount * sizeof(DwarfSourceStatementTable)
         + sourceStatementEntryCount * sizeof(DwarfSourceStatementEntry));
+    AllocationCounter::add();
 
     entries = (DwarfEntry*)internalData;
     attributes = (DwarfAttribute*)(entries + entryCount);
@@ -340,6 +471,8 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
         DwarfEntry* entry = entries;
         DwarfAttribute* attribute = attributes;
 
+        TraceScope readEntriesScope("Dwarf::read read entries");
+
         while (debugData < debugDataEnd)
         {
             entry->offset = (Elf32_Off)(debugData - debugDataStart);
@@ -347,6 +480,10 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
             readEntry(elf, debugData, entry, attribute);
         }
 
+        readEntriesScope.finish();
+
+        TraceScope linkSiblingsScope("Dwarf::read link siblings");
+
         for (int i = 0; i < entryCount - 1; i++)
         {
             entry = &entries[i];
@@ -387,6 +524,10 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
         entries[entryCount - 1].sibling = nullptr;
         entries[entryCount - 1].firstChild = nullptr;
 
+        linkSiblingsScope.finish();
+
+        TRACE_SCOPE("Dwarf::read link padding");
+
         for (int i = 0; i < entryCount - 1; i++)
         {
             entry = &entries[i];
@@ -410,6 +551,16 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
         }
     }
 
+    if (attributes)
+    {
+        readBlocks();
+    }
+
+    if (entries)
+    {
+        hashTypes();
+    }
+
     if (sourceStatementTables)
     {
         lineNumberTableData = lineNumberTableDataStart;
@@ -417,6 +568,8 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
         DwarfSourceStatementTable* table = sourceStatementTables;
         DwarfSourceStatementEntry* entry = sourceStatementEntries;
 
+        TRACE_SCOPE("Dwarf::read read source statements");
+
         while (lineNumberTableData < lineNumberTableDataEnd)
         {
             table->offset = (Elf32_Off)(lineNumberTableData - lineNumberTableDataStart);
@@ -428,6 +581,733 @@ Dwarf::ReadResult Dwarf::read(const Elf* elf)
     return ReadSuccess;
 }
 
+// Decodes all location, subscript data and element list blocks up front, so
+// nothing has to re-read them later. The attributes are split into chunks
+// which are counted in parallel, laid out one after another with a prefix
+// sum and then decoded in parallel into their own part of the storage.
+void Dwarf::readBlocks()
+{
+    TRACE_SCOPE("Dwarf::read decode blocks");
+
+    const int chunkSize = 4096;
+    int chunkCount = (attributeCount + chunkSize - 1) / chunkSize;
+
+    // chunk i starts at offsets[i], offsets[chunkCount] holds the totals
+    std::vector<BlockCounts> offsets(chunkCount + 1, BlockCounts());
+
+    Util::parallelFor(chunkCount, [&](int chunk)
+        {
+            int end = std::min((chunk + 1) * chunkSize, attributeCount);
+
+            for (int i = chunk * chunkSize; i < end; i++)
+            {
+                countBlock(this, &attributes[i], offsets[chunk + 1]);
+            }
+        });
+
+    for (int i = 0; i < chunkCount; i++)
+    {
+        addBlockCounts(offsets[i + 1], offsets[i]);
+    }
+
+    const BlockCounts& totals = offsets[chunkCount];
+
+    locationCount = totals.locationCount;
+    subscriptDataCount = totals.subscriptDataCount;
+    elementListCount = totals.elementListCount;
+    locationAtomCount = totals.locationAtomCount;
+    subscriptDataItemCount = totals.subscriptDataItemCount;
+    elementListItemCount = totals.elementListItemCount;
+
+    if (locationCount == 0 && subscriptDataCount == 0 && elementListCount == 0)
+    {
+        return;
+    }
+
+    blockData = malloc(
+        locationCount * sizeof(DwarfCompiledLocation)
+        + subscriptDataCount * sizeof(DwarfSubscriptData)
+        + elementListCount * sizeof(DwarfElementList)
+        + subscriptDataItemCount * sizeof(DwarfSubscriptDataItem)
+        + elementListItemCount * sizeof(DwarfElementListItem)
+        + locationAtomCount * sizeof(DwarfLocationAtom));
+    AllocationCounter::add();
+
+    locations = (DwarfCompiledLocation*)blockData;
+    subscriptData = (DwarfSubscriptData*)(locations + locationCount);
+    elementLists = (DwarfElementList*)(subscriptData + subscriptDataCount);
+    subscriptDataItems = (DwarfSubscriptDataItem*)(elementLists + elementListCount);
+    elementListItems = (DwarfElementListItem*)(subscriptDataItems + subscriptDataItemCount);
+    locationAtoms = (DwarfLocationAtom*)(elementListItems + elementListItemCount);
+
+    Util::parallelFor(chunkCount, [&](int chunk)
+        {
+            int end = std::min((chunk + 1) * chunkSize, attributeCount);
+            BlockCounts chunkOffsets = offsets[chunk];
+
+            for (int i = chunk * chunkSize; i < end; i++)
+            {
+                readBlock(this, &attributes[i], chunkOffsets);
+            }
+        });
+
+    if (locationCount == 0)
+    {
+        locations = nullptr;
+    }
+
+    if (subscriptDataCount == 0)
+    {
+        subscriptData = nullptr;
+    }
+
+    if (elementListCount == 0)
+    {
+        elementLists = nullptr;
+    }
+
+    if (subscriptDataItemCount == 0)
+    {
+        subscriptDataItems = nullptr;
+    }
+
+    if (elementListItemCount == 0)
+    {
+        elementListItems = nullptr;
+    }
+
+    if (locationAtomCount == 0)
+    {
+        locationAtoms = nullptr;
+    }
+}
+
+static bool isTypeTag(Elf32_Half tag)
+{
+    switch (tag)
+    {
+    case DW_TAG_class_type:
+    case DW_TAG_structure_type:
+    case DW_TAG_union_type:
+    case DW_TAG_enumeration_type:
+    case DW_TAG_array_type:
+    case DW_TAG_subroutine_type:
+    case DW_TAG_ptr_to_member_type:
+        return true;
+    }
+
+    return false;
+}
+
+// 64-bit FNV-1a
+struct TypeHash
+{
+    quint64 value = 14695981039346656037ULL;
+
+    void add(const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            value = (value ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    void add(quint64 x)
+    {
+        add(&x, sizeof(x));
+    }
+
+    void add(const char* string)
+    {
+        add(string, strlen(string));
+        add((quint64)0);
+    }
+};
+
+// Merkle-style hash over an entry's tag, attributes and children, where
+// references to other types contribute the referenced type's own hash.
+// Types reached through a pointer or reference are hashed by name only,
+// which is where C++ type graphs have their cycles. Anything that still
+// loops back (e.g. through an anonymous type) hashes as a back reference
+// to the type being hashed on the stack. A hash that contains a back
+// reference to a type further up the stack depends on where the traversal
+// entered the cycle, so it's only kept for the type it was computed for.
+class TypeHasher
+{
+public:
+    TypeHasher(Dwarf* dwarf)
+        : m_dwarf(dwarf)
+        , m_states(dwarf->typeIdentityCount, Unvisited)
+        , m_depths(dwarf->typeIdentityCount, 0)
+        , m_depth(0)
+        , m_lowestBackReference(INT_MAX)
+    {
+    }
+
+    quint64 hashType(DwarfTypeIdentity* identity)
+    {
+        int index = (int)(identity - m_dwarf->typeIdentities);
+
+        if (m_states[index] == Done)
+        {
+            return identity->hash;
+        }
+
+        int depth = m_depth++;
+        int outerLowestBackReference = m_lowestBackReference;
+
+        m_states[index] = InProgress;
+        m_depths[index] = depth;
+        m_lowestBackReference = INT_MAX;
+
+        TypeHash hash;
+        hashEntry(identity->entry, hash);
+
+        m_depth--;
+
+        if (m_lowestBackReference < depth)
+        {
+            // hashed again whenever it's reached from somewhere else
+            m_states[index] = Unvisited;
+            m_lowestBackReference = qMin(outerLowestBackReference, m_lowestBackReference);
+        }
+        else
+        {
+            m_states[index] = Done;
+            identity->hash = hash.value;
+            m_lowestBackReference = outerLowestBackReference;
+        }
+
+        return hash.value;
+    }
+
+private:
+    enum State : char
+    {
+        Unvisited,
+        InProgress,
+        Done
+    };
+
+    Dwarf* m_dwarf;
+    std::vector<State> m_states;
+    std::vector<int> m_depths;
+    int m_depth;
+    int m_lowestBackReference;
+
+    void hashEntry(const DwarfEntry* entry, TypeHash& hash)
+    {
+        hash.add(entry->tag);
+
+        for (int i = 0; i < entry->attributeCount; i++)
+        {
+            hashAttribute(&entry->attributes[i], hash);
+        }
+
+        for (DwarfEntry* child = entry->firstChild; child != nullptr; child = child->sibling)
+        {
+            if (child->isNull() || child->tag == DW_TAG_padding)
+            {
+                continue;
+            }
+
+            hash.add('C');
+            hashEntry(child, hash);
+        }
+
+        hash.add('E');
+    }
+
+    void hashAttribute(DwarfAttribute* attribute, TypeHash& hash)
+    {
+        // sibling offsets differ between otherwise identical copies
+        if (attribute->name == DW_AT_sibling)
+        {
+            return;
+        }
+
+        hash.add(attribute->name);
+
+        switch (attribute->name)
+        {
+        case DW_AT_fund_type:
+        case DW_AT_mod_fund_type:
+        case DW_AT_user_def_type:
+        case DW_AT_mod_u_d_type:
+        {
+            DwarfType type;
+            type.read(m_dwarf, attribute);
+            hashDwarfType(type, hash);
+            return;
+        }
+        case DW_AT_subscr_data:
+        {
+            if (const DwarfSubscriptData* data = m_dwarf->findSubscriptData(attribute))
+            {
+                hashDwarfType(data->elementType, hash);
+
+                for (int i = 0; i < data->itemCount; i++)
+                {
+                    const DwarfSubscriptDataItem& item = data->items[i];
+
+                    hashDwarfType(item.indexType, hash);
+                    hashBound(item.lowBound, hash);
+                    hashBound(item.highBound, hash);
+                }
+            }
+
+            return;
+        }
+        }
+
+        switch (attribute->getForm())
+        {
+        case DW_FORM_ADDR:
+            hash.add(attribute->addr);
+            break;
+        case DW_FORM_REF:
+            hashTypeReference(attribute->ref, true, hash);
+            break;
+        case DW_FORM_BLOCK2:
+        case DW_FORM_BLOCK4:
+            hash.add(attribute->blockLength);
+            hash.add(attribute->block, attribute->blockLength);
+            break;
+        case DW_FORM_DATA2:
+            hash.add(attribute->data2);
+            break;
+        case DW_FORM_DATA4:
+            hash.add(attribute->data4);
+            break;
+        case DW_FORM_DATA8:
+            hash.add(attribute->data8);
+            break;
+        case DW_FORM_STRING:
+            hash.add(attribute->string);
+            break;
+        }
+    }
+
+    void hashDwarfType(const DwarfType& type, TypeHash& hash)
+    {
+        bool isIndirect = false;
+
+        hash.add(type.modifierCount);
+        hash.add(type.modifiers, type.modifierCount);
+
+        for (int i = 0; i < type.modifierCount; i++)
+        {
+            if (type.modifiers[i] == DW_MOD_pointer_to || type.modifiers[i] == DW_MOD_reference_to)
+            {
+                isIndirect = true;
+            }
+        }
+
+        if (type.isFundamental)
+        {
+            hash.add('F');
+            hash.add(type.fundType);
+        }
+        else
+        {
+            hashTypeReference(type.udTypeOffset, isIndirect, hash);
+        }
+    }
+
+    void hashBound(const DwarfSubscriptDataBound& bound, TypeHash& hash)
+    {
+        hash.add(bound.isConstant);
+        hash.add(bound.constant);
+
+        for (int i = 0; i < bound.atomCount; i++)
+        {
+            hash.add(bound.atoms[i].op);
+            hash.add(bound.atoms[i].number);
+        }
+    }
+
+    void hashTypeReference(Elf32_Off offset, bool isIndirect, TypeHash& hash)
+    {
+        DwarfEntry* target = m_dwarf->findEntry(offset);
+
+        if (!target)
+        {
+            hash.add('?');
+            return;
+        }
+
+        const char* name = target->getName();
+        DwarfTypeIdentity* identity = (DwarfTypeIdentity*)m_dwarf->findTypeIdentity(target);
+
+        if (!identity || (isIndirect && *name))
+        {
+            hash.add('N');
+            hash.add(target->tag);
+            hash.add(name);
+            return;
+        }
+
+        int index = (int)(identity - m_dwarf->typeIdentities);
+
+        if (m_states[index] == InProgress)
+        {
+            hash.add('B');
+            hash.add(m_depth - m_depths[index]);
+            m_lowestBackReference = qMin(m_lowestBackReference, m_depths[index]);
+            return;
+        }
+
+        hash.add('S');
+        hash.add(hashType(identity));
+    }
+};
+
+// Structural comparison of two type entries, following the same rules as
+// TypeHasher. Hashes only pick the candidates, two types are merged only if
+// this says they're the same. Pairs that are still being compared further up
+// are assumed to be equal, so cycles compare equal if everything else does.
+class TypeComparer
+{
+public:
+    TypeComparer(Dwarf* dwarf)
+        : m_dwarf(dwarf)
+        , m_equal()
+        , m_assumed()
+    {
+    }
+
+    bool equalTypes(const DwarfEntry* a, const DwarfEntry* b)
+    {
+        m_assumed.clear();
+
+        if (!equalType(a, b))
+        {
+            return false;
+        }
+
+        // everything assumed on the way turned out to hold
+        for (quint64 pair : m_assumed)
+        {
+            m_equal.insert(pair);
+        }
+
+        return true;
+    }
+
+private:
+    Dwarf* m_dwarf;
+    QSet<quint64> m_equal;
+    QSet<quint64> m_assumed;
+
+    bool equalType(const DwarfEntry* a, const DwarfEntry* b)
+    {
+        if (a == b)
+        {
+            return true;
+        }
+
+        quint64 pair = ((quint64)a->offset << 32) | (quint64)b->offset;
+
+        if (m_equal.contains(pair) || m_assumed.contains(pair))
+        {
+            return true;
+        }
+
+        m_assumed.insert(pair);
+
+        return equalEntries(a, b);
+    }
+
+    static const DwarfEntry* nextChild(const DwarfEntry* child)
+    {
+        while (child && (child->isNull() || child->tag == DW_TAG_padding))
+        {
+            child = child->sibling;
+        }
+
+        return child;
+    }
+
+    static int nextAttribute(const DwarfEntry* entry, int index)
+    {
+        while (index < entry->attributeCount && entry->attributes[index].name == DW_AT_sibling)
+        {
+            index++;
+        }
+
+        return index;
+    }
+
+    bool equalEntries(const DwarfEntry* a, const DwarfEntry* b)
+    {
+        if (a->tag != b->tag)
+        {
+            return false;
+        }
+
+        int i = nextAttribute(a, 0);
+        int j = nextAttribute(b, 0);
+
+        while (i < a->attributeCount && j < b->attributeCount)
+        {
+            if (!equalAttributes(&a->attributes[i], &b->attributes[j]))
+            {
+                return false;
+            }
+
+            i = nextAttribute(a, i + 1);
+            j = nextAttribute(b, j + 1);
+        }
+
+        if (i < a->attributeCount || j < b->attributeCount)
+        {
+            return false;
+        }
+
+        const DwarfEntry* childA = nextChild(a->firstChild);
+        const DwarfEntry* childB = nextChild(b->firstChild);
+
+        while (childA && childB)
+        {
+            if (!equalEntries(childA, childB))
+            {
+                return false;
+            }
+
+            childA = nextChild(childA->sibling);
+            childB = nextChild(childB->sibling);
+        }
+
+        return !childA && !childB;
+    }
+
+    bool equalAttributes(DwarfAttribute* a, DwarfAttribute* b)
+    {
+        if (a->name != b->name)
+        {
+            return false;
+        }
+
+        switch (a->name)
+        {
+        case DW_AT_fund_type:
+        case DW_AT_mod_fund_type:
+        case DW_AT_user_def_type:
+        case DW_AT_mod_u_d_type:
+        {
+            DwarfType typeA;
+            DwarfType typeB;
+            typeA.read(m_dwarf, a);
+            typeB.read(m_dwarf, b);
+            return equalDwarfTypes(typeA, typeB);
+        }
+        case DW_AT_subscr_data:
+        {
+            const DwarfSubscriptData* dataA = m_dwarf->findSubscriptData(a);
+            const DwarfSubscriptData* dataB = m_dwarf->findSubscriptData(b);
+
+            if (!dataA || !dataB)
+            {
+                return !dataA && !dataB;
+            }
+
+            if (dataA->itemCount != dataB->itemCount || !equalDwarfTypes(dataA->elementType, dataB->elementType))
+            {
+                return false;
+            }
+
+            for (int i = 0; i < dataA->itemCount; i++)
+            {
+                const DwarfSubscriptDataItem& itemA = dataA->items[i];
+                const DwarfSubscriptDataItem& itemB = dataB->items[i];
+
+                if (!equalDwarfTypes(itemA.indexType, itemB.indexType)
+                    || !equalBounds(itemA.lowBound, itemB.lowBound)
+                    || !equalBounds(itemA.highBound, itemB.highBound))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+        }
+
+        switch (a->getForm())
+        {
+        case DW_FORM_ADDR:
+            return a->addr == b->addr;
+        case DW_FORM_REF:
+            return equalTypeReferences(a->ref, b->ref, true);
+        case DW_FORM_BLOCK2:
+        case DW_FORM_BLOCK4:
+            return a->blockLength == b->blockLength && memcmp(a->block, b->block, a->blockLength) == 0;
+        case DW_FORM_DATA2:
+            return a->data2 == b->data2;
+        case DW_FORM_DATA4:
+            return a->data4 == b->data4;
+        case DW_FORM_DATA8:
+            return a->data8 == b->data8;
+        case DW_FORM_STRING:
+            return strcmp(a->string, b->string) == 0;
+        }
+
+        return true;
+    }
+
+    bool equalDwarfTypes(const DwarfType& a, const DwarfType& b)
+    {
+        if (a.isFundamental != b.isFundamental || a.modifierCount != b.modifierCount
+            || memcmp(a.modifiers, b.modifiers, a.modifierCount) != 0)
+        {
+            return false;
+        }
+
+        if (a.isFundamental)
+        {
+            return a.fundType == b.fundType;
+        }
+
+        bool isIndirect = false;
+
+        for (int i = 0; i < a.modifierCount; i++)
+        {
+            if (a.modifiers[i] == DW_MOD_pointer_to || a.modifiers[i] == DW_MOD_reference_to)
+            {
+                isIndirect = true;
+            }
+        }
+
+        return equalTypeReferences(a.udTypeOffset, b.udTypeOffset, isIndirect);
+    }
+
+    bool equalBounds(const DwarfSubscriptDataBound& a, const DwarfSubscriptDataBound& b)
+    {
+        if (a.isConstant != b.isConstant || a.constant != b.constant || a.atomCount != b.atomCount)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < a.atomCount; i++)
+        {
+            if (a.atoms[i].op != b.atoms[i].op || a.atoms[i].number != b.atoms[i].number)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool equalTypeReferences(Elf32_Off offsetA, Elf32_Off offsetB, bool isIndirect)
+    {
+        DwarfEntry* targetA = m_dwarf->findEntry(offsetA);
+        DwarfEntry* targetB = m_dwarf->findEntry(offsetB);
+
+        if (!targetA || !targetB)
+        {
+            return !targetA && !targetB;
+        }
+
+        const char* nameA = targetA->getName();
+        const char* nameB = targetB->getName();
+        bool byNameA = !m_dwarf->findTypeIdentity(targetA) || (isIndirect && *nameA);
+        bool byNameB = !m_dwarf->findTypeIdentity(targetB) || (isIndirect && *nameB);
+
+        if (byNameA != byNameB)
+        {
+            return false;
+        }
+
+        if (byNameA)
+        {
+            return targetA->tag == targetB->tag && strcmp(nameA, nameB) == 0;
+        }
+
+        return equalType(targetA, targetB);
+    }
+};
+
+// Finds identical type definitions across compile units, see DwarfTypeIdentity
+void Dwarf::hashTypes()
+{
+    TRACE_SCOPE("Dwarf::read hash types");
+
+    typeIdentityCount = 0;
+
+    for (DwarfEntry* entry = &entries[0]; entry != nullptr; entry = entry->sibling)
+    {
+        if (entry->tag == DW_TAG_compile_unit)
+        {
+            for (DwarfEntry* child = entry->firstChild; child != nullptr; child = child->sibling)
+            {
+                if (isTypeTag(child->tag))
+                {
+                    typeIdentityCount++;
+                }
+            }
+        }
+    }
+
+    if (typeIdentityCount == 0)
+    {
+        return;
+    }
+
+    typeIdentities = (DwarfTypeIdentity*)malloc(typeIdentityCount * sizeof(DwarfTypeIdentity));
+    AllocationCounter::add();
+
+    DwarfTypeIdentity* identity = typeIdentities;
+
+    for (DwarfEntry* entry = &entries[0]; entry != nullptr; entry = entry->sibling)
+    {
+        if (entry->tag == DW_TAG_compile_unit)
+        {
+            for (DwarfEntry* child = entry->firstChild; child != nullptr; child = child->sibling)
+            {
+                if (isTypeTag(child->tag))
+                {
+                    identity->entry = child;
+                    identity->hash = 0;
+                    identity->canonical = child;
+                    identity++;
+                }
+            }
+        }
+    }
+
+    TypeHasher hasher(this);
+    TypeComparer comparer(this);
+    QHash<quint64, QList<DwarfEntry*>> canonicalsByHash;
+
+    canonicalsByHash.reserve(typeIdentityCount);
+
+    for (int i = 0; i < typeIdentityCount; i++)
+    {
+        DwarfTypeIdentity& identity = typeIdentities[i];
+        QList<DwarfEntry*>& canonicals = canonicalsByHash[hasher.hashType(&identity)];
+        bool merged = false;
+
+        // a matching hash only makes it a candidate
+        for (DwarfEntry* canonical : canonicals)
+        {
+            if (comparer.equalTypes(identity.entry, canonical))
+            {
+                identity.canonical = canonical;
+                merged = true;
+                break;
+            }
+        }
+
+        if (!merged)
+        {
+            canonicals.append(identity.entry);
+        }
+    }
+}
+
 void Dwarf::destroy()
 {
     if (internalData)
@@ -435,7 +1315,18 @@ void Dwarf::destroy()
         free(internalData);
     }
 
+    if (blockData)
+    {
+        free(blockData);
+    }
+
+    if (typeIdentities)
+    {
+        free(typeIdentities);
+    }
+
     internalData = nullptr;
+    blockData = nullptr;
     elf = nullptr;
     entries = nullptr;
     entryCount = 0;
@@ -443,6 +1334,89 @@ void Dwarf::destroy()
     attributeCount = 0;
     sourceStatementTables = nullptr;
     sourceStatementTableCount = 0;
+    sourceStatementEntries = nullptr;
+    sourceStatementEntryCount = 0;
+    locations = nullptr;
+    locationCount = 0;
+    subscriptData = nullptr;
+    subscriptDataCount = 0;
+    elementLists = nullptr;
+    elementListCount = 0;
+    locationAtoms = nullptr;
+    locationAtomCount = 0;
+    subscriptDataItems = nullptr;
+    subscriptDataItemCount = 0;
+    elementListItems = nullptr;
+    elementListItemCount = 0;
+    typeIdentities = nullptr;
+    typeIdentityCount = 0;
+}
+
+MemoryUsage Dwarf::memoryUsage() const
+{
+    MemoryUsage usage("DWARF");
+    usage.add("Entries", entryCount * (qint64)sizeof(DwarfEntry));
+    usage.add("Attributes", attributeCount * (qint64)sizeof(DwarfAttribute));
+    usage.add("Source statement tables", sourceStatementTableCount * (qint64)sizeof(DwarfSourceStatementTable));
+    usage.add("Source statement entries", sourceStatementEntryCount * (qint64)sizeof(DwarfSourceStatementEntry));
+
+    MemoryUsage& blocks = usage.add("Decoded blocks");
+    blocks.add("Compiled locations", locationCount * (qint64)sizeof(DwarfCompiledLocation));
+    blocks.add("Subscript data", subscriptDataCount * (qint64)sizeof(DwarfSubscriptData)
+        + subscriptDataItemCount * (qint64)sizeof(DwarfSubscriptDataItem));
+    blocks.add("Element lists", elementListCount * (qint64)sizeof(DwarfElementList)
+        + elementListItemCount * (qint64)sizeof(DwarfElementListItem));
+    blocks.add("Location atoms", locationAtomCount * (qint64)sizeof(DwarfLocationAtom));
+
+    usage.add("Type identities", typeIdentityCount * (qint64)sizeof(DwarfTypeIdentity));
+
+    return usage;
+}
+
+DwarfEntry* Dwarf::findEntry(Elf32_Off offset) const
+{
+    return findByOffset(entries, entryCount, offset);
+}
+
+DwarfSourceStatementTable* Dwarf::findSourceStatementTable(Elf32_Off offset) const
+{
+    return findByOffset(sourceStatementTables, sourceStatementTableCount, offset);
+}
+
+const DwarfCompiledLocation* Dwarf::findLocation(const DwarfAttribute* attribute) const
+{
+    return findByAttribute(locations, locationCount, attribute);
+}
+
+const DwarfSubscriptData* Dwarf::findSubscriptData(const DwarfAttribute* attribute) const
+{
+    return findByAttribute(subscriptData, subscriptDataCount, attribute);
+}
+
+const DwarfElementList* Dwarf::findElementList(const DwarfAttribute* attribute) const
+{
+    return findByAttribute(elementLists, elementListCount, attribute);
+}
+
+const DwarfTypeIdentity* Dwarf::findTypeIdentity(const DwarfEntry* entry) const
+{
+    const DwarfTypeIdentity* end = typeIdentities + typeIdentityCount;
+    const DwarfTypeIdentity* identity = std::lower_bound((const DwarfTypeIdentity*)typeIdentities, end, entry,
+        [](const DwarfTypeIdentity& i, const DwarfEntry* e) { return i.entry < e; });
+
+    if (identity != end && identity->entry == entry)
+    {
+        return identity;
+    }
+
+    return nullptr;
+}
+
+DwarfEntry* Dwarf::canonicalType(DwarfEntry* entry) const
+{
+    const DwarfTypeIdentity* identity = findTypeIdentity(entry);
+
+    return identity ? identity->canonical : entry;
 }
 
 void Dwarf::readAttribute(char*& data, DwarfAttribute* attribute)
@@ -452,7 +1426,8 @@ void Dwarf::readAttribute(char*& data, DwarfAttribute* attribute)
 
 const char* Dwarf::tagToString(Elf32_Half tag)
 {
-    static char defaultString[32];
+    // thread_local so names of unknown values can be made on any thread
+    static thread_local char defaultString[32];
 
     switch (tag)
     {
@@ -496,7 +1471,8 @@ const char* Dwarf::tagToString(Elf32_Half tag)
 
 const char* Dwarf::formToString(Elf32_Half form)
 {
-    static char defaultString[32];
+    // thread_local so names of unknown values can be made on any thread
+    static thread_local char defaultString[32];
 
     switch (form)
     {
@@ -516,7 +1492,8 @@ const char* Dwarf::formToString(Elf32_Half form)
 
 const char* Dwarf::attrNameToString(Elf32_Half name)
 {
-    static char defaultString[32];
+    // thread_local so names of unknown values can be made on any thread
+    static thread_local char defaultString[32];
 
     switch (name)
     {
@@ -199,6 +199,12 @@
 #define DW_SOURCE_NO_POS 0xffff
 
 struct DwarfEntry;
+struct DwarfLocationAtom;
+struct DwarfCompiledLocation;
+struct DwarfSubscriptData;
+struct DwarfSubscriptDataItem;
+struct DwarfElementList;
+struct DwarfElementListItem;
 
 struct DwarfAttribute
 {
@@ -256,10 +262,25 @@ struct DwarfSourceStatementTable
     int entryCount;
 };
 
+// Structural identity of a type entry directly inside a compile unit.
+// Identical definitions of a type emitted into different compile units get
+// the same hash. Those that also compare equal entry by entry point at the
+// first one as canonical.
+struct DwarfTypeIdentity
+{
+    DwarfEntry* entry;
+    quint64 hash;
+    DwarfEntry* canonical;
+};
+
 struct Dwarf
 {
 private:
     void* internalData;
+    void* blockData;
+
+    void readBlocks();
+    void hashTypes();
 
 public:
     const Elf* elf;
@@ -272,6 +293,26 @@ public:
     DwarfSourceStatementEntry* sourceStatementEntries;
     int sourceStatementEntryCount;
 
+    // decoded block attributes, sorted by attribute
+    DwarfCompiledLocation* locations;
+    int locationCount;
+    DwarfSubscriptData* subscriptData;
+    int subscriptDataCount;
+    DwarfElementList* elementLists;
+    int elementListCount;
+
+    // storage the decoded blocks point into
+    DwarfLocationAtom* locationAtoms;
+    int locationAtomCount;
+    DwarfSubscriptDataItem* subscriptDataItems;
+    int subscriptDataItemCount;
+    DwarfElementListItem* elementListItems;
+    int elementListItemCount;
+
+    // sorted by entry
+    DwarfTypeIdentity* typeIdentities;
+    int typeIdentityCount;
+
     enum ReadResult
     {
         ReadSuccess,
@@ -280,6 +321,14 @@ public:
 
     ReadResult read(const Elf* elf);
     void destroy();
+    MemoryUsage memoryUsage() const;
+    DwarfEntry* findEntry(Elf32_Off offset) const;
+    DwarfSourceStatementTable* findSourceStatementTable(Elf32_Off offset) const;
+    const DwarfCompiledLocation* findLocation(const DwarfAttribute* attribute) const;
+    const DwarfSubscriptData* findSubscriptData(const DwarfAttribute* attribute) const;
+    const DwarfElementList* findElementList(const DwarfAttribute* attribute) const;
+    const DwarfTypeIdentity* findTypeIdentity(const DwarfEntry* entry) const;
+    DwarfEntry* canonicalType(DwarfEntry* entry) const;
 
     void readAttribute(char*& data, DwarfAttribute* attribute);
 
@@ -16,6 +16,24 @@ static const char* readString(char*& data)
     return str;
 }
 
+static void readLocationAtom(const Elf* elf, char*& data, DwarfLocationAtom& atom)
+{
+    atom.op = elf->read<char>(data);
+    atom.number = 0;
+
+    switch (atom.op)
+    {
+    case DW_OP_REG:
+    case DW_OP_BASEREG:
+    case DW_OP_CONST:
+        atom.number = elf->read<Elf32_Word>(data);
+        break;
+    case DW_OP_ADDR:
+        atom.addr = elf->read<Elf32_Addr>(data);
+        break;
+    }
+}
+
 void DwarfLocation::read(Dwarf* dwarf, DwarfAttribute* attribute)
 {
     Q_ASSERT(attribute->name == DW_AT_location);
@@ -26,22 +44,266 @@ void DwarfLocation::read(Dwarf* dwarf, DwarfAttribute* attribute)
     while (data < end)
     {
         DwarfLocationAtom atom;
-        atom.op = dwarf->elf->read<char>(data);
+        readLocationAtom(dwarf->elf, data, atom);
+        atoms.push_back(atom);
+    }
+}
 
-        switch (atom.op)
+DwarfCompiledLocation DwarfLocation::compile() const
+{
+    DwarfCompiledLocation location;
+    location.attribute = nullptr;
+    location.compile(atoms.data(), atoms.size());
+    return location;
+}
+
+int DwarfLocation::countAtoms(const Elf* elf, char* block, Elf32_Word blockLength)
+{
+    char* data = block;
+    char* end = data + blockLength;
+    int count = 0;
+
+    while (data < end)
+    {
+        DwarfLocationAtom atom;
+        readLocationAtom(elf, data, atom);
+        count++;
+    }
+
+    return count;
+}
+
+int DwarfLocation::readAtoms(const Elf* elf, char* block, Elf32_Word blockLength, DwarfLocationAtom* atoms)
+{
+    char* data = block;
+    char* end = data + blockLength;
+    int count = 0;
+
+    while (data < end)
+    {
+        readLocationAtom(elf, data, atoms[count]);
+        count++;
+    }
+
+    return count;
+}
+
+void DwarfCompiledLocation::compile(const DwarfLocationAtom* atoms, int atomCount)
+{
+    this->atoms = atoms;
+    this->atomCount = atomCount;
+
+    kind = Program;
+    reg = 0;
+    offset = 0;
+    address = 0;
+
+    if (atomCount == 0)
+    {
+        kind = Empty;
+    }
+    else if (atomCount == 1)
+    {
+        switch (atoms[0].op)
         {
         case DW_OP_REG:
+            kind = Register;
+            reg = atoms[0].number;
+            break;
         case DW_OP_BASEREG:
+            kind = BaseOffset;
+            reg = atoms[0].number;
+            break;
+        case DW_OP_ADDR:
+            kind = Address;
+            address = atoms[0].addr;
+            break;
         case DW_OP_CONST:
-            atom.number = dwarf->elf->read<Elf32_Word>(data);
+            kind = Address;
+            address = atoms[0].number;
+            break;
+        }
+    }
+    else if (atomCount == 2)
+    {
+        // Member location, relative to the containing object
+        if (atoms[0].op == DW_OP_CONST && atoms[1].op == DW_OP_ADD)
+        {
+            kind = BaseOffset;
+            reg = ObjectBase;
+            offset = (Elf32_Sword)atoms[0].number;
+        }
+    }
+    else if (atomCount == 3)
+    {
+        if (atoms[1].op == DW_OP_CONST && atoms[2].op == DW_OP_ADD)
+        {
+            if (atoms[0].op == DW_OP_BASEREG)
+            {
+                kind = BaseOffset;
+                reg = atoms[0].number;
+                offset = (Elf32_Sword)atoms[1].number;
+            }
+            else if (atoms[0].op == DW_OP_ADDR)
+            {
+                kind = Address;
+                address = atoms[0].addr + atoms[1].number;
+            }
+        }
+    }
+}
+
+bool DwarfCompiledLocation::evaluate(const DwarfLocationContext& context, DwarfLocationValue& result) const
+{
+    auto readRegister = [&](Elf32_Word index, Elf32_Word& value)
+    {
+        if (!context.registers || index >= (Elf32_Word)context.registerCount)
+        {
+            return false;
+        }
+
+        value = context.registers[index];
+        return true;
+    };
+
+    result.isRegister = false;
+    result.value = 0;
+
+    switch (kind)
+    {
+    case Empty:
+        return false;
+    case Register:
+        result.isRegister = true;
+        result.value = reg;
+        return true;
+    case BaseOffset:
+    {
+        Elf32_Word base = context.objectAddress;
+
+        if (reg != ObjectBase && !readRegister(reg, base))
+        {
+            return false;
+        }
+
+        result.value = base + offset;
+        return true;
+    }
+    case Address:
+        result.value = address;
+        return true;
+    case Program:
+        break;
+    }
+
+    // The stack starts out with the address of the containing object, which
+    // is only used by member locations
+    Elf32_Word stack[16];
+    int stackSize = 0;
+
+    stack[stackSize++] = context.objectAddress;
+
+    for (int i = 0; i < atomCount; i++)
+    {
+        const DwarfLocationAtom& atom = atoms[i];
+        Elf32_Word value;
+
+        switch (atom.op)
+        {
+        case DW_OP_REG:
+            if (atomCount == 1)
+            {
+                result.isRegister = true;
+                result.value = atom.number;
+                return true;
+            }
+
+            // fall through, a register inside a larger expression is read
+        case DW_OP_BASEREG:
+            if (!readRegister(atom.number, value) || stackSize == 16)
+            {
+                return false;
+            }
+
+            stack[stackSize++] = value;
             break;
         case DW_OP_ADDR:
-            atom.addr = dwarf->elf->read<Elf32_Addr>(data);
+        case DW_OP_CONST:
+            if (stackSize == 16)
+            {
+                return false;
+            }
+
+            stack[stackSize++] = atom.number;
+            break;
+        case DW_OP_DEREF2:
+        case DW_OP_DEREF:
+            if (!context.readMemory
+                || !context.readMemory(context.userData, stack[stackSize - 1], atom.op == DW_OP_DEREF2 ? 2 : 4, value))
+            {
+                return false;
+            }
+
+            stack[stackSize - 1] = value;
             break;
+        case DW_OP_ADD:
+            if (stackSize < 2)
+            {
+                return false;
+            }
+
+            stack[stackSize - 2] += stack[stackSize - 1];
+            stackSize--;
+            break;
+        default:
+            return false;
         }
+    }
 
-        atoms.push_back(atom);
+    result.value = stack[stackSize - 1];
+    return true;
+}
+
+bool DwarfCompiledLocation::findConstant(Elf32_Word& constant) const
+{
+    if (kind == BaseOffset && reg == ObjectBase)
+    {
+        constant = offset;
+        return true;
     }
+
+    for (int i = 0; i < atomCount; i++)
+    {
+        if (atoms[i].op == DW_OP_CONST)
+        {
+            constant = atoms[i].number;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool DwarfCompiledLocation::findAddress(Elf32_Addr& address) const
+{
+    bool found = false;
+
+    if (kind == Address)
+    {
+        address = this->address;
+        return true;
+    }
+
+    for (int i = 0; i < atomCount; i++)
+    {
+        if (atoms[i].op == DW_OP_ADDR)
+        {
+            address = atoms[i].addr;
+            found = true;
+        }
+    }
+
+    return found;
 }
 
 void DwarfType::read(Dwarf* dwarf, DwarfAttribute* attribute)
@@ -51,6 +313,9 @@ void DwarfType::read(Dwarf* dwarf, DwarfAttribute* attribute)
         || attribute->name == DW_AT_mod_fund_type
         || attribute->name == DW_AT_mod_u_d_type);
 
+    modifiers = nullptr;
+    modifierCount = 0;
+
     if (attribute->name == DW_AT_fund_type)
     {
         isFundamental = true;
@@ -67,15 +332,11 @@ void DwarfType::read(Dwarf* dwarf, DwarfAttribute* attribute)
 
         Q_ASSERT(attribute->blockLength >= sizeof(Elf32_Half));
 
-        char* data = attribute->block;
-        char* typeData = data + attribute->blockLength - sizeof(Elf32_Half);
-
-        while (data < typeData)
-        {
-            char modifier = dwarf->elf->read<char>(data);
-            modifiers.push_back(modifier);
-        }
+        // modifiers are single bytes, so they can be used straight from the block
+        modifiers = attribute->block;
+        modifierCount = attribute->blockLength - sizeof(Elf32_Half);
 
+        char* data = attribute->block + modifierCount;
         fundType = dwarf->elf->read<Elf32_Half>(data);
     }
     else if (attribute->name == DW_AT_mod_u_d_type)
@@ -84,26 +345,56 @@ void DwarfType::read(Dwarf* dwarf, DwarfAttribute* attribute)
 
         Q_ASSERT(attribute->blockLength >= sizeof(Elf32_Word));
 
-        char* data = attribute->block;
-        char* typeData = data + attribute->blockLength - sizeof(Elf32_Word);
+        modifiers = attribute->block;
+        modifierCount = attribute->blockLength - sizeof(Elf32_Word);
 
-        while (data < typeData)
+        char* data = attribute->block + modifierCount;
+        udTypeOffset = dwarf->elf->read<Elf32_Off>(data);
+    }
+}
+
+static void readSubscriptDataBound(const Elf* elf, char*& data, bool isLocation, DwarfSubscriptDataBound& bound, DwarfLocationAtom* atoms)
+{
+    bound.atoms = nullptr;
+    bound.atomCount = 0;
+
+    if (isLocation)
+    {
+        bound.isConstant = false;
+
+        Elf32_Half blockLength = elf->read<Elf32_Half>(data);
+
+        if (atoms)
+        {
+            bound.atoms = atoms;
+            bound.atomCount = DwarfLocation::readAtoms(elf, data, blockLength, atoms);
+        }
+        else
         {
-            char modifier = dwarf->elf->read<char>(data);
-            modifiers.push_back(modifier);
+            bound.atomCount = DwarfLocation::countAtoms(elf, data, blockLength);
         }
 
-        udTypeOffset = dwarf->elf->read<Elf32_Off>(data);
+        data += blockLength;
+    }
+    else
+    {
+        bound.isConstant = true;
+        bound.constant = elf->read<Elf32_Word>(data);
     }
 }
 
-void DwarfSubscriptData::read(Dwarf* dwarf, DwarfAttribute* attribute)
+// Walks a subscript data block. If itemData is null, items and bound atoms
+// are only counted.
+static int readSubscriptData(Dwarf* dwarf, DwarfAttribute* attribute, DwarfType* elementType, DwarfSubscriptDataItem* itemData, DwarfLocationAtom* atomData, int& atomCount)
 {
     Q_ASSERT(attribute->name == DW_AT_subscr_data);
 
     char* data = attribute->block;
     char* end = data + attribute->blockLength;
 
+    int itemCount = 0;
+    atomCount = 0;
+
     while (data < end)
     {
         char format = dwarf->elf->read<char>(data);
@@ -111,13 +402,19 @@ void DwarfSubscriptData::read(Dwarf* dwarf, DwarfAttribute* attribute)
         if (format == DW_FMT_ET)
         {
             // Read type attribute
-            DwarfAttribute attribute;
-            dwarf->readAttribute(data, &attribute);
-            elementType.read(dwarf, &attribute);
+            DwarfAttribute typeAttribute;
+            dwarf->readAttribute(data, &typeAttribute);
+
+            if (elementType)
+            {
+                elementType->read(dwarf, &typeAttribute);
+            }
         }
         else
         {
             DwarfSubscriptDataItem item;
+            item.indexType.modifiers = nullptr;
+            item.indexType.modifierCount = 0;
 
             // Read format specifier
             if (format & 0x4) // User-defined type
@@ -131,60 +428,83 @@ void DwarfSubscriptData::read(Dwarf* dwarf, DwarfAttribute* attribute)
                 item.indexType.fundType = dwarf->elf->read<Elf32_Half>(data);
             }
 
-            // Read low bound
-            if (format & 0x2) // Location
-            {
-                item.lowBound.isConstant = false;
+            // Read low bound, then high bound
+            readSubscriptDataBound(dwarf->elf, data, format & 0x2, item.lowBound, itemData ? atomData + atomCount : nullptr);
+            atomCount += item.lowBound.atomCount;
 
-                DwarfAttribute attribute;
-                attribute.name = DW_AT_location;
-                attribute.blockLength = dwarf->elf->read<Elf32_Half>(data);
-                attribute.block = data;
+            readSubscriptDataBound(dwarf->elf, data, format & 0x1, item.highBound, itemData ? atomData + atomCount : nullptr);
+            atomCount += item.highBound.atomCount;
 
-                item.lowBound.location.read(dwarf, &attribute);
-            }
-            else // Constant
+            if (itemData)
             {
-                item.lowBound.isConstant = true;
-                item.lowBound.constant = dwarf->elf->read<Elf32_Word>(data);
+                itemData[itemCount] = item;
             }
 
-            // Read high bound
-            if (format & 0x1) // Location
-            {
-                item.highBound.isConstant = false;
+            itemCount++;
+        }
+    }
 
-                DwarfAttribute attribute;
-                attribute.name = DW_AT_location;
-                attribute.blockLength = dwarf->elf->read<Elf32_Half>(data);
-                attribute.block = data;
+    return itemCount;
+}
 
-                item.highBound.location.read(dwarf, &attribute);
-            }
-            else // Constant
-            {
-                item.highBound.isConstant = true;
-                item.highBound.constant = dwarf->elf->read<Elf32_Word>(data);
-            }
+int DwarfSubscriptData::count(Dwarf* dwarf, DwarfAttribute* attribute, int& atomCount)
+{
+    return readSubscriptData(dwarf, attribute, nullptr, nullptr, nullptr, atomCount);
+}
 
-            items.push_back(item);
-        }
+int DwarfSubscriptData::read(Dwarf* dwarf, DwarfAttribute* attribute, DwarfSubscriptDataItem* itemData, DwarfLocationAtom* atomData)
+{
+    this->attribute = attribute;
+
+    elementType.isFundamental = true;
+    elementType.fundType = 0;
+    elementType.modifiers = nullptr;
+    elementType.modifierCount = 0;
+
+    int atomCount = 0;
+
+    items = itemData;
+    itemCount = readSubscriptData(dwarf, attribute, &elementType, itemData, atomData, atomCount);
+
+    return atomCount;
+}
+
+int DwarfElementList::count(Dwarf* dwarf, DwarfAttribute* attribute)
+{
+    Q_ASSERT(attribute->name == DW_AT_element_list);
+
+    char* data = attribute->block;
+    char* end = data + attribute->blockLength;
+
+    int itemCount = 0;
+
+    while (data < end)
+    {
+        data += sizeof(Elf32_Word);
+        readString(data);
+
+        itemCount++;
     }
+
+    return itemCount;
 }
 
-void DwarfElementList::read(Dwarf* dwarf, DwarfAttribute* attribute)
+void DwarfElementList::read(Dwarf* dwarf, DwarfAttribute* attribute, DwarfElementListItem* itemData)
 {
     Q_ASSERT(attribute->name == DW_AT_element_list);
 
+    this->attribute = attribute;
+    items = itemData;
+    itemCount = 0;
+
     char* data = attribute->block;
     char* end = data + attribute->blockLength;
 
     while (data < end)
     {
-        DwarfElementListItem item;
+        DwarfElementListItem& item = itemData[itemCount++];
         item.value = dwarf->elf->read<Elf32_Word>(data);
         item.name = readString(data);
-
-        items.push_back(item);
+        item.nameLength = (int)(data - item.name) - 1;
     }
 }
@@ -1,8 +1,7 @@
 #pragma once
 
 #include "Dwarf.h"
-
-#include <vector>
+#include "SmallVector.h"
 
 struct DwarfLocationAtom
 {
@@ -15,11 +14,61 @@ struct DwarfLocationAtom
     };
 };
 
+struct DwarfLocationValue
+{
+    bool isRegister;
+    Elf32_Word value;
+};
+
+// Register and memory state a location is evaluated against. readMemory may
+// be null if the location does not dereference anything.
+struct DwarfLocationContext
+{
+    typedef bool(*ReadMemoryCallback)(const void* userData, Elf32_Addr address, int size, Elf32_Word& value);
+
+    const Elf32_Word* registers;
+    int registerCount;
+    Elf32_Addr objectAddress;
+    ReadMemoryCallback readMemory;
+    const void* userData;
+};
+
+struct DwarfCompiledLocation
+{
+    enum Kind
+    {
+        Empty,
+        Register, // value lives in register reg
+        BaseOffset, // value lives at reg + offset, or object + offset if reg is ObjectBase
+        Address, // value lives at a fixed address
+        Program // anything else, only evaluated atom by atom
+    };
+
+    static constexpr Elf32_Word ObjectBase = 0xFFFFFFFF;
+
+    const DwarfAttribute* attribute;
+    Kind kind;
+    Elf32_Word reg;
+    Elf32_Sword offset;
+    Elf32_Addr address;
+    const DwarfLocationAtom* atoms;
+    int atomCount;
+
+    void compile(const DwarfLocationAtom* atoms, int atomCount);
+    bool evaluate(const DwarfLocationContext& context, DwarfLocationValue& result) const;
+    bool findConstant(Elf32_Word& constant) const;
+    bool findAddress(Elf32_Addr& address) const;
+};
+
 struct DwarfLocation
 {
-    std::vector<DwarfLocationAtom> atoms;
+    SmallVector<DwarfLocationAtom, 4> atoms;
 
     void read(Dwarf* dwarf, DwarfAttribute* attribute);
+    DwarfCompiledLocation compile() const;
+
+    static int countAtoms(const Elf* elf, char* block, Elf32_Word blockLength);
+    static int readAtoms(const Elf* elf, char* block, Elf32_Word blockLength, DwarfLocationAtom* atoms);
 };
 
 struct DwarfType
@@ -32,7 +81,9 @@ struct DwarfType
         Elf32_Off udTypeOffset;
     };
 
-    std::vector<char> modifiers;
+    // points into the attribute block, in DWARF order
+    const char* modifiers;
+    int modifierCount;
 
     void read(Dwarf* dwarf, DwarfAttribute* attribute);
 };
@@ -41,7 +92,8 @@ struct DwarfSubscriptDataBound
 {
     bool isConstant;
     Elf32_Word constant;
-    DwarfLocation location;
+    const DwarfLocationAtom* atoms;
+    int atomCount;
 };
 
 struct DwarfSubscriptDataItem
@@ -51,23 +103,32 @@ struct DwarfSubscriptDataItem
     DwarfSubscriptDataBound highBound;
 };
 
+// Decoded once per DW_AT_subscr_data attribute by Dwarf::read, see Dwarf::findSubscriptData
 struct DwarfSubscriptData
 {
+    const DwarfAttribute* attribute;
     DwarfType elementType;
-    std::vector<DwarfSubscriptDataItem> items;
+    const DwarfSubscriptDataItem* items;
+    int itemCount;
 
-    void read(Dwarf* dwarf, DwarfAttribute* attribute);
+    static int count(Dwarf* dwarf, DwarfAttribute* attribute, int& atomCount);
+    int read(Dwarf* dwarf, DwarfAttribute* attribute, DwarfSubscriptDataItem* itemData, DwarfLocationAtom* atomData);
 };
 
 struct DwarfElementListItem
 {
     const char* name;
+    int nameLength;
     int value;
 };
 
+// Decoded once per DW_AT_element_list attribute by Dwarf::read, see Dwarf::findElementList
 struct DwarfElementList
 {
-    std::vector<DwarfElementListItem> items;
+    const DwarfAttribute* attribute;
+    const DwarfElementListItem* items;
+    int itemCount;
 
-    void read(Dwarf* dwarf, DwarfAttribute* attribute);
-};
\ No newline at end of file
+    static int count(Dwarf* dwarf, DwarfAttribute* attribute);
+    void read(Dwarf* dwarf, DwarfAttribute* attribute, DwarfElementListItem* itemData);
+};
@@ -2,16 +2,19 @@
 
 #include "Util.h"
 #include "DwarfAttributes.h"
+#include "Trace.h"
 
-static QString locationToString(Dwarf* dwarf, DwarfAttribute* attribute)
-{
-    DwarfLocation location;
-    location.read(dwarf, attribute);
+// Upper bound for the display string cache, in characters
+#define MAX_DISPLAY_CACHE_COST (4 * 1024 * 1024)
 
+static QString atomsToString(const DwarfLocationAtom* atoms, int atomCount)
+{
     QStringList text;
 
-    for (DwarfLocationAtom& atom : location.atoms)
+    for (int i = 0; i < atomCount; i++)
     {
+        const DwarfLocationAtom& atom = atoms[i];
+
         switch (atom.op)
         {
         case DW_OP_REG:
@@ -44,38 +47,215 @@ static QString locationToString(Dwarf* dwarf, DwarfAttribute* attribute)
     return text.join(" ");
 }
 
-static DwarfModelItem* getSiblingItem(DwarfModelItem* item, int index)
+static QString locationToString(Dwarf* dwarf, DwarfAttribute* attribute)
+{
+    const DwarfCompiledLocation* location = dwarf->findLocation(attribute);
+
+    if (!location)
+    {
+        return QString();
+    }
+
+    return atomsToString(location->atoms, location->atomCount);
+}
+
+static QString fundTypeToString(Elf32_Half fundType)
+{
+    switch (fundType)
+    {
+    case DW_FT_char: return "FT_char";
+    case DW_FT_signed_char: return "FT_signed_char";
+    case DW_FT_unsigned_char: return "FT_unsigned_char";
+    case DW_FT_short: return "FT_short";
+    case DW_FT_signed_short: return "FT_signed_short";
+    case DW_FT_unsigned_short: return "FT_unsigned_short";
+    case DW_FT_integer: return "FT_integer";
+    case DW_FT_signed_integer: return "FT_signed_integer";
+    case DW_FT_unsigned_integer: return "FT_unsigned_integer";
+    case DW_FT_long: return "FT_long";
+    case DW_FT_signed_long: return "FT_signed_long";
+    case DW_FT_unsigned_long: return "FT_unsigned_long";
+    case DW_FT_pointer: return "FT_pointer";
+    case DW_FT_float: return "FT_float";
+    case DW_FT_dbl_prec_float: return "FT_dbl_prec_float";
+    case DW_FT_ext_prec_float: return "FT_ext_prec_float";
+    case DW_FT_complex: return "FT_complex";
+    case DW_FT_dbl_prec_complex: return "FT_dbl_prec_complex";
+    case DW_FT_void: return "FT_void";
+    case DW_FT_boolean: return "FT_boolean";
+    case DW_FT_ext_prec_complex: return "FT_ext_prec_complex";
+    case DW_FT_label: return "FT_label";
+    }
+
+    return QString("FT_<unknown %1>").arg(Util::hexToString(fundType));
+}
+
+static QString modifierToString(char modifier)
+{
+    switch ((unsigned char)modifier)
+    {
+    case DW_MOD_pointer_to: return "MOD_pointer_to";
+    case DW_MOD_reference_to: return "MOD_reference_to";
+    case DW_MOD_const: return "MOD_const";
+    case DW_MOD_volatile: return "MOD_volatile";
+    }
+
+    return QString("MOD_<unknown %1>").arg(Util::hexToString((unsigned char)modifier));
+}
+
+static QString typeToString(const DwarfType& type)
+{
+    QStringList text;
+
+    for (int i = 0; i < type.modifierCount; i++)
+    {
+        text += modifierToString(type.modifiers[i]);
+    }
+
+    if (type.isFundamental)
+    {
+        text += fundTypeToString(type.fundType);
+    }
+    else
+    {
+        text += QString("0x%1").arg(type.udTypeOffset, 0, 16);
+    }
+
+    return text.join(" ");
+}
+
+static QString typeAttributeToString(Dwarf* dwarf, DwarfAttribute* attribute)
+{
+    DwarfType type;
+    type.read(dwarf, attribute);
+
+    return typeToString(type);
+}
+
+static QString boundToString(const DwarfSubscriptDataBound& bound)
+{
+    if (bound.isConstant)
+    {
+        return QString("%1").arg(bound.constant);
+    }
+
+    return QString("(%1)").arg(atomsToString(bound.atoms, bound.atomCount));
+}
+
+static QString subscriptDataToString(Dwarf* dwarf, DwarfAttribute* attribute)
 {
-    for (int i = 0; i < index; i++)
+    const DwarfSubscriptData* subscriptData = dwarf->findSubscriptData(attribute);
+
+    if (!subscriptData)
+    {
+        return QString();
+    }
+
+    QStringList text;
+
+    for (int i = 0; i < subscriptData->itemCount; i++)
     {
-        item = item->e.siblingItem;
+        const DwarfSubscriptDataItem& item = subscriptData->items[i];
+        text += QString("[%1..%2 %3]").arg(boundToString(item.lowBound), boundToString(item.highBound), typeToString(item.indexType));
     }
 
-    return item;
+    text += typeToString(subscriptData->elementType);
+
+    return text.join(" ");
 }
 
-static int getSiblingCount(DwarfEntry* entry)
+static QString elementListToString(Dwarf* dwarf, DwarfAttribute* attribute)
 {
-    int count = 0;
+    const DwarfElementList* elementList = dwarf->findElementList(attribute);
+
+    if (!elementList)
+    {
+        return QString();
+    }
+
+    QStringList text;
+
+    for (int i = 0; i < elementList->itemCount; i++)
+    {
+        const DwarfElementListItem& item = elementList->items[i];
+        text += QString("%1 = %2").arg(QLatin1String(item.name, item.nameLength)).arg(item.value);
+    }
+
+    return text.join(", ");
+}
 
-    while (entry)
+// Attributes whose data has to be decoded from a block before it can be shown.
+// These are the ones worth rendering ahead of time on the render thread.
+static bool isExpensiveAttribute(const DwarfAttribute* attribute)
+{
+    switch (attribute->name)
     {
-        count++;
-        entry = entry->sibling;
+    case DW_AT_location:
+    case DW_AT_mod_fund_type:
+    case DW_AT_mod_u_d_type:
+    case DW_AT_subscr_data:
+    case DW_AT_element_list:
+        return true;
     }
 
-    return count;
+    return false;
+}
+
+// Must stay thread safe, it is also called from the render thread
+static QString attributeDataToString(Dwarf* dwarf, DwarfAttribute* attribute)
+{
+    switch (attribute->name)
+    {
+    case DW_AT_location:
+        return locationToString(dwarf, attribute);
+    case DW_AT_fund_type:
+        return fundTypeToString(attribute->data2);
+    case DW_AT_mod_fund_type:
+    case DW_AT_mod_u_d_type:
+        return typeAttributeToString(dwarf, attribute);
+    case DW_AT_subscr_data:
+        return subscriptDataToString(dwarf, attribute);
+    case DW_AT_element_list:
+        return elementListToString(dwarf, attribute);
+    }
+
+    switch (attribute->getForm())
+    {
+    case DW_FORM_ADDR:
+        return QString("0x%1").arg(attribute->addr, 8, 16, QLatin1Char('0'));
+    case DW_FORM_REF:
+        return QString("0x%1").arg(attribute->ref, 0, 16);
+    case DW_FORM_DATA2:
+        return QString("%1").arg(attribute->data2);
+    case DW_FORM_DATA4:
+        return QString("%1").arg(attribute->data4);
+    case DW_FORM_DATA8:
+        return QString("%1").arg(attribute->data8);
+    case DW_FORM_STRING:
+        return attribute->string;
+    default:
+        return QString();
+    }
 }
 
 DwarfModel::DwarfModel(QObject* parent)
     : QAbstractItemModel(parent)
     , m_dwarf(nullptr)
     , m_items(nullptr)
+    , m_childItems(nullptr)
+    , m_topLevelCount(0)
+    , m_displayCache(MAX_DISPLAY_CACHE_COST)
+    , m_renderPool()
+    , m_generation(0)
 {
+    m_renderPool.setMaxThreadCount(1);
 }
 
 DwarfModel::~DwarfModel()
 {
+    m_renderPool.clear();
+    m_renderPool.waitForDone();
+
     clearItems();
 }
 
@@ -86,6 +266,10 @@ Dwarf* DwarfModel::dwarf() const
 
 void DwarfModel::setDwarf(Dwarf* dwarf)
 {
+    // the render thread may still be reading the old DWARF
+    m_renderPool.clear();
+    m_renderPool.waitForDone();
+
     m_dwarf = dwarf;
 
     beginResetModel();
@@ -93,6 +277,22 @@ void DwarfModel::setDwarf(Dwarf* dwarf)
     endResetModel();
 }
 
+MemoryUsage DwarfModel::memoryUsage() const
+{
+    MemoryUsage usage("DWARF tree model");
+
+    if (m_items)
+    {
+        usage.add("Items", (m_dwarf->entryCount + m_dwarf->attributeCount) * (qint64)sizeof(DwarfModelItem));
+        usage.add("Child item table", m_dwarf->entryCount * (qint64)sizeof(DwarfModelItem*));
+    }
+
+    usage.add("Display cache", m_displayCache.totalCost() * (qint64)sizeof(QChar)
+        + m_displayCache.size() * (qint64)(sizeof(quint32) + sizeof(QString) + 4 * sizeof(void*)));
+
+    return usage;
+}
+
 void DwarfModel::clearItems()
 {
     if (m_items)
@@ -100,10 +300,24 @@ void DwarfModel::clearItems()
         delete[] m_items;
         m_items = nullptr;
     }
+
+    if (m_childItems)
+    {
+        delete[] m_childItems;
+        m_childItems = nullptr;
+    }
+
+    m_topLevelCount = 0;
+
+    // cache keys are item indices, which are only valid for the current items
+    m_displayCache.clear();
+    m_generation++;
 }
 
 void DwarfModel::refresh()
 {
+    TRACE_SCOPE("DwarfModel::refresh");
+
     clearItems();
 
     if (!m_dwarf)
@@ -118,6 +332,9 @@ void DwarfModel::refresh()
 
     m_items = new DwarfModelItem[m_dwarf->entryCount + m_dwarf->attributeCount];
 
+    // every entry is either top level or the child of exactly one other entry
+    m_childItems = new DwarfModelItem*[m_dwarf->entryCount];
+
     DwarfModelItem* entryItems = m_items;
     DwarfModelItem* attributeItems = m_items + m_dwarf->entryCount;
 
@@ -129,8 +346,8 @@ void DwarfModel::refresh()
         entryItem->type = DwarfModelItem::EntryItem;
         entryItem->e.entry = entry;
         entryItem->e.attributeItems = entry->attributes ? &attributeItems[entry->attributes - m_dwarf->attributes] : nullptr;
-        entryItem->e.siblingItem = entry->sibling ? &entryItems[entry->sibling - m_dwarf->entries] : nullptr;
-        entryItem->e.childItem = entry->firstChild ? &entryItems[entry->firstChild - m_dwarf->entries] : nullptr;
+        entryItem->e.childItems = nullptr;
+        entryItem->e.childCount = 0;
     }
 
     for (int i = 0; i < m_dwarf->attributeCount; i++)
@@ -142,6 +359,20 @@ void DwarfModel::refresh()
         attributeItem->a.attribute = attribute;
     }
 
+    DwarfModelItem** childItems = m_childItems;
+
+    for (DwarfEntry* entry = &m_dwarf->entries[0]; entry != nullptr; entry = entry->sibling)
+    {
+        DwarfModelItem* topLevelItem = &entryItems[entry - m_dwarf->entries];
+
+        topLevelItem->parentItem = nullptr;
+        topLevelItem->indexInParent = m_topLevelCount;
+
+        childItems[m_topLevelCount++] = topLevelItem;
+    }
+
+    childItems += m_topLevelCount;
+
     for (int i = 0; i < m_dwarf->entryCount; i++)
     {
         DwarfEntry* entry = &m_dwarf->entries[i];
@@ -155,27 +386,20 @@ void DwarfModel::refresh()
             attributeItem->indexInParent = j;
         }
 
-        int childIndex = 0;
+        entryItem->e.childItems = childItems;
 
-        for (DwarfModelItem* childItem = entryItem->e.childItem; childItem != nullptr; childItem = childItem->e.siblingItem)
+        for (DwarfEntry* child = entry->firstChild; child != nullptr; child = child->sibling)
         {
+            DwarfModelItem* childItem = &entryItems[child - m_dwarf->entries];
+
+            // child rows come after the attribute rows
             childItem->parentItem = entryItem;
-            childItem->indexInParent = childIndex;
+            childItem->indexInParent = entry->attributeCount + entryItem->e.childCount;
 
-            childIndex++;
+            childItems[entryItem->e.childCount++] = childItem;
         }
-    }
-
-    DwarfModelItem* topLevelItem = m_items;
-    int topLevelIndex = 0;
-
-    while (topLevelItem)
-    {
-        topLevelItem->parentItem = nullptr;
-        topLevelItem->indexInParent = topLevelIndex;
 
-        topLevelItem = topLevelItem->e.siblingItem;
-        topLevelIndex++;
+        childItems += entryItem->e.childCount;
     }
 }
 
@@ -193,7 +417,7 @@ QModelIndex DwarfModel::index(int row, int column, const QModelIndex& parent) co
 
     if (!parent.isValid())
     {
-        return createIndex(row, column, getSiblingItem(m_items, row));
+        return createIndex(row, column, m_childItems[row]);
     }
 
     DwarfModelItem* parentItem = (DwarfModelItem*)parent.internalPointer();
@@ -208,7 +432,7 @@ QModelIndex DwarfModel::index(int row, int column, const QModelIndex& parent) co
         }
         else
         {
-            return createIndex(row, column, getSiblingItem(parentItem->e.childItem, row - entry->attributeCount));
+            return createIndex(row, column, parentItem->e.childItems[row - entry->attributeCount]);
         }
     }
 
@@ -251,14 +475,14 @@ int DwarfModel::rowCount(const QModelIndex& parent) const
 
     if (!parent.isValid())
     {
-        return getSiblingCount(m_items[0].e.entry);
+        return m_topLevelCount;
     }
 
     DwarfModelItem* parentItem = (DwarfModelItem*)parent.internalPointer();
 
     if (parentItem->type == DwarfModelItem::EntryItem)
     {
-        return parentItem->e.entry->attributeCount + getSiblingCount(parentItem->e.entry->firstChild);
+        return parentItem->e.entry->attributeCount + parentItem->e.childCount;
     }
 
     return 0;
@@ -286,13 +510,32 @@ QVariant DwarfModel::data(const QModelIndex& index, int role) const
         return QVariant();
     }
 
-    DwarfModelItem* item = (DwarfModelItem*)index.internalPointer();
+    const DwarfModelItem* item = (DwarfModelItem*)index.internalPointer();
+    quint32 key = displayKey(item, index.column());
+
+    if (QString* cached = m_displayCache.object(key))
+    {
+        return *cached;
+    }
+
+    QString string = displayString(item, index.column());
+    m_displayCache.insert(key, new QString(string), string.size() + 1);
+
+    return string;
+}
+
+quint32 DwarfModel::displayKey(const DwarfModelItem* item, int column) const
+{
+    return (quint32)(item - m_items) * ColumnCount + column;
+}
 
+QString DwarfModel::displayString(const DwarfModelItem* item, int column) const
+{
     if (item->type == DwarfModelItem::EntryItem)
     {
         DwarfEntry* entry = item->e.entry;
 
-        switch (index.column())
+        switch (column)
         {
         case OffsetColumn:
             return Util::hexToString(entry->offset);
@@ -306,40 +549,97 @@ QVariant DwarfModel::data(const QModelIndex& index, int role) const
     {
         DwarfAttribute* attribute = item->a.attribute;
 
-        switch (index.column())
+        switch (column)
         {
         case OffsetColumn:
             return Util::hexToString(attribute->offset);
         case TagColumn:
             return Dwarf::attrNameToString(attribute->name);
         case NameDataColumn:
-            switch (attribute->name)
-            {
-            case DW_AT_location:
-                return locationToString(m_dwarf, attribute);
-            }
+            return attributeDataToString(m_dwarf, attribute);
+        }
+    }
 
-            switch (attribute->getForm())
+    return QString();
+}
+
+void DwarfModel::prerender(const QModelIndexList& indexes)
+{
+    if (!m_dwarf)
+    {
+        return;
+    }
+
+    QList<quint32> keys;
+    QList<DwarfAttribute*> attributes;
+
+    for (const QModelIndex& index : indexes)
+    {
+        if (!index.isValid())
+        {
+            continue;
+        }
+
+        const DwarfModelItem* item = (DwarfModelItem*)index.internalPointer();
+
+        if (item->type != DwarfModelItem::AttributeItem || !isExpensiveAttribute(item->a.attribute))
+        {
+            continue;
+        }
+
+        quint32 key = displayKey(item, NameDataColumn);
+
+        if (!m_displayCache.contains(key))
+        {
+            keys.append(key);
+            attributes.append(item->a.attribute);
+        }
+    }
+
+    // whatever is still queued was for an older viewport position
+    m_renderPool.clear();
+
+    if (keys.isEmpty())
+    {
+        return;
+    }
+
+    Dwarf* dwarf = m_dwarf;
+    int generation = m_generation;
+
+    m_renderPool.start([this, dwarf, generation, keys, attributes]()
+        {
+            TRACE_SCOPE("DwarfModel::prerender");
+
+            QStringList strings;
+            strings.reserve(attributes.size());
+
+            for (DwarfAttribute* attribute : attributes)
             {
-            case DW_FORM_ADDR:
-                return QString("0x%1").arg(attribute->addr, 8, 16, QLatin1Char('0'));
-            case DW_FORM_REF:
-                return QString("0x%1").arg(attribute->ref, 0, 16);
-            case DW_FORM_DATA2:
-                return QString("%1").arg(attribute->data2);
-            case DW_FORM_DATA4:
-                return QString("%1").arg(attribute->data4);
-            case DW_FORM_DATA8:
-                return QString("%1").arg(attribute->data8);
-            case DW_FORM_STRING:
-                return attribute->string;
-            default:
-                return QString();
+                strings.append(attributeDataToString(dwarf, attribute));
             }
-        }
+
+            QMetaObject::invokeMethod(this, [this, generation, keys, strings]()
+                {
+                    insertRendered(generation, keys, strings);
+                }, Qt::QueuedConnection);
+        });
+}
+
+void DwarfModel::insertRendered(int generation, const QList<quint32>& keys, const QStringList& strings)
+{
+    if (generation != m_generation)
+    {
+        return;
     }
 
-    return QString();
+    for (int i = 0; i < keys.size(); i++)
+    {
+        if (!m_displayCache.contains(keys[i]))
+        {
+            m_displayCache.insert(keys[i], new QString(strings[i]), strings[i].size() + 1);
+        }
+    }
 }
 
 Qt::ItemFlags DwarfModel::flags(const QModelIndex& index) const
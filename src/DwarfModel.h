@@ -1,8 +1,11 @@
 #pragma once
 
 #include <qabstractitemmodel.h>
+#include <qcache.h>
+#include <qthreadpool.h>
 
 #include "Dwarf.h"
+#include "MemoryUsage.h"
 
 struct DwarfModelItem
 {
@@ -22,8 +25,8 @@ struct DwarfModelItem
         {
             DwarfEntry* entry;
             DwarfModelItem* attributeItems;
-            DwarfModelItem* siblingItem;
-            DwarfModelItem* childItem;
+            DwarfModelItem** childItems;
+            int childCount;
         } e;
 
         struct
@@ -51,6 +54,7 @@ public:
 
     Dwarf* dwarf() const;
     void setDwarf(Dwarf* dwarf);
+    MemoryUsage memoryUsage() const;
 
     DwarfEntry* entry(const QModelIndex& index) const;
     DwarfAttribute* attribute(const QModelIndex& index) const;
@@ -65,10 +69,21 @@ public:
     int columnCount(const QModelIndex& parent) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
+    void prerender(const QModelIndexList& indexes);
+
 private:
     Dwarf* m_dwarf;
     DwarfModelItem* m_items;
+    DwarfModelItem** m_childItems;
+    int m_topLevelCount;
+    mutable QCache<quint32, QString> m_displayCache;
+    QThreadPool m_renderPool;
+    int m_generation;
 
     void clearItems();
     void refresh();
+
+    quint32 displayKey(const DwarfModelItem* item, int column) const;
+    QString displayString(const DwarfModelItem* item, int column) const;
+    void insertRendered(int generation, const QList<quint32>& keys, const QStringList& strings);
 };
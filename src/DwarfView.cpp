@@ -2,15 +2,25 @@
 
 #include <qboxlayout.h>
 #include <qheaderview.h>
+#include <qscrollbar.h>
 
 DwarfView::DwarfView(QWidget* parent)
     : QWidget(parent)
     , m_treeView(new TreeView)
     , m_model(nullptr)
+    , m_prerenderTimer(new QTimer(this))
 {
     QVBoxLayout* mainLayout = new QVBoxLayout;
     mainLayout->addWidget(m_treeView);
     setLayout(mainLayout);
+
+    // coalesce scroll events so we only queue work once the viewport settles a bit
+    m_prerenderTimer->setSingleShot(true);
+    m_prerenderTimer->setInterval(20);
+
+    connect(m_prerenderTimer, &QTimer::timeout, this, &DwarfView::prerenderVisible);
+    connect(m_treeView->verticalScrollBar(), &QScrollBar::valueChanged, m_prerenderTimer, QOverload<>::of(&QTimer::start));
+    connect(m_treeView, &QTreeView::expanded, m_prerenderTimer, QOverload<>::of(&QTimer::start));
 }
 
 DwarfModel* DwarfView::model() const
@@ -25,6 +35,7 @@ void DwarfView::setModel(DwarfModel* model)
     m_model = model;
 
     connect(m_treeView->selectionModel(), &QItemSelectionModel::currentChanged, this, &DwarfView::currentChanged);
+    connect(model, &QAbstractItemModel::modelReset, m_prerenderTimer, QOverload<>::of(&QTimer::start));
 
     m_treeView->header()->setStretchLastSection(false);
     m_treeView->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
@@ -56,3 +67,44 @@ void DwarfView::currentChanged(const QModelIndex& current, const QModelIndex& pr
         emit attributeSelected(m_model->attribute(current));
     }
 }
+
+void DwarfView::prerenderVisible()
+{
+    if (!m_model)
+    {
+        return;
+    }
+
+    QModelIndex index = m_treeView->indexAt(QPoint(0, 0));
+
+    if (!index.isValid())
+    {
+        return;
+    }
+
+    int rowHeight = m_treeView->visualRect(index).height();
+    int pageRows = (rowHeight > 0) ? m_treeView->viewport()->height() / rowHeight + 1 : 64;
+
+    // one page above the viewport and two below, scrolling mostly goes down
+    for (int i = 0; i < pageRows; i++)
+    {
+        QModelIndex above = m_treeView->indexAbove(index);
+
+        if (!above.isValid())
+        {
+            break;
+        }
+
+        index = above;
+    }
+
+    QModelIndexList indexes;
+
+    for (int i = 0; i < pageRows * 4 && index.isValid(); i++)
+    {
+        indexes.append(index);
+        index = m_treeView->indexBelow(index);
+    }
+
+    m_model->prerender(indexes);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <qwidget.h>
+#include <qtimer.h>
 
 #include "DwarfModel.h"
 #include "TreeView.h"
@@ -23,7 +24,9 @@ signals:
 private:
     TreeView* m_treeView;
     DwarfModel* m_model;
+    QTimer* m_prerenderTimer;
 
 private slots:
     void currentChanged(const QModelIndex& current, const QModelIndex& previous);
+    void prerenderVisible();
 };
@@ -1,16 +1,21 @@
 ﻿#include "Elf.h"
 
+#include "Trace.h"
+
 #include <cstdio>
 #include <memory>
 
 Elf::ReadResult Elf::read(const char* path)
 {
+    TRACE_SCOPE_DETAIL("Elf::read", path);
+
     header = nullptr;
     programHeaderTable = nullptr;
     sectionHeaderTable = nullptr;
     sectionNameTable = nullptr;
     stringTable = nullptr;
     symbolTable = nullptr;
+    fileSize = 0;
 
     FILE* file = fopen(path, "rb");
 
@@ -26,6 +31,7 @@ Elf::ReadResult Elf::read(const char* path)
     char* data = (char*)malloc(size);
 
     header = (Elf32_Ehdr*)data;
+    fileSize = size;
 
     size_t bytesRead = fread(data, 1, size, file);
 
@@ -143,6 +149,7 @@ void Elf::destroy()
     sectionNameTable = nullptr;
     stringTable = nullptr;
     symbolTable = nullptr;
+    fileSize = 0;
 }
 
 void* Elf::offsetToPointer(Elf32_Off offset) const
@@ -212,3 +219,10 @@ void* Elf::getAddressData(Elf32_Addr addr) const
 
     return nullptr;
 }
+
+MemoryUsage Elf::memoryUsage() const
+{
+    MemoryUsage usage("ELF");
+    usage.add("File image", header ? fileSize : 0);
+    return usage;
+}
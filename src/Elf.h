@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <qendian.h>
 
+#include "MemoryUsage.h"
+
 typedef uint32_t Elf32_Addr;
 typedef uint16_t Elf32_Half;
 typedef uint32_t Elf32_Off;
@@ -197,6 +199,7 @@ struct Elf
     char* sectionNameTable;
     char* stringTable;
     Elf32_Sym* symbolTable;
+    size_t fileSize;
 
     enum ReadResult
     {
@@ -214,6 +217,7 @@ struct Elf
     void* getSectionData(const char* name) const;
     Elf32_Half getSectionIndex(const char* name) const;
     void* getAddressData(Elf32_Addr addr) const;
+    MemoryUsage memoryUsage() const;
 
     template <class T> void toNativeEndian(T* x) const
     {
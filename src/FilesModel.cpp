@@ -1,5 +1,7 @@
 #include "FilesModel.h"
 
+#include "Trace.h"
+
 #include <qdir.h>
 
 FilesModel::FilesModel(QObject* parent)
@@ -26,6 +28,33 @@ void FilesModel::setDwarf(Dwarf* dwarf)
     endResetModel();
 }
 
+static qint64 recurseItemBytes(const FilesModelItem& item, Memory::StringCounter& strings)
+{
+    qint64 bytes = Memory::mapBytes(item.subitems);
+
+    strings.add(item.text);
+    strings.add(item.path);
+
+    for (auto it = item.subitems.cbegin(); it != item.subitems.cend(); ++it)
+    {
+        strings.add(it.key());
+        bytes += recurseItemBytes(it.value(), strings);
+    }
+
+    return bytes;
+}
+
+MemoryUsage FilesModel::memoryUsage() const
+{
+    Memory::StringCounter strings;
+    qint64 itemBytes = recurseItemBytes(m_rootItem, strings);
+
+    MemoryUsage usage("Files model");
+    usage.add("Items", itemBytes);
+    usage.add("Strings", strings.bytes());
+    return usage;
+}
+
 void FilesModel::clearItems()
 {
     m_rootItem.subitems.clear();
@@ -48,6 +77,8 @@ static void recurseAssignParentItems(FilesModelItem* item)
 
 void FilesModel::refresh()
 {
+    TRACE_SCOPE("FilesModel::refresh");
+
     clearItems();
 
     if (!m_dwarf)
@@ -3,6 +3,7 @@
 #include <qabstractitemmodel.h>
 
 #include "Dwarf.h"
+#include "MemoryUsage.h"
 
 struct FilesModelItem
 {
@@ -35,6 +36,7 @@ public:
 
     Dwarf* dwarf() const;
     void setDwarf(Dwarf* dwarf);
+    MemoryUsage memoryUsage() const;
 
     QString path(const QModelIndex& index) const;
     bool isDirectory(const QModelIndex& index) const;
@@ -2,6 +2,9 @@
 
 #include "Util.h"
 #include "DwarfAttributes.h"
+#include "Trace.h"
+#include "Demangler.h"
+#include "SortKeys.h"
 
 #include <qdir.h>
 
@@ -9,6 +12,9 @@ FunctionsModel::FunctionsModel(QObject* parent)
     : QAbstractItemModel(parent)
     , m_dwarf(nullptr)
     , m_items()
+    , m_rows()
+    , m_nameKeys()
+    , m_fileNameKeys()
 {
 }
 
@@ -26,13 +32,36 @@ void FunctionsModel::setDwarf(Dwarf* dwarf)
     endResetModel();
 }
 
+MemoryUsage FunctionsModel::memoryUsage() const
+{
+    Memory::StringCounter strings;
+
+    for (const FunctionsModelItem& item : m_items)
+    {
+        strings.add(item.name);
+        strings.add(item.mangledName);
+        strings.add(item.fileName);
+    }
+
+    MemoryUsage usage("Functions model");
+    usage.add("Items", Memory::listBytes(m_items));
+    usage.add("Sort keys", Memory::listBytes(m_rows) + Memory::listBytes(m_nameKeys) + Memory::listBytes(m_fileNameKeys));
+    usage.add("Strings", strings.bytes());
+    return usage;
+}
+
 void FunctionsModel::clearItems()
 {
     m_items.clear();
+    m_rows.clear();
+    m_nameKeys.clear();
+    m_fileNameKeys.clear();
 }
 
 void FunctionsModel::refresh()
 {
+    TRACE_SCOPE("FunctionsModel::refresh");
+
     clearItems();
 
     if (!m_dwarf)
@@ -101,7 +130,7 @@ void FunctionsModel::refresh()
                             item.name = attr->string;
                             break;
                         case DW_AT_MW_mangled:
-                            item.name = attr->string;
+                            item.mangledName = attr->string;
                             break;
                         case DW_AT_low_pc:
                             item.address = attr->addr;
@@ -114,6 +143,42 @@ void FunctionsModel::refresh()
             }
         }
     }
+
+    QStringList mangledNames;
+
+    mangledNames.reserve(m_items.size());
+
+    for (const FunctionsModelItem& item : m_items)
+    {
+        mangledNames.append(item.mangledName);
+    }
+
+    QStringList demangledNames = Demangler::demangleAll(mangledNames);
+
+    for (int i = 0; i < m_items.size(); i++)
+    {
+        if (!m_items[i].mangledName.isEmpty())
+        {
+            m_items[i].name = demangledNames[i];
+        }
+    }
+
+    QStringList names;
+    QStringList fileNames;
+
+    names.reserve(m_items.size());
+    fileNames.reserve(m_items.size());
+    m_rows.resize(m_items.size());
+
+    for (int i = 0; i < m_items.size(); i++)
+    {
+        names.append(m_items[i].name);
+        fileNames.append(m_items[i].fileName);
+        m_rows[i] = i;
+    }
+
+    m_nameKeys = SortKeys::collationKeys(names);
+    m_fileNameKeys = SortKeys::collationKeys(fileNames);
 }
 
 QModelIndex FunctionsModel::index(int row, int column, const QModelIndex& parent) const
@@ -125,7 +190,7 @@ QModelIndex FunctionsModel::index(int row, int column, const QModelIndex& parent
 
     if (!parent.isValid())
     {
-        return createIndex(row, column, &m_items[row]);
+        return createIndex(row, column, &m_items[m_rows[row]]);
     }
 
     return QModelIndex();
@@ -158,13 +223,18 @@ QVariant FunctionsModel::data(const QModelIndex& index, int role) const
         return QVariant();
     }
 
+    const FunctionsModelItem* item = (FunctionsModelItem*)index.internalPointer();
+
+    if (role == Qt::ToolTipRole && index.column() == NameColumn && !item->mangledName.isEmpty())
+    {
+        return item->mangledName;
+    }
+
     if (role != Qt::DisplayRole)
     {
         return QVariant();
     }
 
-    const FunctionsModelItem* item = (FunctionsModelItem*)index.internalPointer();
-
     switch (index.column())
     {
     case NameColumn:
@@ -223,52 +293,62 @@ QVariant FunctionsModel::headerData(int section, Qt::Orientation orientation, in
 
 void FunctionsModel::sort(int column, Qt::SortOrder order)
 {
-    beginResetModel();
+    QList<quint32> keys(m_items.size());
 
-    if (order == Qt::AscendingOrder)
+    switch (column)
     {
-        switch (column)
+    case NameColumn:
+        keys = m_nameKeys;
+        break;
+    case FileColumn:
+        keys = m_fileNameKeys;
+        break;
+    case AddressColumn:
+        for (int i = 0; i < m_items.size(); i++)
         {
-        case NameColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
-            break;
-        case FileColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto& b) { return a.fileName < b.fileName; });
-            break;
-        case AddressColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto& b) { return a.address < b.address; });
-            break;
-        case PublicColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto&) { return !a.isPublic; });
-            break;
-        case DwarfOffsetColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto& b) { return a.dwarfOffset < b.dwarfOffset; });
-            break;
+            keys[i] = m_items[i].address;
         }
-    }
-    else
-    {
-        switch (column)
+        break;
+    case PublicColumn:
+        for (int i = 0; i < m_items.size(); i++)
+        {
+            keys[i] = m_items[i].isPublic ? 1 : 0;
+        }
+        break;
+    case DwarfOffsetColumn:
+        for (int i = 0; i < m_items.size(); i++)
         {
-        case NameColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto& b) { return a.name > b.name; });
-            break;
-        case FileColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto& b) { return a.fileName > b.fileName; });
-            break;
-        case AddressColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto& b) { return a.address > b.address; });
-            break;
-        case PublicColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto&) { return a.isPublic; });
-            break;
-        case DwarfOffsetColumn:
-            std::sort(m_items.begin(), m_items.end(), [](const auto& a, const auto& b) { return a.dwarfOffset > b.dwarfOffset; });
-            break;
+            keys[i] = m_items[i].dwarfOffset;
         }
+        break;
     }
 
-    endResetModel();
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    m_rows = SortKeys::sortedRows(keys, order);
+
+    // items don't move, so persistent indexes only need their row updated
+    QList<int> itemRows(m_items.size());
+
+    for (int row = 0; row < m_rows.size(); row++)
+    {
+        itemRows[m_rows[row]] = row;
+    }
+
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+
+    to.reserve(from.size());
+
+    for (const QModelIndex& index : from)
+    {
+        int item = (int)((const FunctionsModelItem*)index.internalPointer() - m_items.constData());
+        to.append(createIndex(itemRows[item], index.column(), index.internalPointer()));
+    }
+
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
 }
 
 QString FunctionsModel::name(const QModelIndex& index) const
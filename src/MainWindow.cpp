@@ -1,16 +1,25 @@
 #include "MainWindow.h"
 
 #include "CppCodeModel.h"
+#include "MemoryUsageDialog.h"
 #include "Output.h"
+#include "Trace.h"
+#include "Demangler.h"
+#include "DisassemblyCache.h"
 
 #include <qmenubar.h>
 #include <qfiledialog.h>
 #include <qmessagebox.h>
 #include <qdockwidget.h>
 #include <qsettings.h>
+#include <qthreadpool.h>
+
+#include <atomic>
 
 MainWindow* MainWindow::s_mainWindow = nullptr;
 
+static std::atomic<bool> s_diagnosticsRefreshPending = false;
+
 AppSettings MainWindow::s_defaultSettings
 {
     true, // openMostRecentFileOnStartup
@@ -36,10 +45,15 @@ MainWindow::MainWindow(QWidget* parent)
     , m_codeModel(new CppCodeModel(this))
     , m_codeView(new CodeView(this))
     , m_outputView(new OutputView(this))
+    , m_diagnosticsModel(new DiagnosticsModel(this))
+    , m_diagnosticsView(new DiagnosticsView(this))
     , m_fileMenu(nullptr)
     , m_recentPathsSeparator(nullptr)
     , m_recentPathActions()
     , m_settings()
+    , m_exportProgressDialog(nullptr)
+    , m_exporting(false)
+    , m_exportFinished()
 {
     s_mainWindow = this;
 
@@ -62,6 +76,7 @@ MainWindow::MainWindow(QWidget* parent)
     m_variablesView->setModel(m_variablesModel);
     m_typesView->setModel(m_typesModel);
     m_codeView->setModel(m_codeModel);
+    m_diagnosticsView->setModel(m_diagnosticsModel);
 
     connect(m_dwarfView, &DwarfView::entrySelected, this, &MainWindow::dwarfEntrySelected);
     connect(m_dwarfView, &DwarfView::attributeSelected, this, &MainWindow::dwarfAttributeSelected);
@@ -72,11 +87,14 @@ MainWindow::MainWindow(QWidget* parent)
     connect(m_variablesView, &VariablesView::variableSelected, this, &MainWindow::variablesVariableSelected);
     connect(m_variablesView, &VariablesView::noneSelected, this, &MainWindow::variablesNoneSelected);
     connect(m_typesView, &TypesView::typeDefinitionSelected, this, &MainWindow::typesTypeDefinitionSelected);
+    connect(m_diagnosticsView, &DiagnosticsView::diagnosticSelected, this, &MainWindow::diagnosticsDiagnosticSelected);
 
     m_fileMenu = menuBar()->addMenu(tr("File"));
     m_fileMenu->addAction(tr("Open..."), this, QOverload<>::of(&MainWindow::openFile));
     m_fileMenu->addAction(tr("Close"), this, &MainWindow::closeFile);
     m_fileMenu->addSeparator();
+    m_fileMenu->addAction(tr("Export all..."), this, &MainWindow::exportAll);
+    m_fileMenu->addSeparator();
 
     m_recentPathsSeparator = m_fileMenu->addSeparator();
 
@@ -95,6 +113,20 @@ MainWindow::MainWindow(QWidget* parent)
         saveSettings();
         });
 
+    QMenu* toolsMenu = menuBar()->addMenu(tr("Tools"));
+    toolsMenu->addAction(tr("Memory usage..."), this, &MainWindow::showMemoryUsage);
+    toolsMenu->addSeparator();
+
+    action = toolsMenu->addAction(tr("Record trace"));
+    action->setCheckable(true);
+    action->setChecked(Trace::isEnabled());
+    connect(action, &QAction::triggered, this, [=] {
+        Trace::setEnabled(action->isChecked());
+        });
+
+    toolsMenu->addAction(tr("Export trace..."), this, &MainWindow::exportTrace);
+    toolsMenu->addAction(tr("Clear trace"), this, [] { Trace::clear(); });
+
     setCentralWidget(m_tabWidget);
 
     QDockWidget* codeViewDock = new QDockWidget(tr("Code"));
@@ -107,9 +139,18 @@ MainWindow::MainWindow(QWidget* parent)
 
     addDockWidget(Qt::BottomDockWidgetArea, outputViewDock);
 
+    QDockWidget* diagnosticsViewDock = new QDockWidget(tr("Diagnostics"));
+    diagnosticsViewDock->setWidget(m_diagnosticsView);
+
+    addDockWidget(Qt::BottomDockWidgetArea, diagnosticsViewDock);
+    tabifyDockWidget(outputViewDock, diagnosticsViewDock);
+    outputViewDock->raise();
+
     resizeDocks({ codeViewDock }, { width() / 2 }, Qt::Horizontal);
 
     Output::setWriteCallback(outputWriteCallback);
+    Diagnostics::setChangedCallback(diagnosticsChangedCallback);
+    DisassemblyCache::setReadyCallback(disassemblyCacheReadyCallback);
 
     if (m_settings.openMostRecentFileOnStartup && !m_settings.recentPaths.isEmpty())
     {
@@ -119,6 +160,11 @@ MainWindow::MainWindow(QWidget* parent)
 
 MainWindow::~MainWindow()
 {
+    waitForExport();
+
+    // the cache workers read from m_elf and call back into this window
+    DisassemblyCache::clear();
+    DisassemblyCache::setReadyCallback(nullptr);
 }
 
 void MainWindow::openFile()
@@ -191,6 +237,8 @@ void MainWindow::openFile(const QString& path)
     m_typesModel->setDwarf(&m_dwarf);
     m_codeModel->setDwarf(&m_dwarf);
 
+    DisassemblyCache::start(&m_dwarf);
+
     m_settings.recentPaths.removeAll(path); // for some reason path contains a different string after this call despite being passed in as a const ref... (Qt bug?)
     m_settings.recentPaths.prepend(m_path); // so we pass in m_path here
 
@@ -213,6 +261,9 @@ void MainWindow::closeFile()
 
     Output::write(tr("Closing file %1").arg(m_path));
 
+    // the export reads from the code model and the ELF file
+    waitForExport();
+
     m_dwarfModel->setDwarf(nullptr);
     m_filesModel->setDwarf(nullptr);
     m_functionsModel->setDwarf(nullptr);
@@ -221,14 +272,127 @@ void MainWindow::closeFile()
     m_codeView->clear();
     m_codeModel->setDwarf(nullptr);
 
+    // waits for the workers, they still read from the ELF file
+    DisassemblyCache::clear();
+
     m_dwarf.destroy();
     m_elf.destroy();
 
+    Demangler::clear();
+
     m_path = QString();
 
     updateWindowTitle();
 }
 
+void MainWindow::exportAll()
+{
+    if (m_path.isEmpty() || m_exporting)
+    {
+        return;
+    }
+
+    QString directory = QFileDialog::getExistingDirectory(this, tr("Export All"));
+
+    if (directory.isEmpty())
+    {
+        return;
+    }
+
+    // the file count isn't known until the disassembly cache is done, so the
+    // dialog starts out busy
+    m_exportProgressDialog = new QProgressDialog(tr("Exporting files..."), QString(), 0, 0, this);
+    m_exportProgressDialog->setWindowModality(Qt::WindowModal);
+    m_exportProgressDialog->setMinimumDuration(0);
+    m_exportProgressDialog->setAutoReset(false);
+    m_exportProgressDialog->setAutoClose(false);
+    m_exportProgressDialog->setValue(0);
+
+    m_exporting = true;
+
+    AbstractCodeModel* codeModel = m_codeModel;
+
+    QThreadPool::globalInstance()->start([codeModel, directory]
+        {
+            CodeExportResult result = CodeExporter::exportAll(codeModel, directory, exportProgressCallback);
+
+            QMetaObject::invokeMethod(s_mainWindow, [result, directory] {
+                s_mainWindow->finishExport(result, directory);
+                }, Qt::QueuedConnection);
+
+            s_mainWindow->m_exportFinished.release();
+        });
+}
+
+void MainWindow::finishExport(const CodeExportResult& result, const QString& directory)
+{
+    waitForExport();
+
+    delete m_exportProgressDialog;
+    m_exportProgressDialog = nullptr;
+
+    if (result.failedCount > 0)
+    {
+        QString errorString = tr("Could not export %1 of %2 files: %3").arg(result.failedCount).arg(result.fileCount).arg(result.error);
+        Output::write(errorString);
+        QMessageBox::warning(this, tr("Error"), errorString);
+    }
+
+    Output::write(CodeExporter::summary(result, directory));
+}
+
+void MainWindow::waitForExport()
+{
+    if (m_exporting)
+    {
+        m_exportFinished.acquire();
+        m_exporting = false;
+    }
+}
+
+void MainWindow::showMemoryUsage()
+{
+    MemoryUsageDialog dialog(this);
+    dialog.setUsage(memoryUsage());
+    dialog.exec();
+}
+
+void MainWindow::exportTrace()
+{
+    QString path = QFileDialog::getSaveFileName(this, tr("Export Trace"), QString(), "Chrome trace (*.json)");
+
+    if (path.isNull())
+    {
+        return;
+    }
+
+    if (!Trace::exportChromeTrace(path))
+    {
+        QString errorString = tr("Could not write trace to %1").arg(path);
+        Output::write(errorString);
+        QMessageBox::warning(this, tr("Error"), errorString);
+        return;
+    }
+
+    Output::write(tr("Exported %1 trace events to %2").arg(Trace::eventCount()).arg(path));
+}
+
+MemoryUsage MainWindow::memoryUsage() const
+{
+    MemoryUsage usage(m_path.isEmpty() ? tr("No file loaded") : QFileInfo(m_path).fileName());
+    usage.add(m_elf.memoryUsage());
+    usage.add(m_dwarf.memoryUsage());
+    usage.add(m_dwarfModel->memoryUsage());
+    usage.add(m_filesModel->memoryUsage());
+    usage.add(m_functionsModel->memoryUsage());
+    usage.add(m_variablesModel->memoryUsage());
+    usage.add(m_typesModel->memoryUsage());
+    usage.add(m_codeModel->memoryUsage());
+    usage.add(Demangler::memoryUsage());
+    usage.add(DisassemblyCache::memoryUsage());
+    return usage;
+}
+
 void MainWindow::dwarfEntrySelected(DwarfEntry* entry)
 {
     m_codeView->viewDwarfEntry(entry->offset);
@@ -275,10 +439,59 @@ void MainWindow::typesTypeDefinitionSelected(Elf32_Off dwarfOffset)
     m_codeView->viewDwarfEntry(dwarfOffset);
 }
 
+void MainWindow::diagnosticsDiagnosticSelected(Elf32_Off dwarfOffset)
+{
+    m_codeView->viewDwarfEntry(dwarfOffset);
+}
+
 void MainWindow::outputWriteCallback(const QString& text)
 {
     printf("%s\n", qPrintable(text));
-    s_mainWindow->m_outputView->appendPlainText(text);
+
+    // output can be written from worker threads (e.g. while exporting), the
+    // view is only touched on the GUI thread
+    QMetaObject::invokeMethod(s_mainWindow->m_outputView, [=] {
+        s_mainWindow->m_outputView->appendPlainText(text);
+        });
+}
+
+void MainWindow::diagnosticsChangedCallback()
+{
+    // diagnostics can be added from any thread, and a whole parse adds them
+    // in bursts, so only refresh the model once per burst
+    if (s_diagnosticsRefreshPending.exchange(true))
+    {
+        return;
+    }
+
+    QMetaObject::invokeMethod(s_mainWindow, [] {
+        s_diagnosticsRefreshPending = false;
+        s_mainWindow->m_diagnosticsModel->refresh();
+        }, Qt::QueuedConnection);
+}
+
+void MainWindow::disassemblyCacheReadyCallback()
+{
+    // called from the thread pool once every function is disassembled, so
+    // whatever was written with placeholders is written again
+    QMetaObject::invokeMethod(s_mainWindow, [] {
+        s_mainWindow->m_codeModel->requestRewrite();
+        }, Qt::QueuedConnection);
+}
+
+void MainWindow::exportProgressCallback(int exportedCount, int fileCount)
+{
+    // called from the export workers, the queued updates can arrive out of
+    // order so the dialog only ever moves forward
+    QMetaObject::invokeMethod(s_mainWindow, [exportedCount, fileCount] {
+        QProgressDialog* dialog = s_mainWindow->m_exportProgressDialog;
+
+        if (dialog && exportedCount > dialog->value())
+        {
+            dialog->setMaximum(fileCount);
+            dialog->setValue(exportedCount);
+        }
+        }, Qt::QueuedConnection);
 }
 
 void MainWindow::loadSettings()
@@ -17,8 +17,13 @@
 #include "AbstractCodeModel.h"
 #include "CodeView.h"
 #include "OutputView.h"
+#include "DiagnosticsModel.h"
+#include "DiagnosticsView.h"
+#include "CodeExporter.h"
 
 #include <qtabwidget.h>
+#include <qprogressdialog.h>
+#include <qsemaphore.h>
 
 struct AppSettings
 {
@@ -38,6 +43,9 @@ public slots:
     void openFile();
     void openFile(const QString& path);
     void closeFile();
+    void exportAll();
+    void showMemoryUsage();
+    void exportTrace();
 
 private:
     static MainWindow* s_mainWindow;
@@ -60,19 +68,32 @@ private:
     AbstractCodeModel* m_codeModel;
     CodeView* m_codeView;
     OutputView* m_outputView;
+    DiagnosticsModel* m_diagnosticsModel;
+    DiagnosticsView* m_diagnosticsView;
     QMenu* m_fileMenu;
     QAction* m_recentPathsSeparator;
     QList<QAction*> m_recentPathActions;
     AppSettings m_settings;
+    QProgressDialog* m_exportProgressDialog;
+    bool m_exporting;
+    QSemaphore m_exportFinished;
 
     static void outputWriteCallback(const QString& text);
+    static void diagnosticsChangedCallback();
+    static void disassemblyCacheReadyCallback();
+    static void exportProgressCallback(int exportedCount, int fileCount);
 
     void loadSettings();
     void saveSettings();
 
+    MemoryUsage memoryUsage() const;
+
     void updateWindowTitle();
     void updateFileMenu();
 
+    void finishExport(const CodeExportResult& result, const QString& directory);
+    void waitForExport();
+
 private slots:
     void dwarfEntrySelected(DwarfEntry* entry);
     void dwarfAttributeSelected(DwarfAttribute* attribute);
@@ -84,4 +105,5 @@ private slots:
     void variablesVariableSelected(Elf32_Off dwarfOffset);
     void variablesNoneSelected();
     void typesTypeDefinitionSelected(Elf32_Off dwarfOffset);
+    void diagnosticsDiagnosticSelected(Elf32_Off dwarfOffset);
 };
@@ -0,0 +1,82 @@
+#include "MemoryUsage.h"
+
+#include <qjsonarray.h>
+
+MemoryUsage::MemoryUsage(const QString& name, qint64 bytes)
+    : name(name)
+    , bytes(bytes)
+    , children()
+{
+}
+
+MemoryUsage& MemoryUsage::add(const QString& name, qint64 bytes)
+{
+    children.append(MemoryUsage(name, bytes));
+    return children.last();
+}
+
+void MemoryUsage::add(const MemoryUsage& child)
+{
+    children.append(child);
+}
+
+qint64 MemoryUsage::totalBytes() const
+{
+    qint64 total = bytes;
+
+    for (const MemoryUsage& child : children)
+    {
+        total += child.totalBytes();
+    }
+
+    return total;
+}
+
+QJsonObject MemoryUsage::toJson() const
+{
+    QJsonObject object;
+    object["name"] = name;
+    object["bytes"] = totalBytes();
+
+    if (!children.isEmpty())
+    {
+        QJsonArray array;
+
+        for (const MemoryUsage& child : children)
+        {
+            array.append(child.toJson());
+        }
+
+        object["children"] = array;
+    }
+
+    return object;
+}
+
+namespace Memory
+{
+    StringCounter::StringCounter()
+        : m_seen()
+        , m_bytes(0)
+    {
+    }
+
+    void StringCounter::add(const QString& string)
+    {
+        if (string.isNull())
+        {
+            return;
+        }
+
+        if (!m_seen.contains(string.constData()))
+        {
+            m_seen.insert(string.constData());
+            m_bytes += stringBytes(string);
+        }
+    }
+
+    qint64 StringCounter::bytes() const
+    {
+        return m_bytes;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <qstring.h>
+#include <qlist.h>
+#include <qvector.h>
+#include <qhash.h>
+#include <qmap.h>
+#include <qset.h>
+#include <qjsonobject.h>
+
+struct MemoryUsage
+{
+    QString name;
+    qint64 bytes;
+    QList<MemoryUsage> children;
+
+    MemoryUsage(const QString& name = QString(), qint64 bytes = 0);
+
+    MemoryUsage& add(const QString& name, qint64 bytes = 0);
+    void add(const MemoryUsage& child);
+    qint64 totalBytes() const;
+    QJsonObject toJson() const;
+};
+
+// Estimates of the heap memory owned by Qt containers. These only count the
+// container storage itself; the contents have to be added by the caller.
+namespace Memory
+{
+    inline qint64 stringBytes(const QString& string)
+    {
+        return string.capacity() * (qint64)sizeof(QChar);
+    }
+
+    template <class T> qint64 listBytes(const QList<T>& list)
+    {
+        return list.capacity() * (qint64)sizeof(T);
+    }
+
+    template <class K, class V> qint64 hashBytes(const QHash<K, V>& hash)
+    {
+        // one offset byte per bucket plus the node storage
+        return hash.capacity() + hash.size() * (qint64)(sizeof(K) + sizeof(V));
+    }
+
+    template <class K, class V> qint64 hashBytes(const QMultiHash<K, V>& hash)
+    {
+        return hash.capacity() + hash.size() * (qint64)(sizeof(K) + sizeof(V) + sizeof(void*));
+    }
+
+    template <class K, class V> qint64 mapBytes(const QMap<K, V>& map)
+    {
+        // red-black tree node: color + parent, left and right pointers
+        return map.size() * (qint64)(sizeof(K) + sizeof(V) + 4 * sizeof(void*));
+    }
+
+    template <class K, class V> qint64 mapBytes(const QMultiMap<K, V>& map)
+    {
+        return map.size() * (qint64)(sizeof(K) + sizeof(V) + 4 * sizeof(void*));
+    }
+
+    // Sums string payloads, counting implicitly shared strings only once.
+    class StringCounter
+    {
+    public:
+        StringCounter();
+
+        void add(const QString& string);
+        qint64 bytes() const;
+
+    private:
+        QSet<const void*> m_seen;
+        qint64 m_bytes;
+    };
+}
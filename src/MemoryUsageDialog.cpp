@@ -0,0 +1,98 @@
+#include "MemoryUsageDialog.h"
+
+#include "Output.h"
+
+#include <qboxlayout.h>
+#include <qdialogbuttonbox.h>
+#include <qpushbutton.h>
+#include <qheaderview.h>
+#include <qfiledialog.h>
+#include <qfile.h>
+#include <qmessagebox.h>
+#include <qjsondocument.h>
+#include <qlocale.h>
+
+MemoryUsageDialog::MemoryUsageDialog(QWidget* parent)
+    : QDialog(parent)
+    , m_usage()
+    , m_treeWidget(new QTreeWidget)
+{
+    setWindowTitle(tr("Memory usage"));
+
+    m_treeWidget->setColumnCount(3);
+    m_treeWidget->setHeaderLabels({ tr("Name"), tr("Size"), tr("Share") });
+    m_treeWidget->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_treeWidget->header()->setStretchLastSection(false);
+
+    QVBoxLayout* mainLayout = new QVBoxLayout;
+
+    QDialogButtonBox* buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    QPushButton* saveButton = buttonBox->addButton(tr("Save JSON..."), QDialogButtonBox::ActionRole);
+
+    connect(saveButton, &QPushButton::clicked, this, &MemoryUsageDialog::saveJson);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    mainLayout->addWidget(m_treeWidget, 1);
+    mainLayout->addWidget(buttonBox);
+
+    setLayout(mainLayout);
+    resize(500, 400);
+}
+
+MemoryUsage MemoryUsageDialog::usage() const
+{
+    return m_usage;
+}
+
+void MemoryUsageDialog::setUsage(const MemoryUsage& usage)
+{
+    m_usage = usage;
+    m_treeWidget->clear();
+
+    addItem(nullptr, m_usage, m_usage.totalBytes());
+
+    m_treeWidget->expandAll();
+    m_treeWidget->resizeColumnToContents(1);
+    m_treeWidget->resizeColumnToContents(2);
+}
+
+void MemoryUsageDialog::addItem(QTreeWidgetItem* parentItem, const MemoryUsage& usage, qint64 totalBytes)
+{
+    qint64 bytes = usage.totalBytes();
+
+    QTreeWidgetItem* item = parentItem ? new QTreeWidgetItem(parentItem) : new QTreeWidgetItem(m_treeWidget);
+    item->setText(0, usage.name);
+    item->setText(1, QLocale().formattedDataSize(bytes));
+    item->setText(2, totalBytes > 0 ? QString("%1%").arg(bytes * 100.0 / totalBytes, 0, 'f', 1) : QString());
+    item->setTextAlignment(1, Qt::AlignRight);
+    item->setTextAlignment(2, Qt::AlignRight);
+
+    for (const MemoryUsage& child : usage.children)
+    {
+        addItem(item, child, totalBytes);
+    }
+}
+
+void MemoryUsageDialog::saveJson()
+{
+    QString path = QFileDialog::getSaveFileName(this, tr("Save Memory Usage"), QString(), "JSON file (*.json)");
+
+    if (path.isNull())
+    {
+        return;
+    }
+
+    QFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        QString errorString = tr("Could not open file %1 for writing").arg(path);
+        Output::write(errorString);
+        QMessageBox::warning(this, tr("Error"), errorString);
+        return;
+    }
+
+    file.write(QJsonDocument(m_usage.toJson()).toJson());
+
+    Output::write(tr("Saved memory usage to %1").arg(path));
+}
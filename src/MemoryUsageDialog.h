@@ -0,0 +1,24 @@
+#pragma once
+
+#include "MemoryUsage.h"
+
+#include <qdialog.h>
+#include <qtreewidget.h>
+
+class MemoryUsageDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    MemoryUsageDialog(QWidget* parent = nullptr);
+
+    MemoryUsage usage() const;
+    void setUsage(const MemoryUsage& usage);
+
+private:
+    MemoryUsage m_usage;
+    QTreeWidget* m_treeWidget;
+
+    void addItem(QTreeWidgetItem* parentItem, const MemoryUsage& usage, qint64 totalBytes);
+    void saveJson();
+};
@@ -4,6 +4,50 @@
 
 #include <qendian.h>
 
+#include <cstring>
+
+// Capstone handle kept open for the lifetime of the thread, along with the
+// one instruction cs_disasm_iter decodes into, so disassembling a function
+// doesn't open a handle or allocate instructions every time.
+struct PPCDisassemblerHandle
+{
+    csh handle;
+    cs_insn* insn;
+    bool isOpen;
+
+    PPCDisassemblerHandle()
+        : handle(0)
+        , insn(nullptr)
+        , isOpen(false)
+    {
+        if (cs_open(CS_ARCH_PPC, (cs_mode)(CS_MODE_32 + CS_MODE_BIG_ENDIAN), &handle) != CS_ERR_OK)
+        {
+            return;
+        }
+
+        cs_option(handle, CS_OPT_SKIPDATA, CS_OPT_ON);
+
+        insn = cs_malloc(handle);
+        isOpen = (insn != nullptr);
+
+        if (!isOpen)
+        {
+            cs_close(&handle);
+        }
+    }
+
+    ~PPCDisassemblerHandle()
+    {
+        if (isOpen)
+        {
+            cs_free(insn, 1);
+            cs_close(&handle);
+        }
+    }
+};
+
+static thread_local PPCDisassemblerHandle s_handle;
+
 PPCDisassembler::PPCDisassembler(QObject* parent) :
     AbstractDisassembler(parent)
 {
@@ -11,46 +55,899 @@ PPCDisassembler::PPCDisassembler(QObject* parent) :
 
 bool PPCDisassembler::disassemble(Disassembly& disasm, const Elf* elf, Elf32_Addr startAddress, Elf32_Addr endAddress)
 {
-    char* data = (char*)elf->getAddressData(startAddress);
+    const uint8_t* code = (const uint8_t*)elf->getAddressData(startAddress);
 
-    if (!data)
+    if (!code || !s_handle.isOpen)
     {
         return false;
     }
 
-    csh handle;
-    cs_insn* insn;
-    size_t count;
+    size_t size = endAddress - startAddress;
+    uint64_t address = startAddress;
+    bool success = false;
+
+    disasm.setDisassembler(this);
+
+    // only the word and instruction ID are kept, format makes the text
+    // from the word when it's asked for
+    while (cs_disasm_iter(s_handle.handle, &code, &size, &address, s_handle.insn))
+    {
+        disasm.addInstruction((Elf32_Addr)s_handle.insn->address, qFromBigEndian<quint32>(s_handle.insn->bytes), (quint16)s_handle.insn->id);
+        success = true;
+    }
+
+    return success;
+}
+
+// Text of an instruction, put together from the fields of its word
+struct PPCInstructionText
+{
+    QString mnemonic;
+    QString operands;
+
+    void set(const char* name)
+    {
+        mnemonic = QLatin1String(name);
+    }
+
+    void add(const QString& operand)
+    {
+        if (!operands.isEmpty())
+        {
+            operands += ", ";
+        }
+
+        operands += operand;
+    }
+};
+
+static QString gpr(int r) { return QString("r%1").arg(r); }
+static QString fpr(int r) { return QString("f%1").arg(r); }
+static QString crf(int n) { return QString("cr%1").arg(n); }
+static QString number(int n) { return QString::number(n); }
+
+static QString immediate(qint32 value)
+{
+    // small values read better in decimal
+    if (value < -9)
+    {
+        return QString("-0x%1").arg(-(qint64)value, 0, 16);
+    }
+
+    if (value > 9)
+    {
+        return QString("0x%1").arg(value, 0, 16);
+    }
+
+    return QString::number(value);
+}
+
+static QString address(Elf32_Addr address)
+{
+    return QString("0x%1").arg(address, 0, 16);
+}
+
+static QString memory(qint32 displacement, int rA)
+{
+    return QString("%1(%2)").arg(immediate(displacement), gpr(rA));
+}
+
+static int frC(quint32 word) { return (word >> 6) & 0x1F; }
+static int crfD(quint32 word) { return (word >> 23) & 0x7; }
+static int crfS(quint32 word) { return (word >> 18) & 0x7; }
+static int shift(quint32 word) { return (word >> 11) & 0x1F; }
+static int maskBegin(quint32 word) { return (word >> 6) & 0x1F; }
+static int maskEnd(quint32 word) { return (word >> 1) & 0x1F; }
+static bool recordBit(quint32 word) { return (word & 1) != 0; }
+static bool overflowBit(quint32 word) { return (word & 0x400) != 0; }
+static int extendedOpcode(quint32 word) { return (word >> 1) & 0x3FF; }
+static int aFormOpcode(quint32 word) { return (word >> 1) & 0x1F; }
+
+static const char* const conditionNames[2][4] =
+{
+    { "ge", "le", "ne", "ns" }, // condition bit clear
+    { "lt", "gt", "eq", "so" }  // condition bit set
+};
+
+static int sprNumber(quint32 word)
+{
+    // the two halves of the SPR field are swapped
+    return ((word >> 16) & 0x1F) | (((word >> 11) & 0x1F) << 5);
+}
+
+// bc, bclr and bcctr, with the simplified mnemonics for the common BO
+// encodings. suffix is "" for bc, "lr" or "ctr" for the others.
+static bool formatConditionalBranch(const DisassemblyInstruction& instruction, const char* suffix, PPCInstructionText& text)
+{
+    quint32 word = instruction.word;
+    int bo = (word >> 21) & 0x1F;
+    int bi = (word >> 16) & 0x1F;
+    bool isBc = (*suffix == '\0');
+    QString link = QLatin1String(recordBit(word) ? "l" : "");
+    QString absolute = QLatin1String(isBc && (word & 2) ? "a" : "");
+    Elf32_Addr target = 0;
+
+    if (isBc)
+    {
+        PPCDisassembler::branchTarget(instruction, target);
+    }
+
+    // BO bits (from the most significant): don't test the condition,
+    // branch if the condition is set, don't decrement CTR, branch if CTR is
+    // zero, branch prediction hint
+    bool testsCondition = !(bo & 0x10);
+    bool decrementsCtr = !(bo & 0x04);
+    QString name;
+
+    if (!testsCondition && !decrementsCtr && !isBc)
+    {
+        name = "b";
+    }
+    else if (testsCondition && !decrementsCtr)
+    {
+        name = QString("b%1").arg(QLatin1String(conditionNames[(bo >> 3) & 1][bi & 3]));
+    }
+    else if (!testsCondition && decrementsCtr && strcmp(suffix, "ctr") != 0)
+    {
+        name = QLatin1String((bo & 0x02) ? "bdz" : "bdnz");
+    }
+
+    if (name.isEmpty())
+    {
+        text.mnemonic = QString("bc%1%2%3").arg(QLatin1String(suffix), link, absolute);
+        text.add(number(bo));
+        text.add(number(bi));
+    }
+    else
+    {
+        text.mnemonic = name + QLatin1String(suffix) + link + absolute;
+
+        if (testsCondition && bi >= 4)
+        {
+            text.add(crf(bi / 4));
+        }
+    }
+
+    if (isBc)
+    {
+        text.add(address(target));
+    }
+
+    return true;
+}
+
+// Gekko paired single instructions (primary opcode 4)
+static bool formatPairedSingle(quint32 word, PPCInstructionText& text)
+{
+    int d = PPCDisassembler::rD(word);
+    int a = PPCDisassembler::rA(word);
+    int b = PPCDisassembler::rB(word);
+    int c = frC(word);
+
+    switch (aFormOpcode(word))
+    {
+    case 6:
+    case 7:
+    {
+        // psq_lx, psq_stx, psq_lux, psq_stux
+        bool isStore = aFormOpcode(word) == 7;
+        bool isUpdate = (word & 0x40) != 0;
+
+        text.mnemonic = QString("psq_%1%2x").arg(QLatin1String(isStore ? "st" : "l"), QLatin1String(isUpdate ? "u" : ""));
+        text.add(fpr(d));
+        text.add(gpr(a));
+        text.add(gpr(b));
+        text.add(number((word >> 10) & 1));
+        text.add(number((word >> 7) & 7));
+        return true;
+    }
+    case 10: text.set("ps_sum0"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    case 11: text.set("ps_sum1"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    case 12: text.set("ps_muls0"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); break;
+    case 13: text.set("ps_muls1"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); break;
+    case 14: text.set("ps_madds0"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    case 15: text.set("ps_madds1"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    case 18: text.set("ps_div"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(b)); break;
+    case 20: text.set("ps_sub"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(b)); break;
+    case 21: text.set("ps_add"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(b)); break;
+    case 23: text.set("ps_sel"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    case 24: text.set("ps_res"); text.add(fpr(d)); text.add(fpr(b)); break;
+    case 25: text.set("ps_mul"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); break;
+    case 26: text.set("ps_rsqrte"); text.add(fpr(d)); text.add(fpr(b)); break;
+    case 28: text.set("ps_msub"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    case 29: text.set("ps_madd"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    case 30: text.set("ps_nmsub"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    case 31: text.set("ps_nmadd"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(c)); text.add(fpr(b)); break;
+    default:
+        switch (extendedOpcode(word))
+        {
+        case 0: text.set("ps_cmpu0"); text.add(crf(crfD(word))); text.add(fpr(a)); text.add(fpr(b)); return true;
+        case 32: text.set("ps_cmpo0"); text.add(crf(crfD(word))); text.add(fpr(a)); text.add(fpr(b)); return true;
+        case 64: text.set("ps_cmpu1"); text.add(crf(crfD(word))); text.add(fpr(a)); text.add(fpr(b)); return true;
+        case 96: text.set("ps_cmpo1"); text.add(crf(crfD(word))); text.add(fpr(a)); text.add(fpr(b)); return true;
+        case 40: text.set("ps_neg"); text.add(fpr(d)); text.add(fpr(b)); break;
+        case 72: text.set("ps_mr"); text.add(fpr(d)); text.add(fpr(b)); break;
+        case 136: text.set("ps_nabs"); text.add(fpr(d)); text.add(fpr(b)); break;
+        case 264: text.set("ps_abs"); text.add(fpr(d)); text.add(fpr(b)); break;
+        case 528: text.set("ps_merge00"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(b)); break;
+        case 560: text.set("ps_merge01"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(b)); break;
+        case 592: text.set("ps_merge10"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(b)); break;
+        case 624: text.set("ps_merge11"); text.add(fpr(d)); text.add(fpr(a)); text.add(fpr(b)); break;
+        case 1014: text.set("dcbz_l"); text.add(gpr(a)); text.add(gpr(b)); return true;
+        default:
+            return false;
+        }
+    }
+
+    if (recordBit(word))
+    {
+        text.mnemonic += ".";
+    }
+
+    return true;
+}
 
-    if (cs_open(CS_ARCH_PPC, (cs_mode)(CS_MODE_32 + CS_MODE_BIG_ENDIAN), &handle) != CS_ERR_OK)
+// Primary opcode 19: branches to LR/CTR, condition register logic and the like
+static bool formatOpcode19(const DisassemblyInstruction& instruction, PPCInstructionText& text)
+{
+    quint32 word = instruction.word;
+    int d = PPCDisassembler::rD(word);
+    int a = PPCDisassembler::rA(word);
+    int b = PPCDisassembler::rB(word);
+
+    switch (extendedOpcode(word))
     {
+    case 0: text.set("mcrf"); text.add(crf(crfD(word))); text.add(crf(crfS(word))); return true;
+    case 16: return formatConditionalBranch(instruction, "lr", text);
+    case 528: return formatConditionalBranch(instruction, "ctr", text);
+    case 50: text.set("rfi"); return true;
+    case 150: text.set("isync"); return true;
+    case 33:
+        if (a == b) { text.set("crnot"); text.add(number(d)); text.add(number(a)); return true; }
+        text.set("crnor");
+        break;
+    case 129: text.set("crandc"); break;
+    case 193:
+        if (d == a && a == b) { text.set("crclr"); text.add(number(d)); return true; }
+        text.set("crxor");
+        break;
+    case 225: text.set("crnand"); break;
+    case 257: text.set("crand"); break;
+    case 289:
+        if (d == a && a == b) { text.set("crset"); text.add(number(d)); return true; }
+        text.set("creqv");
+        break;
+    case 417: text.set("crorc"); break;
+    case 449:
+        if (a == b) { text.set("crmove"); text.add(number(d)); text.add(number(a)); return true; }
+        text.set("cror");
+        break;
+    default:
         return false;
     }
 
-    cs_option(handle, CS_OPT_SKIPDATA, CS_OPT_ON);
+    text.add(number(d));
+    text.add(number(a));
+    text.add(number(b));
+    return true;
+}
 
-    bool success = true;
+// Primary opcode 31: register-register integer operations, indexed loads
+// and stores, SPR moves and cache control
+static bool formatOpcode31(quint32 word, PPCInstructionText& text)
+{
+    int d = PPCDisassembler::rD(word);
+    int a = PPCDisassembler::rA(word);
+    int b = PPCDisassembler::rB(word);
+    const char* name = nullptr;
 
-    count = cs_disasm(handle, (uint8_t*)data, endAddress - startAddress, startAddress, 0, &insn);
+    // XO-form arithmetic, the OE bit is part of the extended opcode field
+    switch (extendedOpcode(word) & 0x1FF)
+    {
+    case 266: name = "add"; break;
+    case 10: name = "addc"; break;
+    case 138: name = "adde"; break;
+    case 491: name = "divw"; break;
+    case 459: name = "divwu"; break;
+    case 75: name = "mulhw"; break;
+    case 11: name = "mulhwu"; break;
+    case 235: name = "mullw"; break;
+    case 40: name = "subf"; break;
+    case 8: name = "subfc"; break;
+    case 136: name = "subfe"; break;
+    case 234: name = "addme"; b = -1; break;
+    case 202: name = "addze"; b = -1; break;
+    case 104: name = "neg"; b = -1; break;
+    case 232: name = "subfme"; b = -1; break;
+    case 200: name = "subfze"; b = -1; break;
+    }
 
-    if (count == 0)
+    if (name)
     {
-        success = false;
+        text.mnemonic = QString("%1%2%3").arg(QLatin1String(name), QLatin1String(overflowBit(word) ? "o" : ""), QLatin1String(recordBit(word) ? "." : ""));
+        text.add(gpr(d));
+        text.add(gpr(a));
+
+        if (b >= 0)
+        {
+            text.add(gpr(b));
+        }
+
+        return true;
+    }
+
+    bool isFloat = false;
+
+    switch (extendedOpcode(word))
+    {
+    // compares and traps
+    case 0:
+    case 32:
+        text.set(extendedOpcode(word) == 0 ? "cmpw" : "cmplw");
+
+        if (crfD(word) != 0)
+        {
+            text.add(crf(crfD(word)));
+        }
+
+        text.add(gpr(a));
+        text.add(gpr(b));
+        return true;
+    case 4:
+        if (d == 31 && a == 0 && b == 0)
+        {
+            text.set("trap");
+            return true;
+        }
+
+        text.set("tw");
+        text.add(number(d));
+        text.add(gpr(a));
+        text.add(gpr(b));
+        return true;
+
+    // indexed loads and stores
+    case 23: name = "lwzx"; break;
+    case 55: name = "lwzux"; break;
+    case 87: name = "lbzx"; break;
+    case 119: name = "lbzux"; break;
+    case 279: name = "lhzx"; break;
+    case 311: name = "lhzux"; break;
+    case 343: name = "lhax"; break;
+    case 375: name = "lhaux"; break;
+    case 534: name = "lwbrx"; break;
+    case 790: name = "lhbrx"; break;
+    case 20: name = "lwarx"; break;
+    case 533: name = "lswx"; break;
+    case 310: name = "eciwx"; break;
+    case 151: name = "stwx"; break;
+    case 183: name = "stwux"; break;
+    case 215: name = "stbx"; break;
+    case 247: name = "stbux"; break;
+    case 407: name = "sthx"; break;
+    case 439: name = "sthux"; break;
+    case 662: name = "stwbrx"; break;
+    case 918: name = "sthbrx"; break;
+    case 150: name = "stwcx."; break;
+    case 661: name = "stswx"; break;
+    case 438: name = "ecowx"; break;
+    case 535: name = "lfsx"; isFloat = true; break;
+    case 567: name = "lfsux"; isFloat = true; break;
+    case 599: name = "lfdx"; isFloat = true; break;
+    case 631: name = "lfdux"; isFloat = true; break;
+    case 663: name = "stfsx"; isFloat = true; break;
+    case 695: name = "stfsux"; isFloat = true; break;
+    case 727: name = "stfdx"; isFloat = true; break;
+    case 759: name = "stfdux"; isFloat = true; break;
+    case 983: name = "stfiwx"; isFloat = true; break;
+    case 597:
+    case 725:
+        text.set(extendedOpcode(word) == 597 ? "lswi" : "stswi");
+        text.add(gpr(d));
+        text.add(gpr(a));
+        text.add(number(b));
+        return true;
+
+    // logical and shifts, rA is the destination
+    case 28: name = "and"; break;
+    case 60: name = "andc"; break;
+    case 124: name = (d == b) ? "not" : "nor"; break;
+    case 284: name = "eqv"; break;
+    case 316: name = "xor"; break;
+    case 412: name = "orc"; break;
+    case 444: name = (d == b) ? "mr" : "or"; break;
+    case 476: name = "nand"; break;
+    case 24: name = "slw"; break;
+    case 536: name = "srw"; break;
+    case 792: name = "sraw"; break;
+    case 824: name = "srawi"; break;
+    case 26: name = "cntlzw"; break;
+    case 922: name = "extsh"; break;
+    case 954: name = "extsb"; break;
+
+    // cache and TLB control
+    case 54: name = "dcbst"; break;
+    case 86: name = "dcbf"; break;
+    case 246: name = "dcbtst"; break;
+    case 278: name = "dcbt"; break;
+    case 470: name = "dcbi"; break;
+    case 982: name = "icbi"; break;
+    case 1014: name = "dcbz"; break;
+    case 306: text.set("tlbie"); text.add(gpr(b)); return true;
+    case 370: text.set("tlbia"); return true;
+    case 566: text.set("tlbsync"); return true;
+    case 598: text.set("sync"); return true;
+    case 854: text.set("eieio"); return true;
+
+    // moves to and from special registers
+    case 19: text.set("mfcr"); text.add(gpr(d)); return true;
+    case 83: text.set("mfmsr"); text.add(gpr(d)); return true;
+    case 146: text.set("mtmsr"); text.add(gpr(d)); return true;
+    case 512: text.set("mcrxr"); text.add(crf(crfD(word))); return true;
+    case 144:
+    {
+        int crm = (word >> 12) & 0xFF;
+
+        if (crm == 0xFF)
+        {
+            text.set("mtcr");
+        }
+        else
+        {
+            text.set("mtcrf");
+            text.add(immediate(crm));
+        }
+
+        text.add(gpr(d));
+        return true;
+    }
+    case 339:
+    case 467:
+    {
+        bool isMove = extendedOpcode(word) == 339;
+        int spr = sprNumber(word);
+        const char* sprName = nullptr;
+
+        switch (spr)
+        {
+        case 1: sprName = "xer"; break;
+        case 8: sprName = "lr"; break;
+        case 9: sprName = "ctr"; break;
+        }
+
+        if (sprName)
+        {
+            text.mnemonic = QString("%1%2").arg(QLatin1String(isMove ? "mf" : "mt"), QLatin1String(sprName));
+            text.add(gpr(d));
+        }
+        else if (isMove)
+        {
+            text.set("mfspr");
+            text.add(gpr(d));
+            text.add(number(spr));
+        }
+        else
+        {
+            text.set("mtspr");
+            text.add(number(spr));
+            text.add(gpr(d));
+        }
+
+        return true;
+    }
+    case 371:
+        switch (sprNumber(word))
+        {
+        case 268: text.set("mftb"); break;
+        case 269: text.set("mftbu"); break;
+        default: text.set("mftb"); text.add(gpr(d)); text.add(number(sprNumber(word))); return true;
+        }
+
+        text.add(gpr(d));
+        return true;
+    case 595: text.set("mfsr"); text.add(gpr(d)); text.add(number(a & 0xF)); return true;
+    case 210: text.set("mtsr"); text.add(number(a & 0xF)); text.add(gpr(d)); return true;
+    case 659: text.set("mfsrin"); text.add(gpr(d)); text.add(gpr(b)); return true;
+    case 242: text.set("mtsrin"); text.add(gpr(d)); text.add(gpr(b)); return true;
+    default:
+        return false;
+    }
+
+    text.set(name);
+
+    switch (extendedOpcode(word))
+    {
+    case 28: case 60: case 124: case 284: case 316: case 412: case 444: case 476:
+    case 24: case 536: case 792:
+        // rA, rS, rB
+        if (recordBit(word))
+        {
+            text.mnemonic += ".";
+        }
+
+        text.add(gpr(a));
+        text.add(gpr(d));
+
+        if (d != b || (extendedOpcode(word) != 124 && extendedOpcode(word) != 444))
+        {
+            text.add(gpr(b));
+        }
+
+        return true;
+    case 824:
+        if (recordBit(word))
+        {
+            text.mnemonic += ".";
+        }
+
+        text.add(gpr(a));
+        text.add(gpr(d));
+        text.add(number(b));
+        return true;
+    case 26: case 922: case 954:
+        if (recordBit(word))
+        {
+            text.mnemonic += ".";
+        }
+
+        text.add(gpr(a));
+        text.add(gpr(d));
+        return true;
+    case 54: case 86: case 246: case 278: case 470: case 982: case 1014:
+        text.add(gpr(a));
+        text.add(gpr(b));
+        return true;
+    }
+
+    text.add(isFloat ? fpr(d) : gpr(d));
+    text.add(gpr(a));
+    text.add(gpr(b));
+    return true;
+}
+
+// Primary opcodes 59 and 63: floating point arithmetic
+static bool formatFloat(quint32 word, PPCInstructionText& text)
+{
+    bool isSingle = PPCDisassembler::primaryOpcode(word) == 59;
+    int d = PPCDisassembler::rD(word);
+    int a = PPCDisassembler::rA(word);
+    int b = PPCDisassembler::rB(word);
+    int c = frC(word);
+    const char* name = nullptr;
+    int form = 0; // 0: D, A, B  1: D, B  2: D, A, C  3: D, A, C, B
+
+    switch (aFormOpcode(word))
+    {
+    case 18: name = "fdiv"; break;
+    case 20: name = "fsub"; break;
+    case 21: name = "fadd"; break;
+    case 23: name = isSingle ? nullptr : "fsel"; form = 3; break;
+    case 24: name = isSingle ? "fres" : nullptr; form = 1; break;
+    case 25: name = "fmul"; form = 2; break;
+    case 26: name = isSingle ? nullptr : "frsqrte"; form = 1; break;
+    case 28: name = "fmsub"; form = 3; break;
+    case 29: name = "fmadd"; form = 3; break;
+    case 30: name = "fnmsub"; form = 3; break;
+    case 31: name = "fnmadd"; form = 3; break;
+    }
+
+    if (name)
+    {
+        text.mnemonic = QString("%1%2%3").arg(QLatin1String(name), QLatin1String(isSingle && form != 1 ? "s" : ""), QLatin1String(recordBit(word) ? "." : ""));
+        text.add(fpr(d));
+
+        if (form != 1)
+        {
+            text.add(fpr(a));
+        }
+
+        if (form >= 2)
+        {
+            text.add(fpr(c));
+        }
+
+        if (form != 2)
+        {
+            text.add(fpr(b));
+        }
+
+        return true;
+    }
+
+    if (isSingle)
+    {
+        return false;
+    }
+
+    switch (extendedOpcode(word))
+    {
+    case 0: text.set("fcmpu"); text.add(crf(crfD(word))); text.add(fpr(a)); text.add(fpr(b)); return true;
+    case 32: text.set("fcmpo"); text.add(crf(crfD(word))); text.add(fpr(a)); text.add(fpr(b)); return true;
+    case 64: text.set("mcrfs"); text.add(crf(crfD(word))); text.add(crf(crfS(word))); return true;
+    case 12: text.set("frsp"); break;
+    case 14: text.set("fctiw"); break;
+    case 15: text.set("fctiwz"); break;
+    case 40: text.set("fneg"); break;
+    case 72: text.set("fmr"); break;
+    case 136: text.set("fnabs"); break;
+    case 264: text.set("fabs"); break;
+    case 38: text.set("mtfsb1"); text.add(number(d)); break;
+    case 70: text.set("mtfsb0"); text.add(number(d)); break;
+    case 583: text.set("mffs"); text.add(fpr(d)); break;
+    case 711: text.set("mtfsf"); text.add(immediate((word >> 17) & 0xFF)); text.add(fpr(b)); break;
+    case 134: text.set("mtfsfi"); text.add(crf(crfD(word))); text.add(number((word >> 12) & 0xF)); break;
+    default:
+        return false;
+    }
+
+    if (recordBit(word))
+    {
+        text.mnemonic += ".";
+    }
+
+    if (text.operands.isEmpty())
+    {
+        text.add(fpr(d));
+        text.add(fpr(b));
+    }
+
+    return true;
+}
+
+// rlwinm with its simplified mnemonics
+static void formatRotate(quint32 word, PPCInstructionText& text)
+{
+    int sh = shift(word);
+    int mb = maskBegin(word);
+    int me = maskEnd(word);
+
+    text.add(gpr(PPCDisassembler::rA(word)));
+    text.add(gpr(PPCDisassembler::rS(word)));
+
+    if (mb == 0 && me == 31 - sh && sh != 0)
+    {
+        text.set("slwi");
+        text.add(number(sh));
+    }
+    else if (me == 31 && sh == 32 - mb && mb != 0)
+    {
+        text.set("srwi");
+        text.add(number(mb));
+    }
+    else if (sh == 0 && me == 31)
+    {
+        text.set("clrlwi");
+        text.add(number(mb));
+    }
+    else if (sh == 0 && mb == 0)
+    {
+        text.set("clrrwi");
+        text.add(number(31 - me));
+    }
+    else if (mb == 0 && me == 31)
+    {
+        text.set("rotlwi");
+        text.add(number(sh));
     }
     else
     {
-        Elf32_Addr address = startAddress;
+        text.set("rlwinm");
+        text.add(number(sh));
+        text.add(number(mb));
+        text.add(number(me));
+    }
+}
+
+static bool formatInstruction(const DisassemblyInstruction& instruction, PPCInstructionText& text)
+{
+    quint32 word = instruction.word;
+    int d = PPCDisassembler::rD(word);
+    int a = PPCDisassembler::rA(word);
+    qint16 simm = PPCDisassembler::simm(word);
+    quint16 uimm = PPCDisassembler::uimm(word);
+
+    switch (PPCDisassembler::primaryOpcode(word))
+    {
+    case 3: text.set("twi"); text.add(number(d)); text.add(gpr(a)); text.add(immediate(simm)); return true;
+    case 4: return formatPairedSingle(word, text);
+    case 7: text.set("mulli"); text.add(gpr(d)); text.add(gpr(a)); text.add(immediate(simm)); return true;
+    case 8: text.set("subfic"); text.add(gpr(d)); text.add(gpr(a)); text.add(immediate(simm)); return true;
+    case 10:
+    case 11:
+        text.set(PPCDisassembler::primaryOpcode(word) == 10 ? "cmplwi" : "cmpwi");
 
-        for (size_t i = 0; i < count; i++)
+        if (crfD(word) != 0)
         {
-            disasm.addLine(address, insn[i].mnemonic, insn[i].op_str);
-            address += 4;
+            text.add(crf(crfD(word)));
         }
 
-        cs_free(insn, count);
+        text.add(gpr(a));
+        text.add(PPCDisassembler::primaryOpcode(word) == 10 ? immediate(uimm) : immediate(simm));
+        return true;
+    case 12: text.set("addic"); text.add(gpr(d)); text.add(gpr(a)); text.add(immediate(simm)); return true;
+    case 13: text.set("addic."); text.add(gpr(d)); text.add(gpr(a)); text.add(immediate(simm)); return true;
+    case 14:
+        if (a == 0)
+        {
+            text.set("li");
+            text.add(gpr(d));
+        }
+        else
+        {
+            text.set("addi");
+            text.add(gpr(d));
+            text.add(gpr(a));
+        }
+
+        text.add(immediate(simm));
+        return true;
+    case 15:
+        if (a == 0)
+        {
+            text.set("lis");
+            text.add(gpr(d));
+            text.add(immediate(uimm));
+        }
+        else
+        {
+            text.set("addis");
+            text.add(gpr(d));
+            text.add(gpr(a));
+            text.add(immediate(simm));
+        }
+
+        return true;
+    case 16: return formatConditionalBranch(instruction, "", text);
+    case 17: text.set("sc"); return true;
+    case 18:
+    {
+        Elf32_Addr target = 0;
+
+        PPCDisassembler::branchTarget(instruction, target);
+        text.mnemonic = QString("b%1%2").arg(QLatin1String(recordBit(word) ? "l" : ""), QLatin1String((word & 2) ? "a" : ""));
+        text.add(address(target));
+        return true;
     }
+    case 19: return formatOpcode19(instruction, text);
+    case 20:
+    case 23:
+        text.set(PPCDisassembler::primaryOpcode(word) == 20 ? "rlwimi" : "rlwnm");
+        text.add(gpr(a));
+        text.add(gpr(d));
 
-    cs_close(&handle);
+        if (PPCDisassembler::primaryOpcode(word) == 23 && maskBegin(word) == 0 && maskEnd(word) == 31)
+        {
+            text.set("rotlw");
+            text.add(gpr(PPCDisassembler::rB(word)));
+        }
+        else
+        {
+            text.add(PPCDisassembler::primaryOpcode(word) == 20 ? number(shift(word)) : gpr(PPCDisassembler::rB(word)));
+            text.add(number(maskBegin(word)));
+            text.add(number(maskEnd(word)));
+        }
 
-    return success;
+        if (recordBit(word))
+        {
+            text.mnemonic += ".";
+        }
+
+        return true;
+    case 21:
+        formatRotate(word, text);
+
+        if (recordBit(word))
+        {
+            text.mnemonic += ".";
+        }
+
+        return true;
+    case 24:
+        if (word == 0x60000000)
+        {
+            text.set("nop");
+            return true;
+        }
+
+        text.set("ori");
+        break;
+    case 25: text.set("oris"); break;
+    case 26: text.set("xori"); break;
+    case 27: text.set("xoris"); break;
+    case 28: text.set("andi."); break;
+    case 29: text.set("andis."); break;
+    case 31: return formatOpcode31(word, text);
+    case 32: text.set("lwz"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 33: text.set("lwzu"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 34: text.set("lbz"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 35: text.set("lbzu"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 36: text.set("stw"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 37: text.set("stwu"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 38: text.set("stb"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 39: text.set("stbu"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 40: text.set("lhz"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 41: text.set("lhzu"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 42: text.set("lha"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 43: text.set("lhau"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 44: text.set("sth"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 45: text.set("sthu"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 46: text.set("lmw"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 47: text.set("stmw"); text.add(gpr(d)); text.add(memory(simm, a)); return true;
+    case 48: text.set("lfs"); text.add(fpr(d)); text.add(memory(simm, a)); return true;
+    case 49: text.set("lfsu"); text.add(fpr(d)); text.add(memory(simm, a)); return true;
+    case 50: text.set("lfd"); text.add(fpr(d)); text.add(memory(simm, a)); return true;
+    case 51: text.set("lfdu"); text.add(fpr(d)); text.add(memory(simm, a)); return true;
+    case 52: text.set("stfs"); text.add(fpr(d)); text.add(memory(simm, a)); return true;
+    case 53: text.set("stfsu"); text.add(fpr(d)); text.add(memory(simm, a)); return true;
+    case 54: text.set("stfd"); text.add(fpr(d)); text.add(memory(simm, a)); return true;
+    case 55: text.set("stfdu"); text.add(fpr(d)); text.add(memory(simm, a)); return true;
+    case 56:
+    case 57:
+    case 60:
+    case 61:
+    {
+        // psq_l, psq_lu, psq_st, psq_stu with a 12-bit displacement
+        static const char* const names[] = { "psq_l", "psq_lu", nullptr, nullptr, "psq_st", "psq_stu" };
+
+        text.set(names[PPCDisassembler::primaryOpcode(word) - 56]);
+        text.add(fpr(d));
+        text.add(memory((qint32)(word << 20) >> 20, a));
+        text.add(number((word >> 15) & 1));
+        text.add(number((word >> 12) & 7));
+        return true;
+    }
+    case 59:
+    case 63:
+        return formatFloat(word, text);
+    default:
+        return false;
+    }
+
+    // D-form logical immediates: rA, rS, UIMM
+    text.add(gpr(a));
+    text.add(gpr(d));
+    text.add(immediate(uimm));
+    return true;
+}
+
+void PPCDisassembler::format(const DisassemblyInstruction& instruction, QString& outMnemonic, QString& outOperands) const
+{
+    // Formatted from the word alone, capstone only finds the instructions
+    // in the first place. Words capstone skipped as data (opcode 0) that
+    // still decode are paired single instructions, which it doesn't know.
+    PPCInstructionText text;
+
+    if (!formatInstruction(instruction, text))
+    {
+        outMnemonic = ".long";
+        outOperands = QString("0x%1").arg(instruction.word, 8, 16, QLatin1Char('0'));
+        return;
+    }
+
+    outMnemonic = text.mnemonic;
+    outOperands = text.operands;
+}
+
+bool PPCDisassembler::branchTarget(const DisassemblyInstruction& instruction, Elf32_Addr& outTarget)
+{
+    quint32 word = instruction.word;
+    bool isAbsolute = (word & 2) != 0;
+
+    switch (primaryOpcode(word))
+    {
+    case 18: // b, ba, bl, bla
+    {
+        qint32 offset = ((qint32)(word << 6) >> 6) & ~3;
+        outTarget = isAbsolute ? (Elf32_Addr)offset : instruction.address + offset;
+        return true;
+    }
+    case 16: // bc, bca, bcl, bcla
+    {
+        qint32 offset = (qint16)(word & 0xFFFC);
+        outTarget = isAbsolute ? (Elf32_Addr)offset : instruction.address + offset;
+        return true;
+    }
+    }
+
+    return false;
 }
@@ -10,4 +10,16 @@ public:
     PPCDisassembler(QObject* parent = nullptr);
 
     bool disassemble(Disassembly& disasm, const Elf* elf, Elf32_Addr startAddress, Elf32_Addr endAddress) override;
+    void format(const DisassemblyInstruction& instruction, QString& outMnemonic, QString& outOperands) const override;
+
+    // Operand fields of the instruction word, so analyses can read them
+    // without going through the text
+    static int primaryOpcode(quint32 word) { return (word >> 26) & 0x3F; }
+    static int rD(quint32 word) { return (word >> 21) & 0x1F; }
+    static int rS(quint32 word) { return (word >> 21) & 0x1F; }
+    static int rA(quint32 word) { return (word >> 16) & 0x1F; }
+    static int rB(quint32 word) { return (word >> 11) & 0x1F; }
+    static qint16 simm(quint32 word) { return (qint16)(word & 0xFFFF); }
+    static quint16 uimm(quint32 word) { return (quint16)(word & 0xFFFF); }
+    static bool branchTarget(const DisassemblyInstruction& instruction, Elf32_Addr& outTarget);
 };
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+// Vector with inline storage for the first N elements. Only spills to the
+// heap when it grows past N, so short sequences like type modifiers and
+// location atoms never allocate. Restricted to trivially copyable types.
+template <class T, int N> class SmallVector
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SmallVector requires a trivially copyable type");
+
+public:
+    SmallVector()
+        : m_data((T*)m_inlineData)
+        , m_size(0)
+        , m_capacity(N)
+    {
+    }
+
+    SmallVector(const SmallVector& other)
+        : SmallVector()
+    {
+        *this = other;
+    }
+
+    ~SmallVector()
+    {
+        if (!isInline())
+        {
+            free(m_data);
+        }
+    }
+
+    SmallVector& operator=(const SmallVector& other)
+    {
+        if (this != &other)
+        {
+            m_size = 0;
+            reserve(other.m_size);
+            memcpy(m_data, other.m_data, other.m_size * sizeof(T));
+            m_size = other.m_size;
+        }
+
+        return *this;
+    }
+
+    int size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    bool isInline() const { return m_data == (T*)m_inlineData; }
+    int heapBytes() const { return isInline() ? 0 : m_capacity * (int)sizeof(T); }
+
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+    T* begin() { return m_data; }
+    T* end() { return m_data + m_size; }
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+
+    T& operator[](int i) { return m_data[i]; }
+    const T& operator[](int i) const { return m_data[i]; }
+    T& back() { return m_data[m_size - 1]; }
+    const T& back() const { return m_data[m_size - 1]; }
+
+    void push_back(const T& value)
+    {
+        if (m_size == m_capacity)
+        {
+            reserve(m_capacity * 2);
+        }
+
+        m_data[m_size++] = value;
+    }
+
+    void clear()
+    {
+        m_size = 0;
+    }
+
+    void reserve(int capacity)
+    {
+        if (capacity <= m_capacity)
+        {
+            return;
+        }
+
+        T* data = (T*)malloc(capacity * sizeof(T));
+        AllocationCounter::add();
+        memcpy(data, m_data, m_size * sizeof(T));
+
+        if (!isInline())
+        {
+            free(m_data);
+        }
+
+        m_data = data;
+        m_capacity = capacity;
+    }
+
+private:
+    T* m_data;
+    int m_size;
+    int m_capacity;
+    alignas(T) char m_inlineData[N * sizeof(T)];
+};
@@ -0,0 +1,43 @@
+#include "SortKeys.h"
+
+namespace SortKeys
+{
+    QList<quint32> collationKeys(const QStringList& strings)
+    {
+        QList<int> order(strings.size());
+        QList<quint32> keys(strings.size());
+
+        for (int i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+
+        // the only string comparisons, everything sorted by the keys later on
+        // gets away without any
+        std::sort(order.begin(), order.end(), [&](int a, int b)
+            {
+                int result = strings[a].compare(strings[b], Qt::CaseInsensitive);
+
+                if (result == 0)
+                {
+                    result = strings[a].compare(strings[b], Qt::CaseSensitive);
+                }
+
+                return result < 0;
+            });
+
+        quint32 key = 0;
+
+        for (int i = 0; i < order.size(); i++)
+        {
+            if (i > 0 && strings[order[i]] != strings[order[i - 1]])
+            {
+                key++;
+            }
+
+            keys[order[i]] = key;
+        }
+
+        return keys;
+    }
+}
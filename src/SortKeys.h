@@ -0,0 +1,42 @@
+#pragma once
+
+#include <qlist.h>
+#include <qstring.h>
+#include <qstringlist.h>
+#include <qnamespace.h>
+
+#include <algorithm>
+
+// Keys computed once per item so sorting compares plain integers instead of
+// rebuilding strings or looking up attributes on every comparison.
+namespace SortKeys
+{
+    // Key for every string: equal strings get equal keys, and keys compare
+    // like the strings do (case-insensitively, with case breaking ties).
+    QList<quint32> collationKeys(const QStringList& strings);
+
+    // Rows in [0, keys.size()) ordered by their key. Ties keep their row
+    // order, so the comparison is a strict weak ordering and sorting again
+    // by the same column gives the same result.
+    template <class Key> QList<int> sortedRows(const QList<Key>& keys, Qt::SortOrder order = Qt::AscendingOrder)
+    {
+        QList<int> rows(keys.size());
+        const Key* k = keys.constData();
+
+        for (int i = 0; i < rows.size(); i++)
+        {
+            rows[i] = i;
+        }
+
+        if (order == Qt::AscendingOrder)
+        {
+            std::sort(rows.begin(), rows.end(), [k](int a, int b) { return k[a] < k[b] || (k[a] == k[b] && a < b); });
+        }
+        else
+        {
+            std::sort(rows.begin(), rows.end(), [k](int a, int b) { return k[b] < k[a] || (k[a] == k[b] && a < b); });
+        }
+
+        return rows;
+    }
+}
@@ -0,0 +1,96 @@
+#include "Trace.h"
+
+#include <qfile.h>
+#include <qthread.h>
+#include <qjsonarray.h>
+#include <qjsonobject.h>
+#include <qjsondocument.h>
+#include <qcoreapplication.h>
+
+std::atomic<bool> Trace::s_enabled(false);
+QMutex Trace::s_mutex;
+QList<TraceEvent> Trace::s_events;
+QElapsedTimer Trace::s_timer;
+
+void Trace::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&s_mutex);
+
+    if (enabled && !s_timer.isValid())
+    {
+        s_timer.start();
+    }
+
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::clear()
+{
+    QMutexLocker locker(&s_mutex);
+    s_events.clear();
+}
+
+int Trace::eventCount()
+{
+    QMutexLocker locker(&s_mutex);
+    return s_events.size();
+}
+
+bool Trace::exportChromeTrace(const QString& path)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    QJsonArray traceEvents;
+    qint64 pid = QCoreApplication::applicationPid();
+
+    {
+        QMutexLocker locker(&s_mutex);
+
+        for (const TraceEvent& event : s_events)
+        {
+            // Chrome trace timestamps are in microseconds
+            QJsonObject object;
+            object["name"] = event.name;
+            object["cat"] = "dwarfexplorer";
+            object["ph"] = "X";
+            object["ts"] = event.start / 1000.0;
+            object["dur"] = event.duration / 1000.0;
+            object["pid"] = pid;
+            object["tid"] = (qint64)event.threadId;
+
+            if (!event.detail.isEmpty())
+            {
+                object["args"] = QJsonObject{ { "detail", event.detail } };
+            }
+
+            traceEvents.append(object);
+        }
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+
+    return file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) != -1;
+}
+
+qint64 Trace::now()
+{
+    return s_timer.nsecsElapsed();
+}
+
+quint64 Trace::currentThreadId()
+{
+    return (quint64)(quintptr)QThread::currentThreadId();
+}
+
+void Trace::addEvent(const TraceEvent& event)
+{
+    QMutexLocker locker(&s_mutex);
+    s_events.append(event);
+}
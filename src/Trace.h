@@ -0,0 +1,87 @@
+#pragma once
+
+#include <qstring.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qelapsedtimer.h>
+
+#include <atomic>
+
+struct TraceEvent
+{
+    const char* name;
+    QString detail;
+    quint64 threadId;
+    qint64 start;
+    qint64 duration;
+};
+
+class Trace
+{
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    static void clear();
+    static int eventCount();
+    static bool exportChromeTrace(const QString& path);
+
+    static qint64 now();
+    static quint64 currentThreadId();
+    static void addEvent(const TraceEvent& event);
+
+private:
+    static std::atomic<bool> s_enabled;
+    static QMutex s_mutex;
+    static QList<TraceEvent> s_events;
+    static QElapsedTimer s_timer;
+};
+
+// Records the time between construction and destruction (or finish()) as a
+// span. When tracing is disabled this is a single relaxed load and the detail
+// callback is never invoked.
+class TraceScope
+{
+public:
+    TraceScope(const char* name)
+        : m_name(name)
+        , m_detail()
+        , m_start(Trace::isEnabled() ? Trace::now() : -1)
+    {
+    }
+
+    template <class F> TraceScope(const char* name, F detail)
+        : m_name(name)
+        , m_detail()
+        , m_start(Trace::isEnabled() ? Trace::now() : -1)
+    {
+        if (m_start >= 0)
+        {
+            m_detail = detail();
+        }
+    }
+
+    ~TraceScope()
+    {
+        finish();
+    }
+
+    void finish()
+    {
+        if (m_start >= 0)
+        {
+            Trace::addEvent({ m_name, m_detail, Trace::currentThreadId(), m_start, Trace::now() - m_start });
+            m_start = -1;
+        }
+    }
+
+private:
+    const char* m_name;
+    QString m_detail;
+    qint64 m_start;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_DETAIL(name, detail) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, [&] { return QString(detail); })
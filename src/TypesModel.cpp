@@ -1,8 +1,10 @@
 #include "TypesModel.h"
 
 #include "Util.h"
+#include "Trace.h"
 
 #include <qdir.h>
+#include <qhash.h>
 
 TypesModel::TypesModel(QObject* parent)
     : QAbstractItemModel(parent)
@@ -27,6 +29,38 @@ void TypesModel::setDwarf(Dwarf* dwarf)
     emit dwarfChanged(dwarf);
 }
 
+static qint64 recurseItemBytes(const TypesModelItem& item, Memory::StringCounter& strings)
+{
+    qint64 bytes = Memory::listBytes(item.subitems);
+
+    strings.add(item.typeKeyword);
+    strings.add(item.typeNameOrCompileUnit);
+
+    for (const TypesModelItem& child : item.subitems)
+    {
+        bytes += recurseItemBytes(child, strings);
+    }
+
+    return bytes;
+}
+
+MemoryUsage TypesModel::memoryUsage() const
+{
+    Memory::StringCounter strings;
+    qint64 itemBytes = Memory::mapBytes(m_typeItemMap);
+
+    for (auto it = m_typeItemMap.cbegin(); it != m_typeItemMap.cend(); ++it)
+    {
+        strings.add(it.key());
+        itemBytes += recurseItemBytes(it.value(), strings);
+    }
+
+    MemoryUsage usage("Types model");
+    usage.add("Items", itemBytes);
+    usage.add("Strings", strings.bytes());
+    return usage;
+}
+
 void TypesModel::clearItems()
 {
     m_typeItemMap.clear();
@@ -49,6 +83,8 @@ static void recurseAssignParentItems(TypesModelItem* item)
 
 void TypesModel::refresh()
 {
+    TRACE_SCOPE("TypesModel::refresh");
+
     clearItems();
 
     if (!m_dwarf)
@@ -61,6 +97,8 @@ void TypesModel::refresh()
         return;
     }
 
+    QHash<DwarfEntry*, int> canonicalVariants;
+
     for (DwarfEntry* entry = &m_dwarf->entries[0]; entry != nullptr; entry = entry->sibling)
     {
         if (entry->tag == DW_TAG_compile_unit)
@@ -117,6 +155,16 @@ void TypesModel::refresh()
                     {
                         typeItem.type = TypesModelItem::TypeItem;
                         typeItem.typeNameOrCompileUnit = typeName;
+                        typeItem.typeVariant = 0;
+                    }
+
+                    // definitions are numbered by structural identity, so
+                    // copies that diverge from the others stand out
+                    int& variant = canonicalVariants[m_dwarf->canonicalType(child)];
+
+                    if (variant == 0)
+                    {
+                        variant = ++typeItem.typeVariant;
                     }
 
                     TypesModelItem defItem;
@@ -125,6 +173,7 @@ void TypesModel::refresh()
                     defItem.typeNameOrCompileUnit = compileUnitPath;
                     defItem.typeSize = typeSize;
                     defItem.typeDwarfOffset = child->offset;
+                    defItem.typeVariant = variant;
 
                     typeItem.subitems.append(defItem);
                 }
@@ -210,6 +259,12 @@ QVariant TypesModel::data(const QModelIndex& index, int role) const
         {
         case TypeColumn:
             return item->typeNameOrCompileUnit;
+        case VariantColumn:
+            if (item->typeVariant > 1)
+            {
+                return tr("%1 variants").arg(item->typeVariant);
+            }
+            break;
         }
     }
     else if (item->type == TypesModelItem::DefinitionItem)
@@ -222,6 +277,8 @@ QVariant TypesModel::data(const QModelIndex& index, int role) const
             return item->typeNameOrCompileUnit;
         case SizeColumn:
             return Util::hexToString(item->typeSize);
+        case VariantColumn:
+            return item->typeVariant;
         case DwarfOffsetColumn:
             return Util::hexToString(item->typeDwarfOffset);
         }
@@ -260,6 +317,8 @@ QVariant TypesModel::headerData(int section, Qt::Orientation orientation, int ro
         return tr("Compile Unit");
     case SizeColumn:
         return tr("Size");
+    case VariantColumn:
+        return tr("Variant");
     case DwarfOffsetColumn:
         return tr("DWARF Offset");
     }
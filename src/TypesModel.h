@@ -3,6 +3,7 @@
 #include <qabstractitemmodel.h>
 
 #include "Dwarf.h"
+#include "MemoryUsage.h"
 
 #include <qmap.h>
 
@@ -21,6 +22,7 @@ struct TypesModelItem
     QString typeNameOrCompileUnit;
     int typeSize;
     Elf32_Off typeDwarfOffset;
+    int typeVariant; // number of distinct definitions for type items
     QVector<TypesModelItem> subitems;
 };
 
@@ -34,6 +36,7 @@ public:
         TypeColumn,
         CompileUnitColumn,
         SizeColumn,
+        VariantColumn,
         DwarfOffsetColumn,
         ColumnCount
     };
@@ -42,6 +45,7 @@ public:
 
     Dwarf* dwarf() const;
     void setDwarf(Dwarf* dwarf);
+    MemoryUsage memoryUsage() const;
 
     QString typeName(const QModelIndex& index) const;
     QString compileUnit(const QModelIndex& index) const;
@@ -1,9 +1,51 @@
 #include "Util.h"
 
+#include <qthreadpool.h>
+#include <qsemaphore.h>
+
+#include <atomic>
+
 namespace Util
 {
     QString hexToString(quint32 x)
     {
         return "0x" + QString("%1").arg(x, 0, 16).toUpper();
     }
+
+    void parallelFor(int count, const std::function<void(int)>& function)
+    {
+        std::atomic<int> next(0);
+
+        auto work = [&]()
+        {
+            for (int i = next++; i < count; i = next++)
+            {
+                function(i);
+            }
+        };
+
+        QThreadPool* pool = QThreadPool::globalInstance();
+        QSemaphore finished;
+        int helperCount = 0;
+
+        // tryStart only takes threads that are free right now, so this can't
+        // deadlock when called from a pool thread
+        for (int i = 1; i < count && i < pool->maxThreadCount(); i++)
+        {
+            if (!pool->tryStart([&]()
+                {
+                    work();
+                    finished.release();
+                }))
+            {
+                break;
+            }
+
+            helperCount++;
+        }
+
+        work();
+
+        finished.acquire(helperCount);
+    }
 }
@@ -2,7 +2,14 @@
 
 #include <qstring.h>
 
+#include <functional>
+
 namespace Util
 {
     QString hexToString(quint32 x);
+
+    // Calls function for every index in [0, count) using idle threads of the
+    // global thread pool. The calling thread helps out, and the call returns
+    // once every index has been processed.
+    void parallelFor(int count, const std::function<void(int)>& function);
 }
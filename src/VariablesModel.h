@@ -3,10 +3,12 @@
 #include <qabstractitemmodel.h>
 
 #include "Dwarf.h"
+#include "MemoryUsage.h"
 
 struct VariablesModelItem
 {
     QString name;
+    QString mangledName;
     Elf32_Addr address;
     Elf32_Off dwarfOffset;
     bool isPublic;
@@ -32,6 +34,7 @@ public:
 
     Dwarf* dwarf() const;
     void setDwarf(Dwarf* dwarf);
+    MemoryUsage memoryUsage() const;
 
     QString name(const QModelIndex& index) const;
     Elf32_Addr address(const QModelIndex& index) const;
@@ -49,6 +52,9 @@ public:
 private:
     Dwarf* m_dwarf;
     QList<VariablesModelItem> m_items;
+    QList<int> m_rows; // item index of each row, items themselves never move
+    QList<quint32> m_nameKeys;
+    QList<quint32> m_fileNameKeys;
 
     void clearItems();
     void refresh();
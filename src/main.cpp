@@ -3,12 +3,163 @@
 #include <qapplication.h>
 
 #include "Icons.h"
+#include "Output.h"
+#include "CppCodeModel.h"
+#include "CodeExporter.h"
+#include "DisassemblyCache.h"
+#include "Benchmark.h"
+#include "Disassemblers.h"
+
+#include <qfile.h>
+
+#include <cstring>
+
+static void printWriteCallback(const QString& text)
+{
+    printf("%s\n", qPrintable(text));
+}
+
+// dwarfexplorer --export-all <elf> <outdir>
+static int exportAll(const QString& path, const QString& directory)
+{
+    // plain structs, destroy() must not see garbage pointers
+    Elf elf{};
+    Dwarf dwarf{};
+
+    Output::setWriteCallback(printWriteCallback);
+
+    if (elf.read(qPrintable(path)) != Elf::ReadSuccess)
+    {
+        Output::write(QCoreApplication::translate("main", "Could not read ELF file %1").arg(path));
+        return 1;
+    }
+
+    if (dwarf.read(&elf) != Dwarf::ReadSuccess)
+    {
+        Output::write(QCoreApplication::translate("main", "Could not read DWARF from file %1").arg(path));
+        elf.destroy();
+        return 1;
+    }
+
+    CppCodeModel model;
+    model.setDwarf(&dwarf);
+    DisassemblyCache::start(&dwarf);
+
+    CodeExportResult result = CodeExporter::exportAll(&model, directory);
+
+    if (result.failedCount > 0)
+    {
+        Output::write(QCoreApplication::translate("main", "Could not export %1 of %2 files: %3").arg(result.failedCount).arg(result.fileCount).arg(result.error));
+    }
+
+    Output::write(CodeExporter::summary(result, directory));
+
+    model.setDwarf(nullptr);
+    DisassemblyCache::clear();
+    dwarf.destroy();
+    elf.destroy();
+
+    return result.failedCount > 0 ? 1 : 0;
+}
+
+// dwarfexplorer --check-ppc-format <vectors>
+// Every line of the vectors file is an instruction word and its expected
+// text separated by a tab, see data/ppc-format-vectors.txt
+static int checkPPCFormat(const QString& path)
+{
+    const Elf32_Addr address = 0x80003000;
+
+    Output::setWriteCallback(printWriteCallback);
+
+    QFile file(path);
+
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+    {
+        Output::write(QCoreApplication::translate("main", "Could not open file %1").arg(path));
+        return 1;
+    }
+
+    AbstractDisassembler* disassembler = Disassemblers::disassembler(EM_PPC);
+    int checkedCount = 0;
+    int failedCount = 0;
+
+    while (!file.atEnd())
+    {
+        QString line = QString::fromLatin1(file.readLine()).trimmed();
+
+        if (line.isEmpty() || line.startsWith('#'))
+        {
+            continue;
+        }
+
+        int tab = line.indexOf('\t');
+        bool ok = false;
+
+        DisassemblyInstruction instruction;
+        instruction.address = address;
+        instruction.word = line.left(tab).toUInt(&ok, 16);
+        instruction.opcode = 0;
+
+        if (tab < 0 || !ok)
+        {
+            Output::write(QCoreApplication::translate("main", "Malformed line: %1").arg(line));
+            failedCount++;
+            continue;
+        }
+
+        QString expected = line.mid(tab + 1);
+        QString mnemonic;
+        QString operands;
+
+        disassembler->format(instruction, mnemonic, operands);
+
+        QString text = operands.isEmpty() ? mnemonic : mnemonic + " " + operands;
+
+        if (text != expected)
+        {
+            Output::write(QCoreApplication::translate("main", "%1: expected \"%2\", got \"%3\"")
+                .arg(line.left(tab))
+                .arg(expected)
+                .arg(text));
+            failedCount++;
+        }
+
+        checkedCount++;
+    }
+
+    Output::write(QCoreApplication::translate("main", "Checked %1 instructions, %2 failed").arg(checkedCount).arg(failedCount));
+
+    return failedCount > 0 ? 1 : 0;
+}
 
 int main(int argc, char* argv[])
 {
     QCoreApplication::setOrganizationName("seilweiss");
     QCoreApplication::setApplicationName("DWARF Explorer");
 
+    if (argc == 4 && strcmp(argv[1], "--export-all") == 0)
+    {
+        QCoreApplication a(argc, argv);
+
+        return exportAll(QString::fromLocal8Bit(argv[2]), QString::fromLocal8Bit(argv[3]));
+    }
+
+    if (argc == 3 && strcmp(argv[1], "--check-ppc-format") == 0)
+    {
+        QCoreApplication a(argc, argv);
+
+        return checkPPCFormat(QString::fromLocal8Bit(argv[2]));
+    }
+
+    if (argc == 3 && strcmp(argv[1], "--benchmark") == 0)
+    {
+        QCoreApplication a(argc, argv);
+
+        Output::setWriteCallback(printWriteCallback);
+
+        return Benchmark::run(QString::fromLocal8Bit(argv[2]));
+    }
+
     QApplication a(argc, argv);
 
     Icons::init();